@@ -0,0 +1,68 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include "editor.hpp"
+#include "grid.hpp"
+#include "hlstate.hpp"
+#include "object.hpp"
+
+TEST_CASE("GridBase::set_text", "[grid]")
+{
+  GridBase grid {0, 0, 200, 50, 1};
+  BENCHMARK("Every cell of a 200x50 grid")
+  {
+    for(std::uint16_t row = 0; row < grid.rows; ++row)
+    {
+      for(std::uint16_t col = 0; col < grid.cols; ++col)
+      {
+        grid.set_text('a' + col % 26, row, col, col % 40, 1, false);
+      }
+    }
+    return grid.area[0].code;
+  };
+  BENCHMARK("Whole rows with repeat")
+  {
+    for(std::uint16_t row = 0; row < grid.rows; ++row)
+    {
+      grid.set_text(' ', row, 0, 0, grid.cols, false);
+    }
+    return grid.area[0].code;
+  };
+}
+
+/// Gives access to the grids.
+struct BenchEditorArea : EditorArea
+{
+  using EditorArea::EditorArea;
+  using EditorArea::find_grid;
+};
+
+TEST_CASE("EditorArea::grid_scroll", "[grid]")
+{
+  using u64 = std::uint64_t;
+  HLState state;
+  BenchEditorArea editor {nullptr, &state, nullptr};
+  const Object resize = ObjectArray {u64(2), u64(200), u64(50)};
+  editor.grid_resize(std::span {&resize, 1});
+  GridBase* grid = editor.find_grid(2);
+  REQUIRE(grid);
+  // Scrolling by a line in a full width window, then in a vertical split
+  const Object full[] {
+    ObjectArray {u64(2), u64(0), u64(49), u64(0), u64(200), std::int64_t(1), u64(0)},
+    ObjectArray {u64(2), u64(0), u64(49), u64(0), u64(200), std::int64_t(-1), u64(0)}
+  };
+  const Object split[] {
+    ObjectArray {u64(2), u64(0), u64(49), u64(0), u64(100), std::int64_t(1), u64(0)},
+    ObjectArray {u64(2), u64(0), u64(49), u64(0), u64(100), std::int64_t(-1), u64(0)}
+  };
+  BENCHMARK("Full width, up and down")
+  {
+    editor.grid_scroll(full);
+    // Nothing is painted, don't let the scroll events pile up
+    grid->clear_event_queue();
+  };
+  BENCHMARK("Half width, up and down")
+  {
+    editor.grid_scroll(split);
+    grid->clear_event_queue();
+  };
+}
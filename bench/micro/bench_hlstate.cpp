@@ -0,0 +1,48 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <string>
+#include "hlstate.hpp"
+#include "object.hpp"
+
+/// An hl_attr_define argument, like the ones Neovim sends.
+static Object attr_define(std::uint64_t id)
+{
+  return ObjectArray {
+    id,
+    ObjectMap {
+      {"foreground", std::uint64_t(0xd4d4d4 + id)},
+      {"background", std::uint64_t(0x1e1e1e)},
+      {"italic", true}
+    },
+    ObjectMap {},
+    ObjectArray {
+      ObjectMap {
+        {"kind", std::string("syntax")},
+        {"hi_name", std::string("TSParameter")},
+        {"id", id}
+      }
+    }
+  };
+}
+
+TEST_CASE("Highlight attribute definitions", "[hlstate]")
+{
+  const Object attr = attr_define(107);
+  REQUIRE(hl::hl_attr_from_object(attr).hl_id == 107);
+  BENCHMARK("hl::hl_attr_from_object")
+  {
+    return hl::hl_attr_from_object(attr);
+  };
+  BENCHMARK_ADVANCED("HLState::define, 500 attributes")(
+    Catch::Benchmark::Chronometer meter
+  )
+  {
+    std::vector<Object> attrs;
+    for(std::uint64_t id = 1; id <= 500; ++id) attrs.push_back(attr_define(id));
+    HLState state;
+    meter.measure([&] {
+      for(const auto& a : attrs) state.define(a);
+      return state.generation();
+    });
+  };
+}
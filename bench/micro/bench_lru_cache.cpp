@@ -0,0 +1,33 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <vector>
+#include "lru_cache.hpp"
+
+TEST_CASE("LRUCache under churn", "[lru_cache]")
+{
+  // Keys from a working set four times the capacity, so about
+  // three quarters of the lookups miss and evict something
+  std::vector<std::uint32_t> keys(4096);
+  std::uint32_t x = 12345;
+  for(auto& k : keys)
+  {
+    x = x * 1664525u + 1013904223u;
+    k = (x >> 8) % 1024;
+  }
+  LRUCache<std::uint32_t, std::uint32_t> cache {256};
+  BENCHMARK("get, put on a miss")
+  {
+    std::uint32_t hits = 0;
+    for(const auto k : keys)
+    {
+      if (auto* v = cache.get(k)) hits += *v;
+      else cache.put(k, k);
+    }
+    return hits;
+  };
+  BENCHMARK("put")
+  {
+    for(const auto k : keys) cache.put(k, k);
+    return cache.get(keys.back()) != nullptr;
+  };
+}
@@ -0,0 +1,83 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <msgpack.hpp>
+#include "object.hpp"
+
+/// A "redraw" notification with one grid_line event of rows lines,
+/// each with cols cells of text that mostly has no repeats, the way
+/// Neovim sends a screen full of code.
+static std::string grid_line_payload(int rows, int cols)
+{
+  msgpack::sbuffer buf;
+  msgpack::packer<msgpack::sbuffer> pk(buf);
+  pk.pack_array(3);
+  pk.pack(2);
+  pk.pack(std::string_view("redraw"));
+  pk.pack_array(1);
+  pk.pack_array(1 + rows);
+  pk.pack(std::string_view("grid_line"));
+  for(int row = 0; row < rows; ++row)
+  {
+    pk.pack_array(4);
+    pk.pack(1);
+    pk.pack(row);
+    pk.pack(0);
+    // The last cell repeats a space to the end of the line
+    const int text_cols = cols * 3 / 4;
+    pk.pack_array(text_cols + 1);
+    for(int col = 0; col < text_cols; ++col)
+    {
+      const char c = char('a' + (row + col) % 26);
+      if (col % 8 == 0)
+      {
+        pk.pack_array(2);
+        pk.pack(std::string_view(&c, 1));
+        pk.pack(col % 40);
+      }
+      else
+      {
+        pk.pack_array(1);
+        pk.pack(std::string_view(&c, 1));
+      }
+    }
+    pk.pack_array(3);
+    pk.pack(std::string_view(" "));
+    pk.pack(0);
+    pk.pack(cols - text_cols);
+  }
+  return std::string(buf.data(), buf.size());
+}
+
+static Object parse(const std::string& payload)
+{
+  std::size_t offset = 0;
+  return Object::from_msgpack(payload, offset);
+}
+
+TEST_CASE("Object::from_msgpack on grid_line payloads", "[object]")
+{
+  const auto line = grid_line_payload(1, 80);
+  const auto screen = grid_line_payload(50, 200);
+  const auto big = grid_line_payload(150, 400);
+  REQUIRE(parse(screen).is_array());
+  BENCHMARK("1 line, 80 columns") { return parse(line); };
+  BENCHMARK("50 lines, 200 columns") { return parse(screen); };
+  BENCHMARK("150 lines, 400 columns") { return parse(big); };
+}
+
+TEST_CASE("Object::try_decompose", "[object]")
+{
+  using u16 = std::uint16_t;
+  // A grid_scroll event
+  const Object scroll = ObjectArray {
+    std::uint64_t(2), std::uint64_t(0), std::uint64_t(50), std::uint64_t(0),
+    std::uint64_t(200), std::int64_t(-3), std::uint64_t(0)
+  };
+  REQUIRE(scroll.try_decompose<u16, u16, u16, u16, u16, int>());
+  BENCHMARK("grid_scroll arguments")
+  {
+    return scroll.try_decompose<u16, u16, u16, u16, u16, int>();
+  };
+}
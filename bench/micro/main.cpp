@@ -0,0 +1,17 @@
+/// Catch2 micro-benchmarks of the hot paths that don't need Neovim.
+/// Usage: nvui_microbench [catch options], e.g.
+/// nvui_microbench "[object]" --benchmark-samples 50
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+#include <QApplication>
+
+int main(int argc, char** argv)
+{
+  // EditorArea is a widget, but nothing is ever shown
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+  {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QApplication app {argc, argv};
+  return Catch::Session().run(argc, argv);
+}
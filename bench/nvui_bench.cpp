@@ -0,0 +1,189 @@
+/// Replays a trace recorded with "nvui --record=<file>" through the
+/// decoder, Window::handle_redraw and offscreen rendering of the editor
+/// area, as fast as possible.
+/// Usage: nvui_bench <trace> [--geometry=WxH] [--iterations=N]
+#include <QApplication>
+#include <QImage>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/format.h>
+#include "decide_renderer.hpp"
+#include "nvim.hpp"
+#include "object.hpp"
+#include "window.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// Feeds data to the stream in chunks, the same way Nvim::on_read
+/// does, calling f on every complete message.
+template<typename F>
+static void for_each_message(std::string_view data, F&& f)
+{
+  MsgpackStream stream;
+  std::size_t pos = 0;
+  while(pos < data.size())
+  {
+    auto area = stream.write_area();
+    const auto n = std::min(area.size(), data.size() - pos);
+    std::memcpy(area.data(), data.data() + pos, n);
+    stream.commit(n);
+    pos += n;
+    while(stream.pending() > 0)
+    {
+      if (!f(stream)) break;
+    }
+  }
+}
+
+static double percentile(std::vector<double>& values, double p)
+{
+  if (values.empty()) return 0.;
+  std::sort(values.begin(), values.end());
+  const auto idx = static_cast<std::size_t>(p * double(values.size() - 1));
+  return values[idx];
+}
+
+static int int_arg(const std::vector<std::string>& args, std::string_view prefix, int def)
+{
+  for(const auto& arg : args)
+  {
+    if (!arg.starts_with(prefix)) continue;
+    int val = def;
+    std::from_chars(arg.data() + prefix.size(), arg.data() + arg.size(), val);
+    return val;
+  }
+  return def;
+}
+
+int main(int argc, char** argv)
+{
+  const std::vector<std::string> args(argv + 1, argv + argc);
+  if (args.empty() || args[0].starts_with("--"))
+  {
+    fmt::print("Usage: nvui_bench <trace> [--geometry=WxH] [--iterations=N]\n");
+    fmt::print("Record a trace with nvui --record=<trace>\n");
+    return 1;
+  }
+  std::ifstream file {args[0], std::ios::binary};
+  if (!file)
+  {
+    fmt::print("Could not open {}\n", args[0]);
+    return 1;
+  }
+  const std::string trace {
+    std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()
+  };
+  int width = 100;
+  int height = 50;
+  for(const auto& arg : args)
+  {
+    if (!arg.starts_with("--geometry=")) continue;
+    auto geom = std::string_view(arg).substr(std::strlen("--geometry="));
+    auto x = geom.find('x');
+    if (x == std::string_view::npos) continue;
+    std::from_chars(geom.data(), geom.data() + x, width);
+    std::from_chars(geom.data() + x + 1, geom.data() + geom.size(), height);
+  }
+  const int iterations = std::max(int_arg(args, "--iterations=", 5), 1);
+  const double megabytes = double(trace.size()) / (1024. * 1024.);
+
+  // Decode only
+  std::size_t messages = 0;
+  auto start = Clock::now();
+  for(int i = 0; i < iterations; ++i)
+  {
+    for_each_message(trace, [&](MsgpackStream& stream) {
+      auto view = stream.next_view();
+      if (!view) return false;
+      ++messages;
+      return true;
+    });
+  }
+  const double decode_time = seconds_since(start);
+  fmt::print(
+    "Decode: {} messages, {:.2f} MB/s\n",
+    messages / iterations, megabytes * iterations / decode_time
+  );
+
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+  {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QApplication app {argc, argv};
+#if defined(USE_DIRECT2D)
+  fmt::print("Offscreen rendering needs the QPainter renderer, "
+    "frame times only include handling the events.\n");
+#endif
+  // Window needs an Nvim instance, but since the UI is never attached
+  // it doesn't send any redraw events of its own
+  Nvim nvim;
+  Window w(nullptr, &nvim, width, height, false);
+  w.register_handlers();
+  w.show();
+  app.processEvents();
+  EditorArea& editor = w.editor();
+  QImage frame(editor.size(), QImage::Format_ARGB32_Premultiplied);
+  std::size_t events = 0;
+  std::vector<double> frame_times;
+  start = Clock::now();
+  for(int i = 0; i < iterations; ++i)
+  {
+    for_each_message(trace, [&](MsgpackStream& stream) {
+      const bool is_redraw = stream.peek_notification_method() == "redraw";
+      auto view = stream.next_view();
+      if (!view) return false;
+      if (!is_redraw) return true;
+      auto* arr = view->obj.array();
+      if (!arr || arr->size() < 3) return true;
+      bool flushed = false;
+      if (auto* batch = arr->at(2).array())
+      {
+        for(const auto& o : *batch)
+        {
+          auto* task = o.array();
+          if (!task || task->empty()) continue;
+          events += task->size() - 1;
+          if (task->at(0).str() == "flush") flushed = true;
+        }
+      }
+      const auto frame_start = Clock::now();
+      w.handle_redraw(std::move(view->obj));
+#if defined(USE_QPAINTER)
+      if (flushed)
+      {
+        if (frame.size() != editor.size())
+        {
+          frame = QImage(editor.size(), QImage::Format_ARGB32_Premultiplied);
+        }
+        editor.render(&frame);
+      }
+#endif
+      if (flushed) frame_times.push_back(seconds_since(frame_start) * 1000.);
+      return true;
+    });
+    app.processEvents();
+  }
+  const double replay_time = seconds_since(start);
+  fmt::print(
+    "Replay: {:.0f} events/s, {:.2f} MB/s, {} frames\n",
+    double(events) / replay_time, megabytes * iterations / replay_time,
+    frame_times.size()
+  );
+  fmt::print(
+    "Frame time: p50 {:.3f}ms, p99 {:.3f}ms\n",
+    percentile(frame_times, 0.5), percentile(frame_times, 0.99)
+  );
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include "atlas_grid.hpp"
+#include "editor.hpp"
+#include <QPainter>
+#include <cmath>
+
+static constexpr int atlas_width = 2048;
+static constexpr int max_atlas_height = 4096;
+static constexpr FontOptions decorations =
+  FontOpts::Underline | FontOpts::Undercurl | FontOpts::Strikethrough;
+
+void AtlasPaintGrid::initialize_atlas()
+{
+  QObject::connect(editor_area, &EditorArea::font_changed, this, [this] {
+    reset_atlas();
+  });
+  reset_atlas();
+}
+
+void AtlasPaintGrid::reset_atlas()
+{
+  const auto [font_width, font_height] = editor_area->font_dimensions();
+  slot_width = std::max(1, int(std::ceil(font_width)));
+  slot_height = std::max(1, int(std::ceil(font_height)));
+  glyphs.clear();
+  next_x = 0;
+  next_y = 0;
+  // Start small, most buffers only use a few hundred glyphs
+  atlas = QImage(
+    atlas_width, std::min(max_atlas_height, slot_height * 8),
+    QImage::Format_ARGB32_Premultiplied
+  );
+  atlas.fill(Qt::transparent);
+}
+
+QRect AtlasPaintGrid::allocate(int w, int h)
+{
+  if (next_x + w > atlas.width())
+  {
+    next_x = 0;
+    next_y += slot_height;
+  }
+  if (next_y + h > atlas.height())
+  {
+    if (atlas.height() * 2 <= max_atlas_height)
+    {
+      QImage bigger(atlas.width(), atlas.height() * 2, atlas.format());
+      bigger.fill(Qt::transparent);
+      QPainter p(&bigger);
+      p.setCompositionMode(QPainter::CompositionMode_Source);
+      p.drawImage(0, 0, atlas);
+      p.end();
+      atlas = std::move(bigger);
+    }
+    else
+    {
+      // Full, start over. Only the glyphs that are still in use
+      // get rasterized again.
+      glyphs.clear();
+      atlas.fill(Qt::transparent);
+      next_x = 0;
+      next_y = 0;
+    }
+  }
+  QRect r(next_x, next_y, w, h);
+  next_x += w;
+  return r;
+}
+
+QRect AtlasPaintGrid::glyph_rect(const GlyphKey& key, const GridChar& gc)
+{
+  if (auto it = glyphs.find(key); it != glyphs.end()) return it->second;
+  const auto [font_width, font_height] = editor_area->font_dimensions();
+  const QRect slot = allocate(slot_width * (key.double_width ? 2 : 1), slot_height);
+  QPainter p(&atlas);
+  p.setCompositionMode(QPainter::CompositionMode_Source);
+  p.fillRect(slot, Qt::transparent);
+  p.setCompositionMode(QPainter::CompositionMode_SourceOver);
+  const QFont& font = editor_area->fallback_list()[key.font_idx].styled(
+    key.font_opts & FontOpts::Bold, key.font_opts & FontOpts::Italic
+  );
+  std::optional<Color> sp;
+  if (key.font_opts & decorations) sp = Color(key.sp);
+  draw_text(
+    p, gc.text(), Color(key.fg), sp, QRectF(slot), key.font_opts,
+    font, font_width, font_height
+  );
+  p.end();
+  glyphs.emplace(key, slot);
+  return slot;
+}
+
+void AtlasPaintGrid::draw(QPainter& p, QRect r, const double font_offset)
+{
+  Q_UNUSED(font_offset);
+  const auto [font_width, font_height] = editor_area->font_dimensions();
+  if (std::ceil(font_width) != slot_width || std::ceil(font_height) != slot_height)
+  {
+    reset_atlas();
+  }
+  const HLState* s = editor_area->hl_state();
+  const auto& fonts = editor_area->fallback_list();
+  for(int y = r.top(); y <= r.bottom() && y < rows; ++y)
+  {
+    const GridChar* row = area.data() + y * cols;
+    const double top = y * font_height;
+    p.setClipRect(QRectF(0, top, cols * font_width, font_height));
+    // Backgrounds, one fill per run of cells with the same highlight
+    for(int start = 0, x = 1; x <= cols; ++x)
+    {
+      if (x < cols && row[x].hl_id == row[start].hl_id) continue;
+      p.fillRect(
+        QRectF(start * font_width, top, (x - start) * font_width, font_height),
+        s->resolved_for_id(row[start].hl_id).qbg
+      );
+      start = x;
+    }
+    for(int x = 0; x < cols; ++x)
+    {
+      const GridChar& gc = row[x];
+      if (gc.empty()) continue;
+      const ResolvedHL& hl = s->resolved_for_id(gc.hl_id);
+      if (gc.is_space() && !hl.decorated()) continue;
+      auto font_idx = editor_area->cached_font_for_ucs(gc.ucs());
+      if (font_idx >= fonts.size()) font_idx = 0;
+      const GlyphKey key {
+        gc.text_id(), font_idx, hl.fg.to_uint32(), hl.sp.to_uint32(),
+        hl.font_opts, gc.double_width()
+      };
+      const QRect src = glyph_rect(key, gc);
+      p.drawImage(QPointF(x * font_width, top), atlas, src);
+    }
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef NVUI_ATLAS_GRID_HPP
+#define NVUI_ATLAS_GRID_HPP
+
+#include <QImage>
+#include <QRect>
+#include <cstdint>
+#include <unordered_map>
+#include "grid.hpp"
+
+/// A QPaintGrid that rasterizes every glyph once into an atlas and
+/// then draws cells by copying them out of it.
+/// Unlike QPaintGrid, changing a single character doesn't invalidate a
+/// whole shaped text run, so the cost of a frame only depends on the
+/// number of cells being drawn, not on what's in them.
+/// The trade-off is that glyphs are clipped to their cell (or two cells
+/// for double-width characters), and ligatures aren't formed.
+class AtlasPaintGrid : public QPaintGrid
+{
+  Q_OBJECT
+public:
+  template<typename... GridBaseArgs>
+  AtlasPaintGrid(EditorArea* ea, GridBaseArgs... args)
+    : QPaintGrid(ea, args...)
+  {
+    initialize_atlas();
+  }
+  /// Number of glyphs that are in the atlas.
+  std::size_t glyph_count() const { return glyphs.size(); }
+protected:
+  void draw(QPainter& p, QRect r, const double font_offset) override;
+private:
+  struct GlyphKey
+  {
+    std::uint32_t text;
+    std::uint32_t font_idx;
+    std::uint32_t fg;
+    std::uint32_t sp;
+    FontOptions font_opts;
+    bool double_width;
+    bool operator==(const GlyphKey&) const = default;
+  };
+  struct GlyphKeyHash
+  {
+    std::size_t operator()(const GlyphKey& k) const noexcept
+    {
+      std::uint64_t h = k.text;
+      h = h * 0x9E3779B97F4A7C15ull ^ k.font_idx;
+      h = h * 0x9E3779B97F4A7C15ull ^ k.fg;
+      h = h * 0x9E3779B97F4A7C15ull ^ k.sp;
+      h = h * 0x9E3779B97F4A7C15ull ^ (std::uint64_t(k.font_opts) << 1 | k.double_width);
+      return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+  };
+  /// Returns the atlas rect of the glyph, rasterizing it first if it
+  /// isn't in the atlas yet.
+  QRect glyph_rect(const GlyphKey& key, const GridChar& gc);
+  /// Reserve space for a w x h glyph, growing or (when it's at its
+  /// maximum size) resetting the atlas if it's full.
+  QRect allocate(int w, int h);
+  /// Empty the atlas, match the slots to the current font dimensions.
+  void reset_atlas();
+  void initialize_atlas();
+  QImage atlas;
+  std::unordered_map<GlyphKey, QRect, GlyphKeyHash> glyphs;
+  /// Shelf packing: glyphs are all one cell tall, so the atlas is
+  /// filled row by row.
+  int next_x = 0;
+  int next_y = 0;
+  int slot_height = 0;
+  int slot_width = 0;
+};
+
+#endif // NVUI_ATLAS_GRID_HPP
@@ -1,4 +1,6 @@
 #include "cmdline.hpp"
+#include <algorithm>
+#include <cmath>
 #include <QPainter>
 #include <QPaintEvent>
 #include "msgpack_overrides.hpp"
@@ -48,6 +50,10 @@ void CmdLine::update_metrics()
   big_metrics = QFontMetricsF(big_font);
   std::tie(font_width, font_height) = get_font_dimensions_for(font);
   std::tie(big_font_width, big_font_height) = get_font_dimensions_for(big_font);
+  // Every advance is different now
+  line_texts.clear();
+  layouts.clear();
+  for(std::size_t i = 0; i < lines.size(); ++i) layout_line(i);
 }
 
 void CmdLine::cmdline_show(std::span<const Object> objs)
@@ -128,71 +134,49 @@ void CmdLine::paintEvent(QPaintEvent* event)
   QColor def_bg = inner_bg.value_or(default_colors.bg().value_or(0).qcolor());
   QPainter p(this);
   p.fillRect(rect(), def_bg);
-  QString thing;
   p.setPen(def_fg);
-  int base_x = border_width + padding;
-  int base_y = border_width + padding;
-  struct {
-    int x;
-    int y;
-  } pt = {base_x, base_y};
+  const int base_x = border_width + padding;
+  const int base_y = border_width + padding;
   const int big_offset = big_metrics.ascent();
   const int offset = reg_metrics.ascent();
-  pt.y += first_char ? std::max(big_offset, offset) : offset;
+  int y = base_y + (first_char ? std::max(big_offset, offset) : offset);
   if (first_char)
   {
     p.setFont(big_font);
-    p.drawText(QPoint {pt.x, pt.y}, first_char.value());
-    pt.x += p.fontMetrics().horizontalAdvance(first_char.value());
+    p.drawText(QPoint {base_x, y}, first_char.value());
   }
   p.setFont(font);
-  const QFontMetrics& font_metrics = p.fontMetrics();
-  int cur_char = 0;
-  bool cursor_drawn = false;
-  QRect inner = inner_rect();
+  // Baseline of the cursor, and its x-coordinate
+  std::optional<QPoint> cursor_pt;
+  int line_start = 0;
   for(std::size_t i = 0; i < lines.size(); ++i)
   {
-    for(const auto& seq : lines[i])
+    const CmdLineLayout& layout = wrapped_layout(i);
+    const QString& text = line_texts[i];
+    if (cursor_pos && *cursor_pos >= line_start
+      && (*cursor_pos - line_start < int(layout.size()) || i == lines.size() - 1))
     {
-      for(const QChar& c : seq.first)
+      const auto [row, x] = layout.position(*cursor_pos - line_start);
+      int cursor_y = y + int(row) * font_height;
+      if (i == 0 && row > 0 && first_char)
       {
-        int text_width = font_metrics.horizontalAdvance(c);
-        if (pt.x + text_width > inner.width())
-        {
-          pt.x = base_x;
-          if (pt.y == base_y) pt.y += std::max(big_font_height, font_height);
-          else pt.y += font_height;
-        }
-        p.drawText(QPoint {pt.x, pt.y}, c);
-        if (cursor_pos && cur_char == cursor_pos.value())
-        {
-          auto c_rect_opt = nvim_cursor->rect(font_width, font_height);
-          if (c_rect_opt)
-          {
-            auto&& c_rect = c_rect_opt.value();
-            const HLAttr& a = state->attr_for_id(c_rect.hl_id);
-            Color bg = a.bg().value_or(*default_colors.bg());
-            Color fg = a.fg().value_or(*default_colors.fg());
-            if (c_rect.hl_id == 0 || a.reverse) std::swap(fg, bg);
-            QRect rect = c_rect.rect.toRect();
-            int y = pt.y - offset;
-            rect.moveTo({pt.x, y});
-            p.fillRect(rect, QColor(bg.r, bg.g, bg.b));
-            cursor_drawn = true;
-          }
-        }
-        ++cur_char;
-        pt.x += text_width;
+        cursor_y += std::max(big_font_height, font_height) - font_height;
       }
+      cursor_pt = QPoint {x, cursor_y};
     }
-    if (i != lines.size() - 1)
+    for(std::size_t row = 0; row < layout.rows(); ++row)
     {
-      pt.y += pt.y == base_y 
+      const auto [first, last] = layout.row_range(row);
+      const int x = layout.position(first).second;
+      p.drawText(QPoint {x, y}, text.mid(int(first), int(last - first)));
+      if (row == layout.rows() - 1 && i == lines.size() - 1) break;
+      y += i == 0 && row == 0 && first_char
         ? std::max(big_font_height, font_height)
         : font_height;
     }
+    line_start += int(layout.size());
   }
-  if (cursor_pos && !cursor_drawn)
+  if (cursor_pt)
   {
     auto c_rect_opt = nvim_cursor->rect(font_width, font_height);
     if (c_rect_opt)
@@ -202,12 +186,9 @@ void CmdLine::paintEvent(QPaintEvent* event)
       Color bg = a.bg().value_or(*default_colors.bg());
       Color fg = a.fg().value_or(*default_colors.fg());
       if (c_rect.hl_id == 0 || a.reverse) std::swap(fg, bg);
-      if (pt.y == base_y) pt.y -= big_offset;
-      else pt.y -= offset;
       QRect rect = c_rect.rect.toRect();
-      rect.moveTo({pt.x, pt.y});
+      rect.moveTo({cursor_pt->x(), cursor_pt->y() - offset});
       p.fillRect(rect, QColor(bg.r, bg.g, bg.b));
-      cursor_drawn = true;
     }
   }
   if (border_width == 0.f) return;
@@ -252,40 +233,53 @@ void CmdLine::add_line(const ObjectArray& new_line)
     line.emplace_back(text, hl_id);
   }
   lines.push_back(std::move(line));
+  layout_line(lines.size() - 1);
 }
 
+void CmdLine::layout_line(std::size_t i)
+{
+  assert(i < lines.size() && i <= line_texts.size());
+  QString text;
+  for(const auto& seq : lines[i]) text += seq.first;
+  if (i == line_texts.size())
+  {
+    line_texts.emplace_back();
+    layouts.emplace_back();
+  }
+  const QString& prev = line_texts[i];
+  const int common = int(std::mismatch(
+    prev.cbegin(), prev.cend(), text.cbegin(), text.cend()
+  ).first - prev.cbegin());
+  CmdLineLayout& layout = layouts[i];
+  layout.truncate(common);
+  for(int c = common; c < text.size(); ++c)
+  {
+    layout.push(int(std::round(reg_metrics.horizontalAdvance(text.at(c)))));
+  }
+  line_texts[i] = std::move(text);
+}
+
+int CmdLine::first_char_width() const
+{
+  if (!first_char) return 0;
+  return int(std::round(big_metrics.horizontalAdvance(*first_char)));
+}
+
+const CmdLineLayout& CmdLine::wrapped_layout(std::size_t i)
+{
+  const int base_x = border_width + padding;
+  const int start_x = i == 0 ? base_x + first_char_width() : base_x;
+  layouts[i].wrap(start_x, base_x, inner_rect().width());
+  return layouts[i];
+}
 
 int CmdLine::fitting_height()
 {
   if (lines.size() == 0) return big_font_height;
   int height = 0;
-  QPainter p(&pixmap);
-  p.setFont(big_font);
-  int max_width = inner_rect().width();
-  const int base_x = border_width + padding;
   for(std::size_t i = 0; i < lines.size(); ++i)
   {
-    int width = base_x;
-    if (i == 0 && first_char)
-    {
-      width += p.fontMetrics().horizontalAdvance(first_char.value());
-      p.setFont(font);
-    }
-    int num_lines = 1;
-    for(const auto& seq : lines[i])
-    {
-      for(const QChar& c : seq.first)
-      {
-        int text_width = p.fontMetrics().horizontalAdvance(c);
-        if (width + text_width > max_width)
-        {
-          width = base_x;
-          ++num_lines;
-        }
-        width += text_width;
-      }
-    }
-    int height_for_line = num_lines * font_height;
+    int height_for_line = wrapped_layout(i).rows() * font_height;
     if (i == 0 && first_char && big_font_height > font_height)
     {
       height_for_line += (big_font_height - font_height);
@@ -8,6 +8,7 @@
 #include <optional>
 #include "hlstate.hpp"
 #include "cursor.hpp"
+#include "cmdline_layout.hpp"
 
 class CmdLine : public QWidget
 {
@@ -44,6 +45,7 @@ public:
   {
     font.setFamily(new_family);
     big_font.setFamily(new_family);
+    update_metrics();
   }
   
   inline void size_changed(const QSize& new_size)
@@ -186,6 +188,15 @@ private:
   std::optional<float> centered_y;
   // Parse and add new lines from new_line to line_arr.
   void add_line(const ObjectArray& new_line);
+  /**
+   * Update the layout of lines[i], measuring only the characters
+   * after the part of the text that didn't change.
+   */
+  void layout_line(std::size_t i);
+  /// Width of first_char in the big font.
+  int first_char_width() const;
+  /// Returns the layout for lines[i], wrapped to the current width.
+  const CmdLineLayout& wrapped_layout(std::size_t i);
   const HLState* state = nullptr;
   // Owned by EditorArea, but so is the cmdline
   // so there should be no problems
@@ -200,9 +211,13 @@ private:
   // (background and foreground)
   std::optional<QColor> inner_fg;
   std::optional<QColor> inner_bg;
-  QPixmap pixmap {1, 1};
   std::optional<QString> first_char;
   std::vector<line> lines;
+  /// The text of each line (the chunks joined) and its layout.
+  /// These can have more entries than lines, which are kept to be
+  /// reused when the lines come back.
+  std::vector<QString> line_texts;
+  std::vector<CmdLineLayout> layouts;
   std::vector<line> block_lines;
   // The command line contains its own, independent font size.
   // Not attached to guifont.
@@ -0,0 +1,90 @@
+#ifndef NVUI_CMDLINE_LAYOUT_HPP
+#define NVUI_CMDLINE_LAYOUT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/// The horizontal layout of one command line line: the advance of every
+/// character and where the line wraps.
+/// Only the advances need the font, so they are kept for as long as the
+/// text doesn't change (and a changed line only measures what comes
+/// after the part that stayed the same). Wrapping only looks at the
+/// advances, and is redone when the available width changes.
+class CmdLineLayout
+{
+public:
+  /// Number of characters in the line.
+  std::size_t size() const { return x.size() - 1; }
+  /// Keep the first n characters.
+  void truncate(std::size_t n)
+  {
+    x.resize(std::min(n, size()) + 1);
+    wrap_width = -1;
+  }
+  void push(int advance)
+  {
+    x.push_back(x.back() + advance);
+    wrap_width = -1;
+  }
+  /**
+   * Wrap the line, with the first row starting at start, the
+   * rest starting at base, and every row ending at max_width.
+   * A character that doesn't fit goes on the next row.
+   * Does nothing if the line is already wrapped this way.
+   */
+  void wrap(int start, int base, int max_width)
+  {
+    if (wrap_width == max_width && wrap_start == start && wrap_base == base)
+    {
+      return;
+    }
+    wrap_width = max_width;
+    wrap_start = start;
+    wrap_base = base;
+    breaks.clear();
+    int row_start = 0;
+    int origin = start;
+    for(std::size_t i = 0; i < size(); ++i)
+    {
+      if (origin + x[i + 1] - row_start > max_width)
+      {
+        breaks.push_back(i);
+        row_start = x[i];
+        origin = base;
+      }
+    }
+  }
+  /// Number of rows the wrapped line takes up.
+  std::size_t rows() const { return breaks.size() + 1; }
+  /// The characters [first, last) on the given row.
+  std::pair<std::size_t, std::size_t> row_range(std::size_t row) const
+  {
+    const std::size_t first = row == 0 ? 0 : breaks[row - 1];
+    const std::size_t last = row < breaks.size() ? breaks[row] : size();
+    return {first, last};
+  }
+  /// The row that character i (or the end of the line, if i == size())
+  /// is on and its x-coordinate.
+  std::pair<std::size_t, int> position(std::size_t i) const
+  {
+    i = std::min(i, size());
+    const auto row = static_cast<std::size_t>(
+      std::upper_bound(breaks.begin(), breaks.end(), i) - breaks.begin()
+    );
+    const auto first = row_range(row).first;
+    const int origin = row == 0 ? wrap_start : wrap_base;
+    return {row, origin + x[i] - x[first]};
+  }
+private:
+  /// x[i] is the sum of the advances of the characters before i.
+  std::vector<int> x {0};
+  /// Index of the first character of every row after the first.
+  std::vector<std::size_t> breaks;
+  int wrap_width = -1;
+  int wrap_start = 0;
+  int wrap_base = 0;
+};
+
+#endif // NVUI_CMDLINE_LAYOUT_HPP
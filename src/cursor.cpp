@@ -3,7 +3,6 @@
 #include "grid.hpp"
 #include <fmt/core.h>
 #include <fmt/format.h>
-#include <QElapsedTimer>
 
 using scalers::time_scaler;
 time_scaler Cursor::animation_scaler = scalers::oneminusexpo2negative10;
@@ -36,29 +35,34 @@ Cursor::Cursor(EditorArea* ea)
 {
   assert(ea);
   editor_area = ea;
-  cursor_animation_timer.callOnTimeout([this] {
-    auto elapsed_ms = elapsed_timer.elapsed();
-    cursor_animation_time -= static_cast<float>(elapsed_ms) / 1000.f;
-    if (cursor_animation_time <= 0.f)
-    {
-      cursor_animation_timer.stop();
-      cur_x = destination_x;
-      cur_y = destination_y;
-    }
-    else
-    {
-      auto x_diff = destination_x - old_x;
-      auto y_diff = destination_y - old_y;
-      auto duration = editor_area->cursor_animation_duration();
-      auto animation_left = cursor_animation_time / duration;
-      float animation_finished = 1.0f - animation_left;
-      float scaled = animation_scaler(animation_finished);
-      cur_x = old_x + (x_diff * scaled);
-      cur_y = old_y + (y_diff * scaled);
-    }
-    editor_area->update();
-    elapsed_timer.start();
-  });
+}
+
+Cursor::~Cursor()
+{
+  if (editor_area)
+  {
+    editor_area->frame_scheduler().stop_animation(&cursor_animation_time);
+  }
+}
+
+bool Cursor::step_animation(float dt)
+{
+  cursor_animation_time -= dt;
+  if (cursor_animation_time <= 0.f)
+  {
+    cur_x = destination_x;
+    cur_y = destination_y;
+    return false;
+  }
+  auto x_diff = destination_x - old_x;
+  auto y_diff = destination_y - old_y;
+  auto duration = editor_area->cursor_animation_duration();
+  auto animation_left = cursor_animation_time / duration;
+  float animation_finished = 1.0f - animation_left;
+  float scaled = animation_scaler(animation_finished);
+  cur_x = old_x + (x_diff * scaled);
+  cur_y = old_y + (y_diff * scaled);
+  return true;
 }
 
 void Cursor::mode_change(std::span<const Object> objs)
@@ -157,6 +161,7 @@ void Cursor::reset_timers() noexcept
   // Blinking works like this:
   // First of all, if any of the numbers are 0, then there is no blinking.
   if (cur_mode.blinkwait == 0 || cur_mode.blinkoff == 0 || cur_mode.blinkon == 0) return;
+  if (blinking_suspended) return;
   // 1. Cursor starts in a solid (visible) state.
   // 2. Cursor stays that way for 'blinkon' ms.
   // 3. After 'blinkon' ms, the cursor becomes hidden
@@ -172,6 +177,13 @@ void Cursor::reset_timers() noexcept
   blinkwait_timer.start(cur_mode.blinkwait);
 }
 
+void Cursor::set_blinking_suspended(bool suspend)
+{
+  if (suspend == blinking_suspended) return;
+  blinking_suspended = suspend;
+  reset_timers();
+}
+
 void Cursor::set_blinkoff_timer(int ms) noexcept
 {
   blinkoff_timer.start(ms);
@@ -205,7 +217,10 @@ void Cursor::go_to(CursorPos pos)
   prev_pos = cur_pos;
   if (!use_animated_position())
   {
-    cursor_animation_timer.stop();
+    if (editor_area)
+    {
+      editor_area->frame_scheduler().stop_animation(&cursor_animation_time);
+    }
     cur_pos = pos;
   }
   else
@@ -216,13 +231,19 @@ void Cursor::go_to(CursorPos pos)
     destination_x = cur_pos->grid_x + cur_pos->col;
     destination_y = cur_pos->grid_y + cur_pos->row;
     cursor_animation_time = editor_area->cursor_animation_duration();
-    auto interval = editor_area->cursor_animation_frametime();
-    elapsed_timer.start();
-    if (cursor_animation_timer.interval() != interval)
-    {
-      cursor_animation_timer.setInterval(interval);
-    }
-    if (!cursor_animation_timer.isActive()) cursor_animation_timer.start();
+    // Each step only repaints where the cursor was and is now
+    editor_area->frame_scheduler().start_animation(
+      &cursor_animation_time,
+      [this](float dt) {
+        QRegion damage = editor_area->cursor_damage();
+        const bool running = step_animation(dt);
+        damage += editor_area->cursor_damage();
+        editor_area->frame_scheduler().request_frame(damage);
+        return running;
+      },
+      editor_area->cursor_animation_frametime(),
+      true
+    );
   }
   reset_timers();
 }
@@ -1,7 +1,6 @@
 #ifndef NVUI_CURSOR_HPP
 #define NVUI_CURSOR_HPP
 
-#include <QElapsedTimer>
 #include <QRect>
 #include <QTimer>
 #include <cstdint>
@@ -70,6 +69,7 @@ public:
   static scalers::time_scaler animation_scaler;
   Cursor();
   Cursor(EditorArea* editor_area);
+  ~Cursor();
   /**
    * Handles a 'mode_info_set' Neovim redraw event.
    */
@@ -126,6 +126,11 @@ public:
    * showing the cursor once again
    */
   void busy_stop();
+  /**
+   * Stops blinking (the cursor stays visible) until
+   * it's called with false, e.g. while the window is hidden.
+   */
+  void set_blinking_suspended(bool suspend);
   inline void set_caret_extend(float top = 0.f, float bottom = 0.f)
   {
     caret_extend_top = top;
@@ -154,6 +159,7 @@ private:
   QTimer blinkwait_timer;
   QTimer blinkon_timer;
   QTimer blinkoff_timer;
+  bool blinking_suspended = false;
   int row = 0;
   int col = 0;
   std::optional<CursorPos> cur_pos;
@@ -172,14 +178,13 @@ private:
   float old_y = 0.f;
   float destination_x = 0.f;
   float destination_y = 0.f;
-  QTimer cursor_animation_timer {};
-  // Check the actual amount of time that passed between
-  // each animation update
-  QElapsedTimer elapsed_timer {};
 signals:
   void cursor_visible();
   void cursor_hidden();
 private:
+  /// Advance the cursor's move animation by dt seconds.
+  /// Returns false once it has finished.
+  bool step_animation(float dt);
   /**
    * Stop/restart the timers.
    * This should be activated after the mode
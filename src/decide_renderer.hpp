@@ -5,3 +5,9 @@
 #else
 #define USE_QPAINTER 1
 #endif
+
+/// Draw QPainter grids from a glyph atlas instead of shaping text runs
+/// (see AtlasPaintGrid). Enable with -DNVUI_GLYPH_ATLAS=ON.
+#if defined(USE_QPAINTER) && defined(NVUI_GLYPH_ATLAS)
+#define USE_GLYPH_ATLAS 1
+#endif
@@ -0,0 +1,151 @@
+#ifndef NVUI_DECORATION_TILE_HPP
+#define NVUI_DECORATION_TILE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+#include "lru_cache.hpp"
+
+/// Undercurls drawn from a pre-rendered tile instead of a path.
+/// The tile holds one period of the wave (one cell), and the grids
+/// fill every undercurled run with it as a repeating pattern, so a
+/// run costs one fill no matter how long it is. The tile only
+/// depends on the cell size and the color, and is cached by each
+/// grid for both renderers (see TileCache).
+namespace decoration
+{
+  using u8 = std::uint8_t;
+  using u32 = std::uint32_t;
+
+  /// The shape of the wave: a zigzag that starts at the top, reaches
+  /// the bottom of the cell halfway through it and is back at the top
+  /// at the end of it.
+  struct Undercurl
+  {
+    /// Width of one period (and of the tile) in pixels. The cell
+    /// width, rounded so that tiles line up.
+    int period;
+    /// Height of the tile, which sits on the bottom of the cell.
+    int height;
+    /// How far the top of the wave is above the bottom of the cell.
+    float amplitude;
+    float thickness;
+  };
+
+  inline Undercurl undercurl(float cell_width, float cell_height, float thickness = 1.f)
+  {
+    const float amplitude = std::min(cell_height / 5.f, 3.f);
+    return {
+      std::max(2, int(std::lround(cell_width))),
+      std::max(1, int(std::ceil(amplitude + thickness / 2.f))),
+      amplitude,
+      thickness
+    };
+  }
+
+  /// Coverage (0-255) of each pixel of the tile, row by row.
+  inline std::vector<u8> coverage(const Undercurl& u)
+  {
+    const float p = float(u.period);
+    const float bot = float(u.height);
+    const float top = bot - u.amplitude;
+    // One period on either side, so the distance is
+    // right across the tile's edges
+    std::array<std::array<float, 2>, 7> pts;
+    for(int k = 0; k < int(pts.size()); ++k)
+    {
+      pts[k] = {float(k - 2) * p / 2.f, (k % 2 == 0) ? top : bot};
+    }
+    const auto distance = [&](float x, float y) {
+      float best = std::numeric_limits<float>::infinity();
+      for(std::size_t k = 0; k + 1 < pts.size(); ++k)
+      {
+        const auto [ax, ay] = pts[k];
+        const auto [bx, by] = pts[k + 1];
+        const float dx = bx - ax;
+        const float dy = by - ay;
+        const float t = std::clamp(
+          ((x - ax) * dx + (y - ay) * dy) / (dx * dx + dy * dy), 0.f, 1.f
+        );
+        best = std::min(best, std::hypot(x - (ax + t * dx), y - (ay + t * dy)));
+      }
+      return best;
+    };
+    std::vector<u8> res(std::size_t(u.period) * u.height);
+    for(int y = 0; y < u.height; ++y)
+    {
+      for(int x = 0; x < u.period; ++x)
+      {
+        const float d = distance(float(x) + .5f, float(y) + .5f);
+        const float c = std::clamp(u.thickness / 2.f + .5f - d, 0.f, 1.f);
+        res[std::size_t(y) * u.period + x] = u8(std::lround(c * 255.f));
+      }
+    }
+    return res;
+  }
+
+  /// The tile's pixels in rgb (0xRRGGBB), as premultiplied 0xAARRGGBB
+  /// (QImage::Format_ARGB32_Premultiplied, and
+  /// DXGI_FORMAT_B8G8R8A8_UNORM with premultiplied alpha).
+  inline std::vector<u32> pixels(const Undercurl& u, u32 rgb)
+  {
+    const auto cov = coverage(u);
+    std::vector<u32> res(cov.size());
+    const auto scale = [](u32 channel, u32 a) { return (channel * a + 127) / 255; };
+    for(std::size_t i = 0; i < cov.size(); ++i)
+    {
+      const u32 a = cov[i];
+      res[i] = a << 24
+        | scale((rgb >> 16) & 0xff, a) << 16
+        | scale((rgb >> 8) & 0xff, a) << 8
+        | scale(rgb & 0xff, a);
+    }
+    return res;
+  }
+
+  struct TileKey
+  {
+    int period;
+    int height;
+    /// Amplitude and thickness in 1/64 pixels.
+    int amplitude;
+    int thickness;
+    u32 rgb;
+    bool operator==(const TileKey&) const = default;
+  };
+
+  inline TileKey key_of(const Undercurl& u, u32 rgb)
+  {
+    return {
+      u.period, u.height,
+      int(std::lround(u.amplitude * 64.f)), int(std::lround(u.thickness * 64.f)),
+      rgb
+    };
+  }
+
+  struct TileKeyHash
+  {
+    std::size_t operator()(const TileKey& k) const noexcept
+    {
+      std::size_t h = std::hash<u32>()(k.rgb);
+      for(int v : {k.period, k.height, k.amplitude, k.thickness})
+      {
+        h = h * 31 + std::size_t(v);
+      }
+      return h;
+    }
+  };
+
+  /// Few colors are used for undercurls (usually one per
+  /// diagnostic severity).
+  inline constexpr std::size_t tile_cache_size = 16;
+  template<typename Tile, typename Deleter = do_nothing_deleter<Tile>>
+  using TileCache = LRUCache<TileKey, Tile, Deleter, TileKeyHash>;
+}
+
+#endif // NVUI_DECORATION_TILE_HPP
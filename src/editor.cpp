@@ -1,18 +1,29 @@
 #include "editor.hpp"
 #include "input.hpp"
 #include "msgpack_overrides.hpp"
+#include "fallback_cache.hpp"
+#include "shared_store.hpp"
+#include "perf_hud.hpp"
 #include "utils.hpp"
 #include <chrono>
 #include <limits>
 #include <QApplication>
 #include <QDebug>
+#include <QDateTime>
 #include <QDesktopWidget>
+#include <QDir>
 #include <QFileInfo>
+#include <QFontInfo>
 #include <QMimeData>
 #include <QPainter>
+#include <QRawFont>
+#include <QSaveFile>
 #include <QScreen>
+#include <QStandardPaths>
+#include <QStringBuilder>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <locale>
 #include <QSizePolicy>
@@ -26,6 +37,15 @@
 using u16 = std::uint16_t;
 using u32 = std::uint32_t;
 
+/// Fallback tables of every editor in the process, by the key of their fonts.
+static SharedStore<std::uint64_t, SharedFallback>& fallback_store()
+{
+  static SharedStore<std::uint64_t, SharedFallback> store;
+  return store;
+}
+static bool load_fallback_cache(SharedFallback& fallback);
+static void save_fallback_cache(SharedFallback& fallback);
+
 static float get_offset(const QFont& font, const float linespacing)
 {
   QFontMetricsF fm {font};
@@ -73,6 +93,7 @@ static void set_relative_font_size(
 
 EditorArea::EditorArea(QWidget* parent, HLState* hl_state, Nvim* nv)
 : QWidget(parent),
+  scheduler(this),
   state(hl_state),
   nvim(nv),
   pixmap(width(), height()),
@@ -89,17 +110,33 @@ EditorArea::EditorArea(QWidget* parent, HLState* hl_state, Nvim* nv)
   setFocusPolicy(Qt::StrongFocus);
   setFocus();
   setMouseTracking(true);
+  fallback_pool.setMaxThreadCount(1);
   font.setPointSizeF(11.25);
   fonts.push_back({font});
   update_font_metrics(true);
+  live_resize_timer.setSingleShot(true);
+  live_resize_timer.setInterval(live_resize_settle_ms);
+  QObject::connect(&live_resize_timer, &QTimer::timeout, this, [this] {
+    if (!live_resize_held) end_live_resize();
+  });
   QObject::connect(&neovim_cursor, &Cursor::cursor_hidden, this, [this] {
-    update();
+    scheduler.request_frame(cursor_damage());
   });
   QObject::connect(&neovim_cursor, &Cursor::cursor_visible, this, [this] {
-    update();
+    scheduler.request_frame(cursor_damage());
   });
 }
 
+EditorArea::~EditorArea()
+{
+  // Nvim's writer thread may still be running
+  if (nvim) nvim->set_latency_trace(nullptr);
+  // Cancel any prewarm that's still running
+  ++fallback_generation;
+  fallback_pool.waitForDone();
+  if (fallback) save_fallback_cache(*fallback);
+}
+
 void EditorArea::grid_resize(std::span<NeovimObj> objs)
 {
   // Should only run once
@@ -116,7 +153,12 @@ void EditorArea::grid_resize(std::span<NeovimObj> objs)
     }
     else
     {
-      create_grid(0, 0, width, height, grid_num);
+      if (auto pooled = grid_pool.acquire(width, height))
+      {
+        pooled->reuse(0, 0, width, height, grid_num);
+        grids.push_back(std::move(pooled));
+      }
+      else create_grid(0, 0, width, height, grid_num);
       grid = find_grid(grid_num);
       // Created grid appears above all others
       move_to_top(grid);
@@ -128,58 +170,27 @@ void EditorArea::grid_resize(std::span<NeovimObj> objs)
   }
 }
 
-void EditorArea::grid_line(std::span<NeovimObj> objs)
+void EditorArea::grid_line(GridLines& lines, std::size_t count)
 {
-  int hl_id = 0;
-  for(auto& grid_cmd : objs)
+  for(std::size_t i = 0; i < count; ++i)
   {
-    auto* arr = grid_cmd.array();
-    assert(arr && arr->size() >= 4);
-    const auto grid_num = arr->at(0).get<u64>();
-    GridBase* grid_ptr = find_grid(grid_num);
-    if (!grid_ptr) continue;
-    if (!grid_ptr) return;
-    GridBase& g = *grid_ptr;
-    int start_row = (int) arr->at(1);
-    int start_col = (int) arr->at(2);
-    int col = start_col;
-    auto cells = arr->at(3).array();
-    assert(cells);
-    for(auto& cell : *cells)
+    const auto* line = lines.next();
+    if (!line) return;
+    GridBase* grid = find_grid(line->grid);
+    if (!grid) continue;
+    const auto cells = lines.cells_of(*line);
+    if (cells.empty()) continue;
+    // If the line starts after a double-width char,
+    // its first cell is an empty string.
+    const std::size_t idx = std::size_t(line->row) * grid->cols + line->col;
+    if (cells.front().empty() && line->col > 0 && idx - 1 < grid->area.size())
     {
-      assert(cell.has<ObjectArray>());
-      auto& cell_arr = cell.get<ObjectArray>();
-      assert(cell_arr.size() >= 1 && cell_arr.size() <= 3);
-      // [text, (hl_id, repeat)]
-      int repeat = 1;
-      assert(cell_arr.at(0).is_string());
-      grid_char text = GridChar::grid_char_from_str(cell_arr[0].get<std::string>());
-      // If the previous char was a double-width char,
-      // the current char is an empty string.
-      bool prev_was_dbl = text.isEmpty();
-      bool is_dbl = false;
-      if (prev_was_dbl)
-      {
-        std::size_t idx = start_row * grid_ptr->cols + col - 1;
-        if (idx < grid_ptr->area.size())
-        {
-          grid_ptr->area[idx].double_width = true;
-        }
-      }
-      switch(cell_arr.size())
-      {
-        case 2:
-          hl_id = (int) cell_arr.at(1);
-          break;
-        case 3:
-          hl_id = (int) cell_arr.at(1);
-          repeat = (int) cell_arr.at(2);
-          break;
-      }
-      g.set_text(std::move(text), start_row, col, hl_id, repeat, is_dbl);
-      col += repeat;
+      grid->area[idx - 1].set_double_width(true);
     }
-    send_draw(grid_num, {start_col, start_row, (col - start_col), 1});
+    grid->set_cells(line->row, line->col, cells);
+    grid->send_draw_changed(
+      {line->col, line->row, int(cells.size()), 1}, state->generation()
+    );
   }
 }
 
@@ -255,7 +266,62 @@ void EditorArea::flush()
     //);
   //}
   sort_grids_by_z_index();
-  update();
+  if (is_suspended)
+  {
+    // Nothing is painted until the window is shown again,
+    // so don't let the paint events pile up
+    for(auto& grid : grids) grid->send_redraw();
+  }
+  perf.content_flushed();
+  latency.mark(LatencyTrace::Flush);
+  scheduler.request_frame(take_damage());
+  enforce_memory_budget();
+}
+
+QRegion EditorArea::take_damage()
+{
+  std::vector<GridLayout> layout;
+  layout.reserve(grids.size());
+  for(const auto& grid : grids)
+  {
+    layout.push_back({
+      grid->id, grid->x, grid->y, grid->cols, grid->rows, grid->hidden
+    });
+  }
+  const QColor bg = default_bg();
+  QRegion damage;
+  if (layout != damage_layout || bg != damage_bg)
+  {
+    damage = rect();
+    damage_layout = std::move(layout);
+    damage_bg = bg;
+  }
+  for(auto& grid : grids)
+  {
+    // Still has to be taken, so that it isn't reported next time
+    const QRegion cells = grid->take_damage();
+    if (grid->hidden) continue;
+    for(const QRect& r : cells)
+    {
+      damage += to_pixels(grid->x + r.x(), grid->y + r.y(), r.width(), r.height());
+    }
+  }
+  return damage + cursor_damage();
+}
+
+QRegion EditorArea::cursor_damage() const
+{
+  QRegion damage;
+  // Big enough for double-width characters
+  if (auto r = neovim_cursor.rect(font_width, font_height, 2.f))
+  {
+    damage += r->rect.toAlignedRect().adjusted(-1, -1, 1, 1);
+  }
+  if (auto r = neovim_cursor.old_rect(font_width, font_height))
+  {
+    damage += r->rect.toAlignedRect().adjusted(-1, -1, int(std::ceil(font_width)) + 1, 1);
+  }
+  return damage;
 }
 
 void EditorArea::win_pos(std::span<NeovimObj> objs)
@@ -333,7 +399,7 @@ void EditorArea::win_float_pos(std::span<NeovimObj> objs)
       const float pum_ty = std::ceil(pum_tr.y() / font_h);
       anchor_pos = QPoint(pum_rx, pum_ty);
     }
-    bool were_animations_enabled = animations_enabled();
+    const bool were_animations_enabled = animate;
     set_animations_enabled(false);
     grid->winid = get_win(win);
     move_to_top(grid);
@@ -458,8 +524,10 @@ void EditorArea::set_guifont(QString new_font)
     new_font = default_font_family();
   }
   const QStringList lst = new_font.split(",");
+  if (fallback) save_fallback_cache(*fallback);
   fonts.clear();
-  font_for_unicode.clear();
+  fallback.reset();
+  ++fallback_generation;
   // No need for complicated stuff if there's only one font to deal with
   if (lst.size() == 0) return;
   auto [font_name, font_size, font_opts] = parse_guifont(lst.at(0));
@@ -493,6 +561,20 @@ void EditorArea::set_guifont(QString new_font)
     Font fo = f;
     fonts.push_back(std::move(fo));
   }
+  // Probing is slow, another session may have done it already,
+  // or what the last launch found for these fonts is on disk
+  if (fonts.size() > 1)
+  {
+    const auto key = fallback_cache_key();
+    fallback = fallback_store().get(key, [&] {
+      auto shared = std::make_shared<SharedFallback>();
+      shared->key = key;
+      shared->num_fonts = u32(fonts.size());
+      load_fallback_cache(*shared);
+      return shared;
+    });
+  }
+  prewarm_fallback_table();
   update_font_metrics(true);
   resized(size());
   send_redraw();
@@ -548,22 +630,50 @@ QSize EditorArea::to_rc(const QSize& pixel_size)
 
 void EditorArea::paintEvent(QPaintEvent* event)
 {
-  Q_UNUSED(event);
+  const auto frame_start = std::chrono::steady_clock::now();
+  // Only what changed since the last frame (see take_damage),
+  // unless Qt needs all of it
+  const QRegion& damage = event->region();
   QPainter p(this);
-  p.fillRect(rect(), default_bg());
+  for(const QRect& r : damage) p.fillRect(r, default_bg());
   QRectF grid_clip_rect(0, 0, cols * font_width, rows * font_height);
   p.setClipRect(grid_clip_rect);
+  // Grids don't depend on each other until they're composited,
+  // so the dirty ones are rasterized in parallel. Once their fallback
+  // fonts are resolved, everything they share is only read.
+  std::vector<QPaintGrid*> dirty_grids;
   for(auto& grid_base : grids)
   {
     auto* grid = static_cast<QPaintGrid*>(grid_base.get());
-    if (!grid->hidden)
+    if (grid->hidden || !grid->has_pending_paint()) continue;
+    grid->resolve_fonts();
+    dirty_grids.push_back(grid);
+  }
+  static const bool threaded_text = QFontDatabase::supportsThreadedFontRendering();
+  if (dirty_grids.size() > 1 && threaded_text)
+  {
+    for(std::size_t i = 1; i < dirty_grids.size(); ++i)
     {
-      QSize size = grid->buffer().size();
-      auto r = QRectF(grid->pos(), size).intersected(grid_clip_rect);
-      p.setClipRect(r);
-      grid->process_events();
-      grid->render(p);
+      raster_pool.start([grid = dirty_grids[i]] { grid->process_events(); });
     }
+    dirty_grids.front()->process_events();
+    raster_pool.waitForDone();
+  }
+  else
+  {
+    for(auto* grid : dirty_grids) grid->process_events();
+  }
+  // In z order, but only the grids under the damage
+  for(auto& grid_base : grids)
+  {
+    auto* grid = static_cast<QPaintGrid*>(grid_base.get());
+    if (grid->hidden) continue;
+    QSize size = grid->buffer().size();
+    auto r = QRectF(grid->pos(), size).intersected(grid_clip_rect);
+    const QRegion visible = damage.intersected(r.toAlignedRect());
+    if (visible.isEmpty()) continue;
+    p.setClipRegion(visible);
+    grid->render(p);
   }
   p.setClipRect(rect());
   if (!neovim_cursor.hidden() && cmdline.isHidden())
@@ -574,6 +684,158 @@ void EditorArea::paintEvent(QPaintEvent* event)
   {
     draw_popup_menu();
   } else popup_menu.setVisible(false);
+  const auto frame_end = std::chrono::steady_clock::now();
+  perf.add_frame(std::chrono::duration<double, std::milli>(
+    frame_end - frame_start
+  ).count());
+  perf.frame_painted(frame_end);
+  latency.mark(LatencyTrace::Present, frame_end);
+}
+
+std::vector<std::pair<std::string, double>> EditorArea::perf_report()
+{
+  using namespace std::chrono;
+  static const auto start_time = steady_clock::now();
+  constexpr double mb = 1024. * 1024.;
+  const double now = duration<double>(steady_clock::now() - start_time).count();
+  const std::uint64_t bytes = nvim ? nvim->bytes_received() : 0;
+  const auto rates = perf.update_rates(now, bytes);
+  CacheStats cache;
+  std::size_t buffers = 0;
+  for(const auto& grid : grids)
+  {
+    const auto stats = grid->text_cache_stats();
+    cache.hits += stats.hits;
+    cache.misses += stats.misses;
+    buffers += grid->buffer_memory();
+  }
+  buffers += grid_pool.buffer_memory();
+  update_memory_usage();
+  std::uint64_t evicted = 0;
+  for(std::size_t pool = 0; pool < MemoryBudget::num_evictable; ++pool)
+  {
+    evicted += memory.evicted_bytes(MemoryBudget::Pool(pool));
+  }
+  const auto lookups = cache.hits + cache.misses;
+  return {
+    {"first_frame_ms", perf.first_frame_time()},
+    {"frame_time_avg_ms", perf.frame_time_avg()},
+    {"frame_time_p99_ms", perf.frame_time_percentile(0.99)},
+    {"frame_time_max_ms", perf.frame_time_max()},
+    {"frames", double(perf.frames())},
+    {"redraw_batches_per_s", rates.batches},
+    {"redraw_events_per_s", rates.events},
+    {"decoded_mb_per_s", rates.bytes / mb},
+    {"decoded_mb", double(bytes) / mb},
+    {"redraw_queue_depth", double(perf.queue_depth.load())},
+    {"text_cache_hit_rate", lookups ? double(cache.hits) / double(lookups) : 0.},
+    {"grid_buffer_mb", double(buffers) / mb},
+    {"snapshot_mb", double(snapshot_memory()) / mb},
+    {"memory_budget_mb", double(memory.budget()) / mb},
+    {"memory_total_mb", double(memory.total()) / mb},
+    {"text_layout_mb", double(memory.usage(MemoryBudget::TextLayouts)) / mb},
+    {"hidden_buffer_mb", double(memory.usage(MemoryBudget::HiddenBuffers)) / mb},
+    {"widget_mb", double(memory.usage(MemoryBudget::Widgets)) / mb},
+    {"evicted_mb", double(evicted) / mb},
+  };
+}
+
+void EditorArea::set_memory_budget(std::size_t bytes)
+{
+  memory.set_budget(bytes);
+  enforce_memory_budget();
+}
+
+void EditorArea::set_suspended(bool suspend)
+{
+  if (suspend == is_suspended) return;
+  is_suspended = suspend;
+  neovim_cursor.set_blinking_suspended(suspend);
+  if (!suspend)
+  {
+    for(auto& grid : grids) grid->send_redraw();
+    scheduler.request_frame();
+  }
+  scheduler.set_suspended(suspend);
+}
+
+void EditorArea::update_memory_usage()
+{
+  std::size_t snapshots = 0;
+  std::size_t layouts = 0;
+  std::size_t hidden = grid_pool.buffer_memory();
+  std::size_t visible = 0;
+  for(const auto& grid : grids)
+  {
+    snapshots += grid->snapshot_memory();
+    layouts += grid->text_cache_memory();
+    (grid->hidden ? hidden : visible) += grid->buffer_memory();
+  }
+  const auto pixmap_bytes = [](const QPixmap& p) {
+    return std::size_t(p.width()) * p.height() * (p.depth() / 8);
+  };
+  memory.set_usage(MemoryBudget::Snapshots, snapshots);
+  memory.set_usage(MemoryBudget::TextLayouts, layouts);
+  memory.set_usage(MemoryBudget::HiddenBuffers, hidden);
+  memory.set_usage(MemoryBudget::Buffers, visible);
+  memory.set_usage(
+    MemoryBudget::Widgets, popup_menu.memory_usage() + pixmap_bytes(pixmap)
+  );
+}
+
+void EditorArea::enforce_memory_budget()
+{
+  if (!memory.budget()) return;
+  update_memory_usage();
+  const auto plan = memory.plan();
+  // Frees from each grid in turn until enough was freed
+  const auto free_from_grids = [&](
+    MemoryBudget::Pool pool, std::size_t freed, auto&& free
+  ) {
+    for(auto& grid : grids)
+    {
+      if (freed >= plan[pool]) break;
+      freed += free(*grid, plan[pool] - freed);
+    }
+    memory.evicted(pool, freed);
+  };
+  if (plan[MemoryBudget::Snapshots])
+  {
+    free_from_grids(MemoryBudget::Snapshots, 0, [](GridBase& g, std::size_t) {
+      return g.drop_snapshots();
+    });
+  }
+  if (plan[MemoryBudget::TextLayouts])
+  {
+    free_from_grids(MemoryBudget::TextLayouts, 0, [](GridBase& g, std::size_t left) {
+      return g.trim_text_cache(left);
+    });
+  }
+  if (plan[MemoryBudget::HiddenBuffers])
+  {
+    // Grids that were destroyed are less likely to be needed
+    // again than hidden grids
+    const std::size_t pooled = grid_pool.buffer_memory();
+    grid_pool.clear();
+    free_from_grids(MemoryBudget::HiddenBuffers, pooled, [](GridBase& g, std::size_t) {
+      return g.drop_buffer();
+    });
+  }
+}
+
+void EditorArea::set_perf_hud_visible(bool visible)
+{
+  if (!perf_hud)
+  {
+    if (!visible) return;
+    perf_hud = new PerfHud(this);
+  }
+  perf_hud->setVisible(visible);
+}
+
+void EditorArea::toggle_perf_hud()
+{
+  set_perf_hud_visible(!perf_hud || perf_hud->isHidden());
 }
 
 FontDimensions EditorArea::font_dimensions() const
@@ -586,7 +848,7 @@ void EditorArea::resized(QSize sz)
   Q_UNUSED(sz);
   const QSize new_rc = to_rc(size());
   assert(nvim);
-  if (resizing)
+  if (resize_in_flight)
   {
     queued_resize = new_rc;
     return;
@@ -600,11 +862,11 @@ void EditorArea::resized(QSize sz)
   cmdline.parent_resized(size());
   popup_menu.cmdline_width_changed(cmdline.width());
   reposition_cmdline();
-  resizing = true;
+  resize_in_flight = true;
   nvim->resize_cb(new_rc.width(), new_rc.height(), [&](auto res, auto err) {
     Q_UNUSED(res); Q_UNUSED(err);
     QMetaObject::invokeMethod(this, [this] {
-      resizing = false;
+      resize_in_flight = false;
       if (queued_resize)
       {
         resized(queued_resize.value());
@@ -638,10 +900,7 @@ void EditorArea::grid_clear(std::span<NeovimObj> objs)
     const auto grid_num = arr->at(0).u64();
     assert(grid_num);
     auto* grid = find_grid(*grid_num);
-    for(auto& gc : grid->area)
-    {
-      gc = {0, " ", false, QChar(' ').unicode()};
-    }
+    std::fill(grid->area.begin(), grid->area.end(), GridChar(' ', 0));
     QRect&& r = {grid->x, grid->y, grid->cols, grid->rows};
     send_clear(*grid_num, r);
   }
@@ -656,29 +915,48 @@ void EditorArea::grid_scroll(std::span<NeovimObj> objs)
     const auto [grid_num, top, bot, left, right, rows] = *vars;
     // const int cols = arr->at(6);
     GridBase* grid = find_grid(grid_num);
-    if (!grid) return;
-    if (rows > 0)
+    if (!grid) continue;
+    assert(bot <= grid->rows);
+    const int cols = grid->cols;
+    const int width = std::min<int>(right, cols) - left;
+    // Number of rows that are kept (moved), the rest are
+    // redrawn by grid_line events that follow.
+    const int count = (bot - top) - std::abs(rows);
+    if (rows != 0 && width > 0 && count > 0)
     {
-      for(int y = top; y < (bot - rows); ++y)
+      const int dst_top = rows > 0 ? top : top - rows;
+      const int src_top = dst_top + rows;
+      GridChar* data = grid->area.data();
+      if (width == cols)
       {
-        for(int x = left; x < right && x < grid->cols; ++x)
-        {
-          grid->area[y * grid->cols + x] = std::move(grid->area[(y + rows) * grid->cols + x]);
-        }
+        // Full-width region, the rows are contiguous
+        std::memmove(
+          data + dst_top * cols, data + src_top * cols,
+          sizeof(GridChar) * count * cols
+        );
       }
-    }
-    else if (rows < 0)
-    {
-      for(int y = (bot-1); y >= (top - rows); --y)
+      else
       {
-        for(int x = left; x <= right && x < grid->cols; ++x)
+        // Copy in the direction that doesn't overwrite
+        // rows we haven't copied yet
+        for(int i = 0; i < count; ++i)
         {
-          grid->area[y * grid->cols + x] = std::move(grid->area[(y + rows) * grid->cols + x]);
+          const int row = rows > 0 ? i : count - 1 - i;
+          std::memmove(
+            data + (dst_top + row) * cols + left,
+            data + (src_top + row) * cols + left,
+            sizeof(GridChar) * width
+          );
         }
       }
     }
     auto rect = QRect(left, top, (right - left), (bot - top));
-    send_draw(grid_num, rect);
+    // Blitting only lines up with the cells when they're a
+    // whole number of pixels, otherwise redraw the region.
+    const bool can_blit = std::floor(font_height) == font_height
+      && (width == cols || std::floor(font_width) == font_width);
+    if (can_blit && count > 0) grid->send_scroll(rect, rows);
+    else send_draw(grid_num, rect);
   }
 }
 
@@ -712,11 +990,22 @@ static std::string mouse_mods_to_string(
 
 void EditorArea::set_resizing(bool is_resizing)
 {
-  resizing = is_resizing;
+  live_resize_held = is_resizing;
+  if (is_resizing) live_resize = true;
+  else end_live_resize();
+}
+
+void EditorArea::end_live_resize()
+{
+  live_resize_timer.stop();
+  if (!live_resize) return;
+  live_resize = false;
+  for(auto& grid : grids) grid->trim_buffer();
 }
 
 void EditorArea::keyPressEvent(QKeyEvent* event)
 {
+  const auto pressed = LatencyTrace::Clock::now();
   if (hide_cursor_while_typing && cursor() != Qt::BlankCursor)
   {
     setCursor(Qt::BlankCursor);
@@ -724,6 +1013,7 @@ void EditorArea::keyPressEvent(QKeyEvent* event)
   event->accept();
   auto text = convert_key(*event);
   if (text.empty()) return;
+  latency.mark(LatencyTrace::Key, pressed);
   nvim->send_input(std::move(text));
 }
 
@@ -835,31 +1125,173 @@ void EditorArea::dragEnterEvent(QDragEnterEvent* event)
   if (event->mimeData()->hasUrls()) event->acceptProposedAction();
 }
 
-void EditorArea::set_fallback_for_ucs(u32 ucs)
+/// Index of the first font in raw_fonts that has a glyph for ucs,
+/// or 0 (the main font) if none of them do.
+static std::uint8_t probe_fallback(std::span<const QRawFont> raw_fonts, u32 ucs)
 {
-  for(u32 i = 0; i < fonts.size(); ++i)
+  const auto size = std::min<std::size_t>(raw_fonts.size(), FallbackTable::max_index + 1);
+  for(std::size_t i = 0; i < size; ++i)
   {
-    if (fonts[i].raw().supportsCharacter(ucs))
-    {
-      font_for_unicode[ucs] = i;
-      return;
-    }
+    if (raw_fonts[i].supportsCharacter(ucs)) return std::uint8_t(i);
   }
-  font_for_unicode[ucs] = 0;
+  return 0;
+}
+
+void EditorArea::set_fallback_for_ucs(u32 ucs)
+{
+  std::vector<QRawFont> raw_fonts;
+  raw_fonts.reserve(fonts.size());
+  for(const auto& f : fonts) raw_fonts.push_back(f.raw());
+  fallback->table.set(ucs, probe_fallback(raw_fonts, ucs));
+  fallback->dirty = true;
 }
 
 u32 EditorArea::font_for_ucs(u32 ucs)
 {
   if (fonts.size() <= 1 || ucs < 256) return 0;
-  auto it = font_for_unicode.find(ucs);
-  if (it != font_for_unicode.end()) return it->second;
+  const auto idx = fallback->table.get(ucs);
+  if (idx != FallbackTable::unknown) return idx;
   set_fallback_for_ucs(ucs);
-  return font_for_unicode.at(ucs);
+  return fallback->table.get(ucs);
+}
+
+/// Code point ranges that commonly show up in a buffer.
+static constexpr std::pair<u32, u32> prewarm_ranges[] = {
+  {0x0100, 0x024F}, // Latin Extended-A/B
+  {0x0370, 0x03FF}, // Greek
+  {0x0400, 0x04FF}, // Cyrillic
+  {0x2000, 0x2BFF}, // Punctuation, arrows, math, box drawing, symbols
+  {0x3000, 0x30FF}, // CJK punctuation, Hiragana, Katakana
+  {0x4E00, 0x9FFF}, // CJK Unified Ideographs
+  {0xAC00, 0xD7A3}, // Hangul
+  {0xE000, 0xF8FF}, // Private use (Nerd Fonts, Powerline)
+  {0xFF00, 0xFFEF}, // Halfwidth and fullwidth forms
+};
+
+void EditorArea::prewarm_fallback_table()
+{
+  if (!fallback || fallback->prewarmed || fallback->prewarming) return;
+  fallback->prewarming = true;
+  std::vector<QFont> qfonts;
+  qfonts.reserve(fonts.size());
+  for(const auto& f : fonts) qfonts.push_back(f.font());
+  const auto generation = fallback_generation.load();
+  fallback_pool.start([this, qfonts = std::move(qfonts), generation, shared = fallback] {
+    // The worker uses its own raw fonts, they aren't safe to share
+    std::vector<QRawFont> raw_fonts;
+    raw_fonts.reserve(qfonts.size());
+    for(const auto& f : qfonts) raw_fonts.push_back(QRawFont::fromFont(f));
+    auto table = std::make_shared<FallbackTable>();
+    for(const auto& [first, last] : prewarm_ranges)
+    {
+      if (generation != fallback_generation.load())
+      {
+        table.reset();
+        break;
+      }
+      for(u32 ucs = first; ucs <= last; ++ucs)
+      {
+        table->set(ucs, probe_fallback(raw_fonts, ucs));
+      }
+    }
+    // The table may be used by other editors, which stay around
+    // when this one is destroyed
+    QMetaObject::invokeMethod(qApp, [shared, table] {
+      shared->prewarming = false;
+      if (!table) return;
+      shared->table.merge(std::move(*table));
+      shared->prewarmed = true;
+      shared->dirty = true;
+      save_fallback_cache(*shared);
+    }, Qt::QueuedConnection);
+  });
+}
+
+std::uint64_t EditorArea::fallback_cache_key() const
+{
+  std::string desc = fmt::format("{}/{}", fallback_cache::version, logicalDpiY());
+  for(const auto& f : fonts)
+  {
+    const QFontInfo info {f.font()};
+    desc += fmt::format(
+      "/{}:{}:{}:{}:{}", info.family().toStdString(),
+      info.styleName().toStdString(), info.pointSizeF(), info.weight(),
+      info.italic()
+    );
+  }
+  // Qt doesn't tell which file a font comes from, but installing or
+  // removing one changes its directory
+  const auto font_dirs = QStandardPaths::standardLocations(
+    QStandardPaths::FontsLocation
+  );
+  for(const auto& dir : font_dirs)
+  {
+    const QFileInfo info {dir};
+    if (!info.exists()) continue;
+    desc += fmt::format("/{}", info.lastModified().toMSecsSinceEpoch());
+  }
+  return fallback_cache::key_of(desc);
+}
+
+/// Where the fallback cache for key goes.
+static QString fallback_cache_path(std::uint64_t key)
+{
+  const auto dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  return dir % "/fallback-" % QString::number(key, 16) % ".bin";
+}
+
+/// Load the fallback table of fallback's fonts from the disk,
+/// returns false if there was none.
+static bool load_fallback_cache(SharedFallback& fallback)
+{
+  QFile file {fallback_cache_path(fallback.key)};
+  if (!file.open(QIODevice::ReadOnly)) return false;
+  const auto size = file.size();
+  // Mapped instead of read, only the pages are copied out of it
+  uchar* data = file.map(0, size);
+  if (!data) return false;
+  const auto loaded = fallback_cache::deserialize(
+    {reinterpret_cast<const char*>(data), std::size_t(size)},
+    fallback.key, fallback.num_fonts, fallback.table
+  );
+  file.unmap(data);
+  if (!loaded) return false;
+  fallback.prewarmed = loaded->prewarmed;
+  fallback.dirty = false;
+  return true;
+}
+
+/// Save the fallback table to the disk if it has new entries.
+static void save_fallback_cache(SharedFallback& fallback)
+{
+  if (!fallback.dirty) return;
+  fallback.dirty = false;
+  const QString path = fallback_cache_path(fallback.key);
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  QSaveFile file {path};
+  if (!file.open(QIODevice::WriteOnly)) return;
+  const auto data = fallback_cache::serialize(
+    fallback.table, fallback.key, fallback.num_fonts, fallback.prewarmed
+  );
+  file.write(data.data(), qint64(data.size()));
+  file.commit();
+}
+
+u32 EditorArea::cached_font_for_ucs(u32 ucs) const
+{
+  if (fonts.size() <= 1 || ucs < 256) return 0;
+  const auto idx = fallback->table.get(ucs);
+  return idx == FallbackTable::unknown ? 0 : idx;
 }
 
 void EditorArea::resizeEvent(QResizeEvent* event)
 {
   Q_UNUSED(event);
+  // The grids keep their contents until Neovim has resized them,
+  // so the last frame stays on screen (the new area gets the
+  // default background)
+  live_resize = true;
+  live_resize_timer.start();
   update();
 }
 
@@ -1025,6 +1457,8 @@ void EditorArea::destroy_grid(u16 grid_num)
     return g->id == grid_num;
   });
   if (it == grids.end()) return;
+  (*it)->retire();
+  grid_pool.release(std::move(*it));
   grids.erase(it);
 }
 
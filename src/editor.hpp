@@ -1,8 +1,13 @@
 #ifndef NVUI_EDITOR_HPP
 #define NVUI_EDITOR_HPP
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <queue>
+#include <string>
+#include <utility>
+#include <vector>
 #include <span>
 #include <msgpack.hpp>
 #include <QFont>
@@ -12,16 +17,46 @@
 #include <QPainter>
 #include <QPaintEvent>
 #include <QResizeEvent>
+#include <QThreadPool>
 #include <QMouseEvent>
 #include <QFontDatabase>
+#include "atlas_grid.hpp"
+#include "decide_renderer.hpp"
 #include "hlstate.hpp"
 #include "nvim.hpp"
 #include "cursor.hpp"
 #include "popupmenu.hpp"
 #include "cmdline.hpp"
+#include "fallback_table.hpp"
 #include "font.hpp"
+#include "frame_scheduler.hpp"
 #include "grid.hpp"
+#include "grid_pool.hpp"
+#include "grid_lines.hpp"
 #include "object.hpp"
+#include "latency_trace.hpp"
+#include "memory_budget.hpp"
+#include "perf_stats.hpp"
+
+class PerfHud;
+
+/// The fallback fonts of one list of fonts, shared by every editor in
+/// the process that uses the same fonts (see --tabs).
+/// Only changed on the GUI thread, the raster threads read it while
+/// the GUI thread waits for them.
+struct SharedFallback
+{
+  /// Identifies the fonts, also in the fallback cache on disk.
+  std::uint64_t key = 0;
+  std::uint32_t num_fonts = 0;
+  FallbackTable table;
+  /// Whether the common ranges are in table already.
+  bool prewarmed = false;
+  /// An editor is prewarming it.
+  bool prewarming = false;
+  /// table has entries that aren't in the cache on disk.
+  bool dirty = false;
+};
 
 /// UI Capabilities (Extensions)
 struct ExtensionCapabilities
@@ -98,14 +133,16 @@ public:
     HLState* state = nullptr,
     Nvim* nv = nullptr
   );
+  ~EditorArea() override;
   /**
    * Handles a Neovim "grid_resize" event.
    */
   void grid_resize(std::span<NeovimObj> objs);
   /**
-   * Handles a Neovim "grid_line" event.
+   * Handles a Neovim "grid_line" event with count lines,
+   * which have already been decoded into lines.
    */
-  void grid_line(std::span<NeovimObj> objs);
+  void grid_line(GridLines& lines, std::size_t count);
   /**
    * Paints the grid cursor at the given grid, row, and column.
    */
@@ -161,9 +198,17 @@ public:
    */
   void grid_scroll(std::span<NeovimObj> objs);
   /**
-   * Notify the editor area when resizing is enabled/disabled.
+   * Notify the editor area when the user starts/stops resizing the
+   * window, if that's known. Otherwise a live resize ends
+   * live_resize_settle_ms after the last resize.
    */
   void set_resizing(bool is_resizing);
+  /// Whether the window is being resized interactively. Grids grow
+  /// their backbuffers with headroom meanwhile, so that every step
+  /// of a drag doesn't reallocate them.
+  bool live_resizing() const { return live_resize; }
+  /// How long after the last resize a live resize ends.
+  static constexpr int live_resize_settle_ms = 150;
   /**
    * Handles a "mode_info_set" Neovim redraw event.
    * Internally sends the data to neovim_cursor.
@@ -335,7 +380,8 @@ public:
     return scroll_animation_frame_interval;
   }
   auto move_animation_frametime() const { return animation_frame_interval_ms; }
-  bool animations_enabled() const { return animate; }
+  /// Animations are off while suspended, since nothing is shown.
+  bool animations_enabled() const { return animate && !is_suspended; }
   void set_animations_enabled(bool enabled) { animate = enabled; }
   void set_animation_frametime(int ms)
   {
@@ -346,6 +392,13 @@ public:
     if (s > 0.f) move_animation_time = s;
   }
   auto snapshot_limit() { return snapshot_count; }
+  /// Total bytes used for smooth scrolling by all grids.
+  std::size_t snapshot_memory() const
+  {
+    std::size_t total = 0;
+    for(const auto& grid : grids) total += grid->snapshot_memory();
+    return total;
+  }
   void set_move_scaler(std::string scaler)
   {
     if (scalers::scalers().contains(scaler))
@@ -411,13 +464,62 @@ public:
   {
     hide_cursor_while_typing = hide;
   }
+  /// Presents the editor area, paced to the display's refresh rate.
+  FrameScheduler& frame_scheduler() { return scheduler; }
+  /// The cells (in pixels) the cursor is on and was last on.
+  QRegion cursor_damage() const;
+  PerfStats& perf_stats() { return perf; }
+  /// Key-to-photon latency, see --trace-latency.
+  LatencyTrace& latency_trace() { return latency; }
+  /// Name/value pairs of the current performance counters,
+  /// shown by the HUD and returned by NVUI_PERF_STATS.
+  std::vector<std::pair<std::string, double>> perf_report();
+  void set_perf_hud_visible(bool visible);
+  void toggle_perf_hud();
+  /// Limit the memory held for rendering to bytes (0 for no limit),
+  /// see MemoryBudget.
+  void set_memory_budget(std::size_t bytes);
+  /**
+   * Stop drawing, blinking and animating while the window can't be
+   * seen (minimized, occluded, on another virtual desktop).
+   * Redraw events still update the grids, which are drawn again in
+   * full once it's resumed.
+   */
+  void set_suspended(bool suspend);
+  bool suspended() const { return is_suspended; }
 protected:
+  // Declared first so that it outlives grids and the cursor,
+  // which stop their animations when destroyed
+  FrameScheduler scheduler;
+  /// Rasterizes dirty grids in parallel during paintEvent.
+  QThreadPool raster_pool;
+  PerfStats perf;
+  LatencyTrace latency;
+  MemoryBudget memory;
+  /// Created the first time it's shown.
+  PerfHud* perf_hud = nullptr;
+  /// Where each grid was (in z order) when the last damage was
+  /// taken. If anything moved, everything is repainted.
+  struct GridLayout
+  {
+    u16 id;
+    u16 x;
+    u16 y;
+    u16 cols;
+    u16 rows;
+    bool hidden;
+    bool operator==(const GridLayout&) const = default;
+  };
+  std::vector<GridLayout> damage_layout;
+  QColor damage_bg;
   std::queue<PaintEventItem> events;
   float charspace = 0;
   float linespace = 0;
   HLState* state;
   bool should_ignore_pevent = false;
   std::vector<std::unique_ptr<GridBase>> grids;
+  /// Destroyed grids, reused by the next grids that are created.
+  GridPool<GridBase> grid_pool;
   bool bold = false;
   // For font fallback, not used if a single font is set.
   std::vector<Font> fonts;
@@ -426,7 +528,14 @@ protected:
   QFont font;
   Nvim* nvim;
   QPixmap pixmap;
-  bool resizing = false;
+  bool is_suspended = false;
+  /// A nvim_ui_try_resize is waiting for its response. Only one
+  /// is sent at a time, sizes in the meantime go to queued_resize.
+  bool resize_in_flight = false;
+  bool live_resize = false;
+  /// Set through set_resizing, the live resize lasts until it's unset.
+  bool live_resize_held = false;
+  QTimer live_resize_timer;
   Cursor neovim_cursor;
   int rows = -1;
   int cols = -1;
@@ -434,17 +543,24 @@ protected:
   CmdLine cmdline;
   bool neovim_is_resizing = false;
   std::optional<QSize> queued_resize = std::nullopt;
-  std::unordered_map<std::uint32_t, std::uint32_t> font_for_unicode;
+  /// The fallback fonts of the current fonts, nullptr if
+  /// there's only one font.
+  std::shared_ptr<SharedFallback> fallback;
+  /// Bumped whenever the fallback fonts change, a prewarm that started
+  /// for an older list of fonts stops early and gets discarded.
+  std::atomic<std::uint32_t> fallback_generation = 0;
+  /// Runs fallback table prewarms, one at a time.
+  QThreadPool fallback_pool;
   bool mouse_enabled = false;
   ExtensionCapabilities capabilities;
   bool animate = true;
   u32 snapshot_count = 4;
   float move_animation_time = 0.5f;
-  int animation_frame_interval_ms = 10;
-  int scroll_animation_frame_interval = 10;
+  int animation_frame_interval_ms = 1;
+  int scroll_animation_frame_interval = 1;
   float scroll_animation_time = 0.3f;
   float cursor_animation_time = 0.3f;
-  int cursor_animation_frametime_ms = 10;
+  int cursor_animation_frametime_ms = 1;
   bool hide_cursor_while_typing = false;
   Mouse mouse;
   /**
@@ -453,6 +569,20 @@ protected:
    * uses a default font given by default_font_family() in utils.hpp.
    */
   void set_guifont(QString new_font);
+  /**
+   * Resolve the fallback fonts of commonly used code points on a
+   * background thread, so that drawing them for the first time doesn't
+   * have to probe every font.
+   */
+  void prewarm_fallback_table();
+  /// Key of the current fonts for the fallback cache: their families,
+  /// styles and sizes, the DPI and when fonts were last installed.
+  std::uint64_t fallback_cache_key() const;
+  /**
+   * Returns the part of the editor area (in pixels) that has changed
+   * since the last call: the damage of every grid, and the cursor.
+   */
+  QRegion take_damage();
   /**
    * Returns a grid with the matching grid_num
    */
@@ -488,7 +618,11 @@ protected:
   /// own rendering.
   virtual void create_grid(u16 x, u16 y, u16 w, u16 h, u16 id)
   {
+#if defined(USE_GLYPH_ATLAS)
+    grids.push_back(std::make_unique<AtlasPaintGrid>(this, x, y, w, h, id));
+#else
     grids.push_back(std::make_unique<QPaintGrid>(this, x, y, w, h, id));
+#endif
   }
   /**
    * Clears a portion of the grid by drawing Neovim's current default background
@@ -543,8 +677,14 @@ protected:
    * Destroy the grid with the given grid_num.
    * If no grid exists with the given grid_num,
    * nothing happens.
+   * The grid is kept in grid_pool so that it can be reused.
    */
   void destroy_grid(std::uint16_t grid_num);
+  /// Count the bytes in each of memory's pools.
+  void update_memory_usage();
+  /// Free caches and buffers, in memory's order, until the
+  /// memory used is back under the budget.
+  void enforce_memory_budget();
   /// Clear event queue
   inline void clear_events()
   {
@@ -622,10 +762,17 @@ public slots:
   virtual void default_colors_changed(QColor fg, QColor bg);
   void set_fallback_for_ucs(std::uint32_t ucs);
   std::uint32_t font_for_ucs(std::uint32_t ucs);
+  /// Like font_for_ucs, but never modifies the fallback table, so it
+  /// can be called from the raster threads. Code points that haven't
+  /// been resolved yet use the main font.
+  std::uint32_t cached_font_for_ucs(std::uint32_t ucs) const;
 signals:
   void font_changed();
 protected:
   void resizeEvent(QResizeEvent* event) override;
+  /// Called when a live resize is over, trims the backbuffers'
+  /// headroom.
+  void end_live_resize();
   void paintEvent(QPaintEvent* event) override;
   void mousePressEvent(QMouseEvent* event) override;
   void wheelEvent(QWheelEvent* event) override;
@@ -0,0 +1,129 @@
+#ifndef NVUI_FALLBACK_CACHE_HPP
+#define NVUI_FALLBACK_CACHE_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include "fallback_table.hpp"
+
+/// The on-disk form of a FallbackTable, so that the fallback fonts
+/// don't have to be probed again on the next launch.
+/// The file is a header followed by the table's allocated pages,
+/// each stored as its index and its entries. It belongs to one set
+/// of fonts, identified by a key (see key_of), and is ignored for
+/// any other key or version.
+namespace fallback_cache
+{
+  using u8 = std::uint8_t;
+  using u32 = std::uint32_t;
+  using u64 = std::uint64_t;
+  /// Bump whenever the format or the meaning of an entry changes.
+  inline constexpr u32 version = 1;
+  inline constexpr char magic[4] = {'N', 'V', 'F', 'B'};
+  struct Header
+  {
+    char magic[4];
+    u32 version;
+    u64 key;
+    /// Number of fonts the entries index into.
+    u32 num_fonts;
+    /// Whether the common ranges were all probed (see
+    /// EditorArea::prewarm_fallback_table).
+    u32 prewarmed;
+    u32 num_pages;
+    u32 reserved;
+  };
+  static_assert(sizeof(Header) == 32);
+  inline constexpr std::size_t page_record_size =
+    sizeof(u32) + FallbackTable::page_size;
+
+  /// Hash (FNV-1a) of text, continuing from seed.
+  inline u64 key_of(std::string_view text, u64 seed = 0xcbf29ce484222325)
+  {
+    u64 hash = seed;
+    for(unsigned char c : text) hash = (hash ^ c) * 0x100000001b3;
+    return hash;
+  }
+
+  inline std::string serialize(
+    const FallbackTable& table,
+    u64 key,
+    u32 num_fonts,
+    bool prewarmed
+  )
+  {
+    u32 num_pages = 0;
+    table.for_each_page([&](u32, const u8*) { ++num_pages; });
+    Header header {
+      {magic[0], magic[1], magic[2], magic[3]},
+      version, key, num_fonts, prewarmed, num_pages, 0
+    };
+    std::string out(sizeof(Header) + num_pages * page_record_size, '\0');
+    std::memcpy(out.data(), &header, sizeof(Header));
+    char* pos = out.data() + sizeof(Header);
+    table.for_each_page([&](u32 page_idx, const u8* entries) {
+      std::memcpy(pos, &page_idx, sizeof(u32));
+      std::memcpy(pos + sizeof(u32), entries, FallbackTable::page_size);
+      pos += page_record_size;
+    });
+    return out;
+  }
+
+  struct Loaded
+  {
+    bool prewarmed = false;
+  };
+
+  /**
+   * Load the pages in data into table. Returns nullopt without
+   * touching table if data isn't a complete cache with the same
+   * version, key and number of fonts.
+   */
+  inline std::optional<Loaded> deserialize(
+    std::span<const char> data,
+    u64 key,
+    u32 num_fonts,
+    FallbackTable& table
+  )
+  {
+    Header header;
+    if (data.size() < sizeof(Header)) return std::nullopt;
+    std::memcpy(&header, data.data(), sizeof(Header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0
+      || header.version != version
+      || header.key != key
+      || header.num_fonts != num_fonts
+      || data.size() != sizeof(Header) + header.num_pages * page_record_size)
+    {
+      return std::nullopt;
+    }
+    const char* pos = data.data() + sizeof(Header);
+    for(u32 i = 0; i < header.num_pages; ++i, pos += page_record_size)
+    {
+      u32 page_idx;
+      std::memcpy(&page_idx, pos, sizeof(u32));
+      if (page_idx >= FallbackTable::num_pages) return std::nullopt;
+    }
+    pos = data.data() + sizeof(Header);
+    std::array<u8, FallbackTable::page_size> entries;
+    for(u32 i = 0; i < header.num_pages; ++i, pos += page_record_size)
+    {
+      u32 page_idx;
+      std::memcpy(&page_idx, pos, sizeof(u32));
+      std::memcpy(entries.data(), pos + sizeof(u32), entries.size());
+      // Never hand out a font that doesn't exist
+      for(auto& e : entries)
+      {
+        if (e != FallbackTable::unknown && e >= num_fonts) e = FallbackTable::unknown;
+      }
+      table.set_page(page_idx, entries.data());
+    }
+    return Loaded {header.prewarmed != 0};
+  }
+}
+
+#endif // NVUI_FALLBACK_CACHE_HPP
@@ -0,0 +1,96 @@
+#ifndef NVUI_FALLBACK_TABLE_HPP
+#define NVUI_FALLBACK_TABLE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// Maps code points to the index of the font that displays them.
+/// Code points are split into pages of 256, each page is a flat array
+/// that only gets allocated once something in it has been resolved,
+/// so a lookup is two loads and no hashing.
+class FallbackTable
+{
+public:
+  using u8 = std::uint8_t;
+  using u32 = std::uint32_t;
+  /// Returned for code points that haven't been resolved.
+  static constexpr u8 unknown = 0xFF;
+  /// Largest font index that can be stored.
+  static constexpr u32 max_index = unknown - 1;
+  static constexpr u32 page_bits = 8;
+  static constexpr u32 page_size = 1u << page_bits;
+  static constexpr u32 num_pages = 0x110000 >> page_bits;
+  FallbackTable(): pages(num_pages) {}
+  FallbackTable(FallbackTable&&) = default;
+  FallbackTable& operator=(FallbackTable&&) = default;
+  u8 get(u32 ucs) const
+  {
+    const u32 page_idx = ucs >> page_bits;
+    if (page_idx >= num_pages) return unknown;
+    const auto& page = pages[page_idx];
+    if (!page) return unknown;
+    return (*page)[ucs & (page_size - 1)];
+  }
+  void set(u32 ucs, u8 font_idx)
+  {
+    const u32 page_idx = ucs >> page_bits;
+    if (page_idx >= num_pages) return;
+    auto& page = pages[page_idx];
+    if (!page)
+    {
+      page = std::make_unique<Page>();
+      page->fill(unknown);
+    }
+    (*page)[ucs & (page_size - 1)] = font_idx;
+  }
+  void clear()
+  {
+    for(auto& page : pages) page.reset();
+  }
+  /// Calls f(page_idx, entries) for every page that's allocated,
+  /// entries pointing to page_size entries.
+  template<typename F>
+  void for_each_page(F&& f) const
+  {
+    for(u32 i = 0; i < num_pages; ++i)
+    {
+      if (pages[i]) f(i, pages[i]->data());
+    }
+  }
+  /// Replace a page with the page_size entries at entries.
+  void set_page(u32 page_idx, const u8* entries)
+  {
+    if (page_idx >= num_pages) return;
+    auto& page = pages[page_idx];
+    if (!page) page = std::make_unique<Page>();
+    std::copy_n(entries, page_size, page->begin());
+  }
+  /// Take the entries of other that are unknown here.
+  /// Pages that only other has are moved over as a whole.
+  void merge(FallbackTable&& other)
+  {
+    for(u32 i = 0; i < num_pages; ++i)
+    {
+      auto& src = other.pages[i];
+      if (!src) continue;
+      auto& dst = pages[i];
+      if (!dst)
+      {
+        dst = std::move(src);
+        continue;
+      }
+      for(u32 j = 0; j < page_size; ++j)
+      {
+        if ((*dst)[j] == unknown) (*dst)[j] = (*src)[j];
+      }
+    }
+  }
+private:
+  using Page = std::array<u8, page_size>;
+  std::vector<std::unique_ptr<Page>> pages;
+};
+
+#endif // NVUI_FALLBACK_TABLE_HPP
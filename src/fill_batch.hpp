@@ -0,0 +1,98 @@
+#ifndef NVUI_FILL_BATCH_HPP
+#define NVUI_FILL_BATCH_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+/// Background fills collected over a frame, so that they can be drawn
+/// with one brush color change per color instead of one per run.
+/// Runs that touch on the same row are merged as they're added,
+/// and rows of identical runs are merged into one rectangle when the
+/// batch is flushed.
+class FillBatch
+{
+public:
+  struct Rect
+  {
+    float left;
+    float top;
+    float right;
+    float bottom;
+  };
+  /// Positions closer than this are treated as the same
+  /// (backgrounds are snapped to whole pixels on one side only).
+  static constexpr float epsilon = 0.5f;
+  void add(std::uint32_t color, Rect r)
+  {
+    if (r.left >= r.right || r.top >= r.bottom) return;
+    if (!fills.empty())
+    {
+      auto& last = fills.back();
+      if (last.color == color && same(last.r.top, r.top)
+        && same(last.r.bottom, r.bottom)
+        && r.left <= last.r.right + epsilon
+        && r.right >= last.r.left - epsilon)
+      {
+        last.r.left = std::min(last.r.left, r.left);
+        last.r.right = std::max(last.r.right, r.right);
+        return;
+      }
+    }
+    fills.push_back({color, r});
+  }
+  bool empty() const { return fills.empty(); }
+  std::size_t size() const { return fills.size(); }
+  /**
+   * Calls f(color, rect) for each fill, grouped by color, then clears
+   * the batch. set_color(color) is called before the first fill of
+   * each color.
+   */
+  template<typename SetColor, typename Fill>
+  void flush(SetColor&& set_color, Fill&& f)
+  {
+    std::sort(fills.begin(), fills.end(), [](const auto& a, const auto& b) {
+      return std::tie(a.color, a.r.left, a.r.right, a.r.top)
+        < std::tie(b.color, b.r.left, b.r.right, b.r.top);
+    });
+    std::size_t out = 0;
+    for(std::size_t i = 0; i < fills.size(); ++i)
+    {
+      if (out > 0)
+      {
+        auto& prev = fills[out - 1];
+        const auto& cur = fills[i];
+        if (prev.color == cur.color && same(prev.r.left, cur.r.left)
+          && same(prev.r.right, cur.r.right)
+          && cur.r.top <= prev.r.bottom + epsilon)
+        {
+          prev.r.bottom = std::max(prev.r.bottom, cur.r.bottom);
+          continue;
+        }
+      }
+      fills[out++] = fills[i];
+    }
+    fills.resize(out);
+    for(std::size_t i = 0; i < fills.size(); ++i)
+    {
+      if (i == 0 || fills[i].color != fills[i - 1].color)
+      {
+        set_color(fills[i].color);
+      }
+      f(fills[i].r);
+    }
+    fills.clear();
+  }
+private:
+  static bool same(float a, float b) { return std::abs(a - b) < epsilon; }
+  struct Fill
+  {
+    std::uint32_t color;
+    Rect r;
+  };
+  std::vector<Fill> fills;
+};
+
+#endif // NVUI_FILL_BATCH_HPP
@@ -3,28 +3,53 @@
 #include <QFont>
 #include <QFontMetrics>
 #include <QRawFont>
+#include <array>
 class Font
 {
 public:
   const QFont& font() const { return font_; }
   const QRawFont& raw() const { return raw_; }
-  Font(const QString& family): font_(family), raw_(QRawFont::fromFont(font_)) {}
-  Font(const QFont& font): font_(font), raw_(QRawFont::fromFont(font_)) {}
+  /// The font with bold and/or italic set. These are made whenever
+  /// the font changes, so drawing doesn't have to copy and modify it.
+  const QFont& styled(bool bold, bool italic) const
+  {
+    return styles[bold | (italic << 1)];
+  }
+  Font(const QString& family): font_(family), raw_(QRawFont::fromFont(font_))
+  {
+    update_styles();
+  }
+  Font(const QFont& font): font_(font), raw_(QRawFont::fromFont(font_))
+  {
+    update_styles();
+  }
   Font& operator=(const QFont& f)
   {
     font_ = f;
     raw_ = QRawFont::fromFont(font_);
+    update_styles();
     return *this;
   }
   Font& operator=(const QString& family)
   {
     font_.setFamily(family);
     raw_ = QRawFont::fromFont(font_);
+    update_styles();
     return *this;
   }
 private:
+  void update_styles()
+  {
+    for(int i = 0; i < 4; ++i)
+    {
+      styles[i] = font_;
+      styles[i].setBold(i & 1);
+      styles[i].setItalic(i & 2);
+    }
+  }
   QFont font_;
   QRawFont raw_;
+  std::array<QFont, 4> styles;
 };
 
 /// Font dimensions of a monospace font,
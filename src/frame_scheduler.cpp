@@ -0,0 +1,136 @@
+#include "frame_scheduler.hpp"
+#include <QScreen>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+FrameScheduler::FrameScheduler(QWidget* w)
+: QObject(),
+  widget(w)
+{
+  assert(widget);
+  timer.setTimerType(Qt::PreciseTimer);
+  timer.callOnTimeout(this, [this] { tick(); });
+  clock.start();
+  update_interval();
+}
+
+void FrameScheduler::request_frame()
+{
+  full_damage = true;
+  request_frame(QRegion());
+}
+
+void FrameScheduler::request_frame(const QRegion& region)
+{
+  dirty = true;
+  damage += region;
+  if (timer.isActive() || ticking || is_suspended) return;
+  // Nothing has been presented for at least a frame,
+  // don't make the input wait for the next tick.
+  tick();
+  start_timer();
+}
+
+void FrameScheduler::start_animation(
+  const void* key,
+  animation_step step,
+  int min_interval_ms,
+  bool reports_damage
+)
+{
+  stop_animation(key);
+  animations.push_back({
+    key, std::move(step), min_interval_ms, clock.elapsed(), reports_damage
+  });
+  if (!timer.isActive() && !is_suspended) start_timer();
+}
+
+void FrameScheduler::stop_animation(const void* key)
+{
+  std::erase_if(animations, [key](const Animation& a) {
+    return a.key == key;
+  });
+  for(auto& a : stepping)
+  {
+    if (a.key == key) a.step = nullptr;
+  }
+}
+
+void FrameScheduler::set_suspended(bool suspend)
+{
+  if (suspend == is_suspended) return;
+  is_suspended = suspend;
+  if (suspend)
+  {
+    timer.stop();
+    return;
+  }
+  if (!dirty && animations.empty()) return;
+  tick();
+  start_timer();
+}
+
+bool FrameScheduler::is_animating(const void* key) const
+{
+  return std::any_of(animations.begin(), animations.end(), [key](const auto& a) {
+    return a.key == key;
+  });
+}
+
+void FrameScheduler::tick()
+{
+  const qint64 now = clock.elapsed();
+  bool stepped = false;
+  ticking = true;
+  // Steps may start or stop animations (including themselves),
+  // so step a separate list and merge back what's still running.
+  stepping.swap(animations);
+  for(std::size_t i = 0; i < stepping.size(); ++i)
+  {
+    auto& a = stepping[i];
+    if (!a.step) continue;
+    const qint64 elapsed = now - a.last_step_ms;
+    if (elapsed >= a.min_interval_ms)
+    {
+      a.last_step_ms = now;
+      stepped |= !a.reports_damage;
+      // Copy, the step could stop its own animation
+      auto step = a.step;
+      if (!step(float(elapsed) / 1000.f)) continue;
+    }
+    if (stepping[i].step && !is_animating(stepping[i].key))
+    {
+      animations.push_back(std::move(stepping[i]));
+    }
+  }
+  stepping.clear();
+  ticking = false;
+  if (dirty || stepped)
+  {
+    // Animations that don't report their damage can move anything
+    if (full_damage || stepped) widget->update();
+    else widget->update(damage);
+    dirty = false;
+    full_damage = false;
+    damage = QRegion();
+  }
+  else if (animations.empty()) timer.stop();
+}
+
+void FrameScheduler::update_interval()
+{
+  double hz = 60.;
+  if (auto* screen = widget->screen(); screen && screen->refreshRate() > 0)
+  {
+    hz = screen->refreshRate();
+  }
+  timer.setInterval(std::max(1, int(std::floor(1000. / hz))));
+}
+
+void FrameScheduler::start_timer()
+{
+  // The window may have moved to another monitor since last time
+  update_interval();
+  timer.start();
+}
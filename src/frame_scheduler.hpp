@@ -0,0 +1,91 @@
+#ifndef NVUI_FRAME_SCHEDULER_HPP
+#define NVUI_FRAME_SCHEDULER_HPP
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QRegion>
+#include <QTimer>
+#include <QWidget>
+#include <functional>
+#include <vector>
+
+/// Paces all repaints of a widget to the refresh rate of the
+/// screen it's on.
+/// Instead of every animation running its own timer and calling
+/// update() whenever it fires, animations register a step function
+/// here and everything that changed gets presented together, at most
+/// once per display refresh. When nothing is dirty and no animations
+/// are running the timer stops, so idle frames are skipped entirely.
+class FrameScheduler : public QObject
+{
+  Q_OBJECT
+public:
+  /// Advances an animation by dt seconds.
+  /// Returns false once the animation is finished.
+  using animation_step = std::function<bool (float)>;
+  FrameScheduler(QWidget* widget);
+  /// Present the widget on the next frame.
+  /// If the scheduler was idle, this presents right away.
+  void request_frame();
+  /// Same as request_frame(), but only the given region (in widget
+  /// coordinates) has changed. If nothing else is requested before
+  /// the frame, only this region is repainted.
+  void request_frame(const QRegion& region);
+  /// Run step once per frame until it returns false.
+  /// key identifies the animation so that it can be restarted or
+  /// stopped (any address owned by the animating object works).
+  /// If min_interval_ms is larger than the frame interval, the
+  /// animation is stepped less often than once per frame.
+  /// Stepping repaints the whole widget, unless reports_damage is true,
+  /// in which case the step calls request_frame(region) with only
+  /// what it changed.
+  void start_animation(
+    const void* key,
+    animation_step step,
+    int min_interval_ms = 0,
+    bool reports_damage = false
+  );
+  /// Stop the animation with the given key, if it is running.
+  /// This must be called before the animation's owner is destroyed.
+  void stop_animation(const void* key);
+  bool is_animating(const void* key) const;
+  /// Time between frames, in milliseconds.
+  int frame_interval() const { return timer.interval(); }
+  /**
+   * Stop presenting and stepping animations (while the widget can't
+   * be seen). Frames that are requested in the meantime are
+   * presented when it's resumed, and animations jump to where
+   * they'd be by then.
+   */
+  void set_suspended(bool suspend);
+  bool suspended() const { return is_suspended; }
+private:
+  struct Animation
+  {
+    const void* key;
+    animation_step step;
+    int min_interval_ms;
+    qint64 last_step_ms;
+    bool reports_damage;
+  };
+  /// Step the animations and present if anything changed.
+  void tick();
+  /// Match the timer to the refresh rate of the widget's screen.
+  void update_interval();
+  void start_timer();
+  QWidget* widget;
+  QTimer timer;
+  QElapsedTimer clock;
+  std::vector<Animation> animations;
+  /// Animations being stepped in the current tick.
+  std::vector<Animation> stepping;
+  bool dirty = false;
+  /// Steps may request frames, which shouldn't tick again.
+  bool ticking = false;
+  /// What has changed since the last frame, if not everything.
+  QRegion damage;
+  bool full_damage = false;
+  bool is_suspended = false;
+};
+
+#endif // NVUI_FRAME_SCHEDULER_HPP
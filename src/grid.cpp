@@ -1,28 +1,271 @@
 #include "editor.hpp"
 #include "grid.hpp"
 #include "utils.hpp"
-#include <QPainterPath>
+#include <QHash>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 scalers::time_scaler GridBase::scroll_scaler = scalers::oneminusexpo2negative10;
 scalers::time_scaler GridBase::move_scaler = scalers::oneminusexpo2negative10;
 
-grid_char GridChar::grid_char_from_str(const std::string& s)
+namespace
 {
-  return QString::fromStdString(s);
+  /// First code point of text, 0 if it's empty.
+  std::uint32_t first_ucs(const QString& text)
+  {
+    if (text.isEmpty()) return 0;
+    if (text.size() >= 2 && text.at(0).isHighSurrogate())
+    {
+      return QChar::surrogateToUcs4(text.at(0), text.at(1));
+    }
+    return text.at(0).unicode();
+  }
+
+  /// Interned text of cells that take more than one code point.
+  /// Ids are never reused, the table only grows (in practice the
+  /// number of distinct clusters is small).
+  struct ClusterTable
+  {
+    std::mutex mutex;
+    std::vector<QString> clusters;
+    QHash<QString, grid_char> ids;
+    /// The first code point of each cluster, which the draw loops
+    /// need for every cell (on several threads at once). Kept in
+    /// chunks that never move, so that it's read without the lock.
+    static constexpr std::size_t chunk_size = 1024;
+    static constexpr std::size_t num_chunks = 1024;
+    std::array<std::atomic<std::atomic<std::uint32_t>*>, num_chunks> ucs_chunks {};
+    std::vector<std::unique_ptr<std::atomic<std::uint32_t>[]>> ucs_storage;
+  };
+
+  ClusterTable& cluster_table()
+  {
+    static ClusterTable table;
+    return table;
+  }
+
+  grid_char intern_cluster(QString text)
+  {
+    auto& table = cluster_table();
+    std::lock_guard lock {table.mutex};
+    auto it = table.ids.find(text);
+    if (it != table.ids.end()) return *it;
+    const std::size_t idx = table.clusters.size();
+    const auto id = static_cast<grid_char>(idx) | GridChar::cluster_bit;
+    const std::size_t chunk = idx / ClusterTable::chunk_size;
+    if (chunk < ClusterTable::num_chunks)
+    {
+      auto* entries = table.ucs_chunks[chunk].load(std::memory_order_relaxed);
+      if (!entries)
+      {
+        table.ucs_storage.push_back(
+          std::make_unique<std::atomic<std::uint32_t>[]>(ClusterTable::chunk_size)
+        );
+        entries = table.ucs_storage.back().get();
+        table.ucs_chunks[chunk].store(entries, std::memory_order_release);
+      }
+      entries[idx % ClusterTable::chunk_size].store(
+        first_ucs(text), std::memory_order_release
+      );
+    }
+    table.clusters.push_back(text);
+    table.ids.insert(std::move(text), id);
+    return id;
+  }
+
+  /// Decodes the UTF-8 code point at the start of s.
+  /// Returns the code point and its length in bytes,
+  /// or a length of 0 if s doesn't start with a valid code point.
+  std::pair<std::uint32_t, std::size_t> decode_utf8(std::string_view s)
+  {
+    const auto lead = static_cast<unsigned char>(s[0]);
+    if (lead < 0x80) return {lead, 1};
+    std::uint32_t cp = 0;
+    std::size_t len = 0;
+    if ((lead & 0xe0) == 0xc0) { cp = lead & 0x1f; len = 2; }
+    else if ((lead & 0xf0) == 0xe0) { cp = lead & 0x0f; len = 3; }
+    else if ((lead & 0xf8) == 0xf0) { cp = lead & 0x07; len = 4; }
+    else return {0, 0};
+    if (s.size() < len) return {0, 0};
+    for(std::size_t i = 1; i < len; ++i)
+    {
+      const auto cont = static_cast<unsigned char>(s[i]);
+      if ((cont & 0xc0) != 0x80) return {0, 0};
+      cp = (cp << 6) | (cont & 0x3f);
+    }
+    if (cp > 0x10ffff) return {0, 0};
+    return {cp, len};
+  }
+}
+
+grid_char GridChar::grid_char_from_utf8(std::string_view s)
+{
+  if (s.empty()) return 0;
+  const auto [cp, len] = decode_utf8(s);
+  if (len == s.size() && cp != 0) return cp;
+  return intern_cluster(QString::fromUtf8(s.data(), static_cast<int>(s.size())));
+}
+
+QString GridChar::cluster_text(grid_char id)
+{
+  auto& table = cluster_table();
+  std::lock_guard lock {table.mutex};
+  const auto idx = id & ~cluster_bit;
+  assert(idx < table.clusters.size());
+  return table.clusters[idx];
+}
+
+GridChar::u32 GridChar::cluster_ucs(grid_char id)
+{
+  const auto idx = id & ~cluster_bit;
+  const std::size_t chunk = idx / ClusterTable::chunk_size;
+  if (chunk < ClusterTable::num_chunks)
+  {
+    const auto& table = cluster_table();
+    if (auto* entries = table.ucs_chunks[chunk].load(std::memory_order_acquire))
+    {
+      return entries[idx % ClusterTable::chunk_size].load(std::memory_order_acquire);
+    }
+  }
+  // Only past the first million clusters
+  return first_ucs(cluster_text(id));
+}
+
+/// Rounds n up to a multiple of QPaintGrid::buffer_bucket.
+static int bucketed(int n)
+{
+  constexpr int bucket = QPaintGrid::buffer_bucket;
+  return std::max((n + bucket - 1) / bucket, 1) * bucket;
 }
 
-void QPaintGrid::update_pixmap_size()
+bool QPaintGrid::update_backbuffer_size()
 {
   auto&& [font_width, font_height] = editor_area->font_dimensions();
-  pixmap = QPixmap(cols * font_width, rows * font_height);
+  const int width = cols * font_width;
+  const int height = rows * font_height;
+  const bool kept = !storage.isNull()
+    && storage.width() >= width && storage.height() >= height;
+  if (!kept)
+  {
+    int w = bucketed(width);
+    int h = bucketed(height);
+    if (editor_area->live_resizing())
+    {
+      // Grow ahead of the drag rather than at every step of it
+      w = std::max(bucketed(width + width / 4), storage.width());
+      h = std::max(bucketed(height + height / 4), storage.height());
+    }
+    storage = QImage(w, h, QImage::Format_ARGB32_Premultiplied);
+  }
+  backbuffer = QImage(
+    storage.bits(), width, height, storage.bytesPerLine(), storage.format()
+  );
+  return kept;
+}
+
+void QPaintGrid::trim_buffer()
+{
+  const int w = bucketed(backbuffer.width());
+  const int h = bucketed(backbuffer.height());
+  if (storage.width() <= w && storage.height() <= h) return;
+  QImage trimmed {w, h, storage.format()};
+  const auto line_bytes = std::size_t(backbuffer.width()) * (backbuffer.depth() / 8);
+  for(int y = 0; y < backbuffer.height(); ++y)
+  {
+    std::memcpy(trimmed.scanLine(y), backbuffer.constScanLine(y), line_bytes);
+  }
+  storage = std::move(trimmed);
+  // Same pixels, nothing has to be drawn again
+  backbuffer = QImage(
+    storage.bits(), backbuffer.width(), backbuffer.height(),
+    storage.bytesPerLine(), storage.format()
+  );
+}
+
+bool QPaintGrid::can_reuse(u16 w, u16 h) const
+{
+  auto&& [font_width, font_height] = editor_area->font_dimensions();
+  return storage.width() >= int(w * font_width)
+    && storage.height() >= int(h * font_height);
+}
+
+void QPaintGrid::retire()
+{
+  editor_area->frame_scheduler().stop_animation(&move_animation_time);
+  editor_area->frame_scheduler().stop_animation(&scroll_animation_time);
+  GridBase::retire();
+}
+
+void QPaintGrid::reuse(u16 new_x, u16 new_y, u16 w, u16 h, u16 new_id)
+{
+  move_animation_time = -1.f;
+  is_scrolling = false;
+  start_scroll_y = current_scroll_y = destination_scroll_y = 0.f;
+  cur_left = cur_top = 0.f;
+  old_move_x = old_move_y = dest_move_x = dest_move_y = 0.f;
+  ring.clear();
+  GridBase::reuse(new_x, new_y, w, h, new_id);
+  update_position(x, y);
+}
+
+std::size_t QPaintGrid::drop_snapshots()
+{
+  if (is_scrolling || scrollback.isNull()) return 0;
+  const std::size_t freed = scrollback.sizeInBytes();
+  scrollback = QImage();
+  ring.clear();
+  return freed;
+}
+
+std::size_t QPaintGrid::trim_text_cache(std::size_t bytes)
+{
+  const std::size_t entries =
+    (bytes + text_cache_entry_bytes - 1) / text_cache_entry_bytes;
+  return text_cache.evict(entries) * text_cache_entry_bytes;
+}
+
+std::size_t QPaintGrid::drop_buffer()
+{
+  if (!hidden || storage.isNull()) return 0;
+  const std::size_t freed = storage.sizeInBytes();
+  backbuffer = QImage();
+  storage = QImage();
+  ring.clear();
   send_redraw();
+  return freed;
 }
 
 void QPaintGrid::set_size(u16 w, u16 h)
 {
+  auto&& [font_width, font_height] = editor_area->font_dimensions();
+  // Pixels drawn with another font can't be kept
+  const bool same_font = backbuffer.width() == int(cols * font_width)
+    && backbuffer.height() == int(rows * font_height);
+  const u16 old_cols = cols;
+  const u16 old_rows = rows;
+  const auto old_dirty = dirty;
+  const bool had_redraw = redraw_pending();
   GridBase::set_size(w, h);
-  update_pixmap_size();
-  snapshots.clear(); // Outdated
+  ring.clear(); // Outdated
+  if (!update_backbuffer_size() || !same_font || had_redraw)
+  {
+    send_redraw();
+    return;
+  }
+  // The storage didn't move, so the cells that were already painted
+  // are still there (e.g. at every step of a window resize).
+  // Only what's new and what was already pending has to be drawn.
+  for(u16 row = 0; row < std::min(old_rows, rows); ++row)
+  {
+    const DirtySpan& d = old_dirty[row];
+    if (!d.empty()) send_draw(QRect(d.start, row, d.end - d.start, 1));
+  }
+  if (cols > old_cols) send_draw(QRect(old_cols, 0, cols - old_cols, rows));
+  if (rows > old_rows) send_draw(QRect(0, old_rows, cols, rows - old_rows));
 }
 
 void QPaintGrid::set_pos(u16 new_x, u16 new_y)
@@ -37,81 +280,46 @@ void QPaintGrid::set_pos(u16 new_x, u16 new_y)
   old_move_y = cur_top;
   dest_move_x = new_x;
   dest_move_y = new_y;
-  auto interval = editor_area->move_animation_frametime();
   move_animation_time = editor_area->move_animation_duration();
-  if (move_update_timer.interval() != interval)
-  {
-    move_update_timer.setInterval(interval);
-  }
   GridBase::set_pos(new_x, new_y);
-  if (!move_update_timer.isActive()) move_update_timer.start();
+  editor_area->frame_scheduler().start_animation(
+    &move_animation_time,
+    [this](float dt) { return step_move_animation(dt); },
+    editor_area->move_animation_frametime()
+  );
 }
 
-struct FontDecorationPaintPath
-{
-  QPainterPath path;
-  double line_thickness;
-};
-
-static FontDecorationPaintPath calculate_path(
+void QPaintGrid::draw_undercurl(
+  QPainter& painter,
   const QRectF& rect,
-  const FontOpts opt,
-  const float font_width,
-  const float font_height
+  const Color& color,
+  float font_width,
+  float font_height
 )
 {
-  Q_UNUSED(font_height);
-  FontDecorationPaintPath paint_path;
-  auto& p = paint_path.path;
-  auto& thickness = paint_path.line_thickness;
-  /// Lines always go for the length of the rectangle.
-  switch(opt)
+  const auto wave = decoration::undercurl(font_width, font_height);
+  const auto key = decoration::key_of(wave, color.to_uint32());
+  const QBrush* tile = undercurl_tiles.get(key);
+  if (!tile)
   {
-    case FontOpts::Underline:
+    const auto pixels = decoration::pixels(wave, color.to_uint32());
+    QImage image {wave.period, wave.height, QImage::Format_ARGB32_Premultiplied};
+    for(int y = 0; y < wave.height; ++y)
     {
-      thickness = 1.f;
-      const float offset = std::round(font_height * 0.1f);
-      p.moveTo(rect.x(), rect.bottom() - offset - (thickness / 2.f));
-      p.lineTo(rect.right(), rect.bottom() - offset - (thickness / 2.f));
-      break;
+      std::memcpy(
+        image.scanLine(y),
+        pixels.data() + std::size_t(y) * wave.period,
+        std::size_t(wave.period) * sizeof(decoration::u32)
+      );
     }
-    case FontOpts::Undercurl:
-    {
-      // Squiggly undercurl
-      thickness = 1.f;
-      float path_height = std::min(font_height / 5.0f, 3.0f);
-      p.moveTo(rect.x(), rect.bottom() - path_height);
-      bool top = false;
-      /// Ensure each character gets at least one triangle-shape
-      /// so that it doesn't look awkward
-      const double inc = font_width / 2.f;
-      for(double x = rect.x() + inc;; x += inc)
-      {
-        using namespace std;
-        p.lineTo(min(x, rect.right()), rect.bottom() - (path_height * top));
-        top = !top;
-        if (x >= rect.right()) break;
-      }
-      break;
-    }
-    case FontOpts::Strikethrough:
-    {
-      thickness = 1.f;
-      double mid_y = rect.y() + (rect.height() / 2.);
-      p.moveTo(rect.x(), mid_y);
-      p.lineTo(rect.right(), mid_y);
-      break;
-    }
-    default: break;
+    tile = &undercurl_tiles.put(key, QBrush(image));
   }
-  return paint_path;
-}
-
-void set_pen_width(QPainter& painter, double w)
-{
-  auto pen = painter.pen();
-  pen.setWidthF(w);
-  painter.setPen(pen);
+  const QRectF wave_rect {
+    rect.x(), rect.bottom() - wave.height, rect.width(), double(wave.height)
+  };
+  // Every run starts at the top of the wave
+  painter.setBrushOrigin(wave_rect.topLeft());
+  painter.fillRect(wave_rect, *tile);
 }
 
 void QPaintGrid::draw_text(
@@ -121,19 +329,21 @@ void QPaintGrid::draw_text(
   const std::optional<Color>& sp,
   const QRectF& rect,
   const FontOptions font_opts,
-  QFont& font,
+  const QFont& font,
   float font_width,
   float font_height
 )
 {
-  using key_type = decltype(text_cache)::key_type;
-  key_type key = {text, font_opts};
-  font::set_opts<false>(font, font_opts);
+  const TextCacheKeyView key {text, font_opts};
+  const auto hash = TextCacheHash()(key);
   painter.setFont(font);
-  QStaticText* static_text = text_cache.get(key);
+  QStaticText* static_text = text_cache.get(key, hash);
   if (!static_text)
   {
-    static_text = &text_cache.put(std::move(key), QStaticText {text});
+    // Deep copy, sharing the caller's buffer would make it
+    // reallocate the next time it's reused
+    QString owned(text.constData(), text.size());
+    static_text = &text_cache.put({owned, font_opts}, QStaticText {owned}, hash);
     static_text->setTextFormat(Qt::PlainText);
     static_text->setPerformanceHint(QStaticText::AggressiveCaching);
     static_text->prepare(QTransform(), font);
@@ -148,38 +358,49 @@ void QPaintGrid::draw_text(
     static_text->size().width(), font_height
   };
   if (!sp) return;
-  painter.setPen(sp.value().qcolor());
-  const auto draw_path = [&](const FontOpts fo) {
-    auto [path, pen_w] = calculate_path(line_clip_rect, fo, font_width, font_height);
-    set_pen_width(painter, pen_w);
-    painter.drawPath(path);
-  };
-  if (font_opts & FontOpts::Underline) draw_path(FontOpts::Underline);
-  if (font_opts & FontOpts::Undercurl) draw_path(FontOpts::Undercurl);
-  if (font_opts & FontOpts::Strikethrough) draw_path(FontOpts::Strikethrough);
+  const QColor sp_color = sp->qcolor();
+  constexpr double line_thickness = 1.;
+  if (font_opts & FontOpts::Underline)
+  {
+    const double offset = std::round(font_height * 0.1f);
+    painter.fillRect(QRectF {
+      line_clip_rect.x(), line_clip_rect.bottom() - offset - line_thickness,
+      line_clip_rect.width(), line_thickness
+    }, sp_color);
+  }
+  if (font_opts & FontOpts::Undercurl)
+  {
+    draw_undercurl(painter, line_clip_rect, *sp, font_width, font_height);
+  }
+  if (font_opts & FontOpts::Strikethrough)
+  {
+    const double mid_y = line_clip_rect.y() + (line_clip_rect.height() / 2.);
+    painter.fillRect(QRectF {
+      line_clip_rect.x(), mid_y - line_thickness / 2.,
+      line_clip_rect.width(), line_thickness
+    }, sp_color);
+  }
 }
 
 void QPaintGrid::draw_text_and_bg(
   QPainter& painter,
   const QString& text,
-  const HLAttr& attr,
-  const HLAttr& def_clrs,
+  const ResolvedHL& hl,
   const QPointF& start,
   const QPointF& end,
   const int offset,
-  QFont font,
+  const QFont& font,
   float font_width,
   float font_height
 )
 {
   Q_UNUSED(offset);
-  auto [fg, bg, sp] = attr.fg_bg_sp(def_clrs);
   QRectF rect = {start, end};
   painter.setClipRect(rect);
-  painter.fillRect(rect, bg.qcolor());
+  painter.fillRect(rect, hl.qbg);
   rect.setWidth(rect.width() * 3.);
   draw_text(
-    painter, text, fg, sp, rect, attr.font_opts, font, font_width, font_height
+    painter, text, hl.fg, hl.sp, rect, hl.font_opts, font, font_width, font_height
   );
 }
 
@@ -197,14 +418,14 @@ void QPaintGrid::draw(QPainter& p, QRect r, const double offset)
   QString buffer;
   buffer.reserve(100);
   const HLState* s = editor_area->hl_state();
-  const HLAttr& def_clrs = s->default_colors_get();
   u32 cur_font_idx = 0;
-  const auto draw_buf = [&](const HLAttr& main, QPointF start, QPointF end) {
+  const auto draw_buf = [&](const ResolvedHL& main, QPointF start, QPointF end) {
     if (buffer.isEmpty()) return;
     reverse_qstring(buffer);
     draw_text_and_bg(
-      p, buffer, main, def_clrs, start, end,
-      offset, fonts[cur_font_idx].font(), font_width, font_height
+      p, buffer, main, start, end, offset,
+      fonts[cur_font_idx].styled(main.bold(), main.italic()),
+      font_width, font_height
     );
     buffer.resize(0);
   };
@@ -221,54 +442,71 @@ void QPaintGrid::draw(QPainter& p, QRect r, const double offset)
     for(int x = cols - 1; x >= 0; --x)
     {
       const auto& gc = area[y * cols + x];
-      const auto font_idx = editor_area->font_for_ucs(gc.ucs);
-      if (gc.text.isEmpty())
+      const auto font_idx = editor_area->cached_font_for_ucs(gc.ucs());
+      if (gc.empty())
       {
         const auto [tl, br] = get_pos(x + 1, y, 0);
-        draw_buf(s->attr_for_id(prev_hl_id), tl, end);
+        draw_buf(s->resolved_for_id(prev_hl_id), tl, end);
         end = br;
       }
       if (font_idx != cur_font_idx
-          && !(gc.text.isEmpty() || gc.text[0].isSpace()))
+          && !(gc.empty() || gc.is_space()))
       {
         const auto [tl, br] = get_pos(x, y, 1);
         QPointF buf_start = {br.x(), br.y() - font_height};
-        draw_buf(s->attr_for_id(prev_hl_id), buf_start, end);
+        draw_buf(s->resolved_for_id(prev_hl_id), buf_start, end);
         end = br;
         cur_font_idx = font_idx;
       }
-      if (gc.double_width)
+      if (gc.double_width())
       {
         // Assume previous buffer already drawn.
         const auto [tl, br] = get_pos(x, y, 2);
-        buffer.append(gc.text);
-        draw_buf(s->attr_for_id(gc.hl_id), tl, br);
+        gc.append_to(buffer);
+        draw_buf(s->resolved_for_id(gc.hl_id), tl, br);
         end = {tl.x(), tl.y() + font_height};
         prev_hl_id = gc.hl_id;
       }
       else if (gc.hl_id == prev_hl_id)
       {
-        buffer.append(gc.text);
+        gc.append_to(buffer);
         continue;
       }
       else
       {
         const auto [tl, br] = get_pos(x, y, 1);
         QPointF start = {br.x(), br.y() - font_height};
-        draw_buf(s->attr_for_id(prev_hl_id), start, end);
+        draw_buf(s->resolved_for_id(prev_hl_id), start, end);
         end = br;
-        buffer.append(gc.text);
+        gc.append_to(buffer);
         prev_hl_id = gc.hl_id;
       }
     }
     QPointF start = {0, y * font_height};
-    draw_buf(s->attr_for_id(prev_hl_id), start, end);
+    draw_buf(s->resolved_for_id(prev_hl_id), start, end);
+  }
+}
+
+void QPaintGrid::resolve_fonts()
+{
+  if (editor_area->fallback_list().size() <= 1) return;
+  const bool all_rows = redraw_pending();
+  // draw() always draws entire rows
+  for(int y = 0; y < rows; ++y)
+  {
+    if (!all_rows && dirty[y].empty()) continue;
+    for(int x = 0; x < cols; ++x)
+    {
+      editor_area->font_for_ucs(area[y * cols + x].ucs());
+    }
   }
 }
 
 void QPaintGrid::process_events()
 {
-  QPainter p(&pixmap);
+  // Dropped for the memory budget, drop_buffer() sent a redraw
+  if (storage.isNull()) update_backbuffer_size();
+  QPainter p(&backbuffer);
   const QColor bg = editor_area->default_bg();
   const auto offset = editor_area->font_offset();
   while(!evt_q.empty())
@@ -277,7 +515,7 @@ void QPaintGrid::process_events()
     switch(evt.type)
     {
       case PaintKind::Clear:
-        p.fillRect(pixmap.rect(), bg);
+        p.fillRect(backbuffer.rect(), bg);
         break;
       case PaintKind::Redraw:
         draw(p, {0, 0, cols, rows}, offset);
@@ -286,19 +524,56 @@ void QPaintGrid::process_events()
       case PaintKind::Draw:
         draw(p, evt.rect, offset);
         break;
+      case PaintKind::Scroll:
+        scroll_pixels(p, evt.rect, evt.rows);
+        break;
     }
     evt_q.pop();
   }
+  take_dirty([&](QRect r) { draw(p, r, offset); });
+}
+
+void QPaintGrid::scroll_pixels(QPainter& p, QRect r, int rows)
+{
+  const auto [font_width, font_height] = editor_area->font_dimensions();
+  const QRect px_rect = QRect(
+    std::round(r.x() * font_width), std::round(r.y() * font_height),
+    std::round(r.width() * font_width), std::round(r.height() * font_height)
+  ).intersected(backbuffer.rect());
+  const int dy = std::round(-rows * font_height);
+  const int height = px_rect.height() - std::abs(dy);
+  if (height <= 0) return;
+  // Flush the painter before touching the bits
+  p.end();
+  const std::size_t bytes_pp = backbuffer.depth() / 8;
+  const std::size_t offset = px_rect.x() * bytes_pp;
+  const std::size_t len = px_rect.width() * bytes_pp;
+  const auto move_line = [&](int dst_y) {
+    std::memmove(
+      backbuffer.scanLine(dst_y) + offset,
+      backbuffer.constScanLine(dst_y - dy) + offset,
+      len
+    );
+  };
+  // Go in the direction that doesn't overwrite lines before they're moved
+  if (dy < 0)
+  {
+    for(int y = px_rect.top(); y < px_rect.top() + height; ++y) move_line(y);
+  }
+  else
+  {
+    for(int y = px_rect.bottom(); y > px_rect.bottom() - height; --y) move_line(y);
+  }
+  p.begin(&backbuffer);
 }
 
 void QPaintGrid::render(QPainter& p)
 {
   auto&& [font_width, font_height] = editor_area->font_dimensions();
-  QRectF rect(top_left.x(), top_left.y(), pixmap.width(), pixmap.height());
-  auto snapshot_height = pixmap.height();
+  QRectF rect(top_left.x(), top_left.y(), backbuffer.width(), backbuffer.height());
   if (!editor_area->animations_enabled() || !is_scrolling)
   {
-    p.drawPixmap(pos(), pixmap);
+    p.drawImage(pos(), backbuffer);
     return;
   }
   p.fillRect(rect, editor_area->default_bg());
@@ -306,44 +581,49 @@ void QPaintGrid::render(QPainter& p)
   float cur_snapshot_top = viewport.topline * font_height;
   u32 min_topline = viewport.topline;
   u32 max_botline = viewport.botline;
-  for(auto it = snapshots.rbegin(); it != snapshots.rend(); ++it)
+  const auto& strips = ring.strips();
+  for(auto it = strips.rbegin(); it != strips.rend(); ++it)
   {
-    const auto& snapshot = *it;
+    const auto& strip = *it;
     QRectF r;
-    float snapshot_top = snapshot.vp.topline * font_height;
+    float snapshot_top = strip.topline * font_height;
     float offset = snapshot_top - cur_scroll_y;
-    auto pixmap_top = top_left.y() + offset;
+    auto image_top = top_left.y() + offset;
     QPointF pt;
-    if (snapshot.vp.topline < min_topline)
+    if (strip.top && strip.topline < min_topline)
     {
-      auto height = (min_topline - snapshot.vp.topline) * font_height;
-      height = std::min(height, float(snapshot_height));
-      min_topline = snapshot.vp.topline;
-      r = QRect(0, 0, pixmap.width(), height);
-      pt = {top_left.x(), pixmap_top};
+      auto height = (min_topline - strip.topline) * font_height;
+      height = std::min(height, float(strip.height));
+      min_topline = strip.topline;
+      r = QRectF(0, strip.ring_y, backbuffer.width(), height);
+      pt = {top_left.x(), image_top};
     }
-    else if (snapshot.vp.botline > max_botline)
+    else if (!strip.top && strip.botline > max_botline)
     {
-      auto height = (snapshot.vp.botline - max_botline) * font_height;
-      height = std::min(height, float(snapshot_height));
-      max_botline = snapshot.vp.botline;
-      r = QRect(0, snapshot_height - height, pixmap.width(), height);
-      pt = {top_left.x(), pixmap_top + pixmap.height() - height};
+      auto height = (strip.botline - max_botline) * font_height;
+      height = std::min(height, float(strip.height));
+      max_botline = strip.botline;
+      r = QRectF(
+        0, strip.ring_y + strip.height - height, backbuffer.width(), height
+      );
+      pt = {top_left.x(), image_top + backbuffer.height() - height};
     }
     QRectF draw_rect = {top_left, r.size()};
     if (!r.isNull() && rect.contains(draw_rect))
     {
-      p.drawPixmap(pt, snapshot.image, r);
+      p.drawImage(pt, scrollback, r);
     }
   }
   float offset = cur_snapshot_top - cur_scroll_y;
   QPointF pt = {top_left.x(), top_left.y() + offset};
-  p.drawPixmap(pt, pixmap);
+  p.drawImage(pt, backbuffer);
 }
 
 void QPaintGrid::viewport_changed(Viewport vp)
 {
-  if (!editor_area->animations_enabled() || viewport.topline == vp.topline)
+  if (!editor_area->animations_enabled()
+    || viewport.topline == vp.topline
+    || backbuffer.isNull())
   {
     GridBase::viewport_changed(vp);
     return;
@@ -354,20 +634,49 @@ void QPaintGrid::viewport_changed(Viewport vp)
   auto dest_topline = vp.topline;
   start_scroll_y = current_scroll_y;
   destination_scroll_y = static_cast<float>(dest_topline);
-  snapshots.push_back({viewport, pixmap});
-  if (snapshots.size() > editor_area->snapshot_limit())
-  {
-    snapshots.erase(snapshots.begin());
-  }
+  save_scrolled_rows(vp);
   GridBase::viewport_changed(vp);
-  auto interval = editor_area->scroll_animation_frametime();
   scroll_animation_time = editor_area->scroll_animation_duration();
-  if (scroll_animation_timer.interval() != interval)
+  is_scrolling = true;
+  editor_area->frame_scheduler().start_animation(
+    &scroll_animation_time,
+    [this](float dt) { return step_scroll_animation(dt); },
+    editor_area->scroll_animation_frametime()
+  );
+}
+
+void QPaintGrid::save_scrolled_rows(const Viewport& vp)
+{
+  auto font_height = editor_area->font_dimensions().height;
+  const int capacity = backbuffer.height() * 2;
+  if (scrollback.isNull() || scrollback.size() != QSize(backbuffer.width(), capacity))
   {
-    scroll_animation_timer.setInterval(interval);
+    scrollback = QImage(backbuffer.width(), capacity, backbuffer.format());
+    ring.reset(capacity);
+  }
+  const bool top = vp.topline > viewport.topline;
+  const u32 lines = std::min<u32>(
+    top ? vp.topline - viewport.topline : viewport.topline - vp.topline,
+    rows
+  );
+  const int height = std::min(
+    int(std::ceil(lines * font_height)), backbuffer.height()
+  );
+  const auto strip = ring.push(
+    {viewport.topline, viewport.botline, top, 0, height},
+    editor_area->snapshot_limit()
+  );
+  const int src_y = top ? 0 : backbuffer.height() - strip.height;
+  // backbuffer's lines are as long as storage's
+  const auto line_bytes = std::size_t(backbuffer.width()) * (backbuffer.depth() / 8);
+  for(int i = 0; i < strip.height; ++i)
+  {
+    std::memcpy(
+      scrollback.scanLine(strip.ring_y + i),
+      backbuffer.constScanLine(src_y + i),
+      line_bytes
+    );
   }
-  is_scrolling = true;
-  if (!scroll_animation_timer.isActive()) scroll_animation_timer.start();
 }
 
 void QPaintGrid::update_position(double new_x, double new_y)
@@ -383,54 +692,48 @@ void QPaintGrid::initialize_cache()
   });
 }
 
-void QPaintGrid::initialize_scroll_animation()
+bool QPaintGrid::step_scroll_animation(float dt)
 {
-  scroll_animation_timer.callOnTimeout([this] {
-    auto timer_interval = scroll_animation_timer.interval();
-    scroll_animation_time -= float(timer_interval) / 1000.f;
-    if (scroll_animation_time <= 0.f)
-    {
-      scroll_animation_timer.stop();
-      is_scrolling = false;
-      snapshots.clear();
-    }
-    else
-    {
-      auto diff = destination_scroll_y - start_scroll_y;
-      auto duration = editor_area->scroll_animation_duration();
-      auto animation_left = scroll_animation_time / duration;
-      float animation_finished = 1.0f - animation_left;
-      float scale = scroll_scaler(animation_finished);
-      current_scroll_y = start_scroll_y + (diff * scale);
-    }
-    editor_area->update();
-  });
+  scroll_animation_time -= dt;
+  if (scroll_animation_time <= 0.f)
+  {
+    is_scrolling = false;
+    ring.clear();
+    return false;
+  }
+  auto diff = destination_scroll_y - start_scroll_y;
+  auto duration = editor_area->scroll_animation_duration();
+  auto animation_left = scroll_animation_time / duration;
+  float animation_finished = 1.0f - animation_left;
+  float scale = scroll_scaler(animation_finished);
+  current_scroll_y = start_scroll_y + (diff * scale);
+  return true;
 }
 
-void QPaintGrid::initialize_move_animation()
+bool QPaintGrid::step_move_animation(float dt)
 {
-  move_update_timer.callOnTimeout([this] {
-    auto ms_interval = move_update_timer.interval();
-    move_animation_time -= float(ms_interval) / 1000.f;
-    if (move_animation_time <= 0)
-    {
-      move_update_timer.stop();
-      update_position(dest_move_x, dest_move_y);
-    }
-    else
-    {
-      auto x_diff = dest_move_x - old_move_x;
-      auto y_diff = dest_move_y - old_move_y;
-      auto duration = editor_area->move_animation_duration();
-      auto animation_left = move_animation_time / duration;
-      float animation_finished = 1.0f - animation_left;
-      float scale = move_scaler(animation_finished);
-      cur_left = old_move_x + (float(x_diff) * scale);
-      cur_top = old_move_y + (float(y_diff) * scale);
-      update_position(cur_left, cur_top);
-    }
-    editor_area->update();
-  });
+  move_animation_time -= dt;
+  if (move_animation_time <= 0)
+  {
+    update_position(dest_move_x, dest_move_y);
+    return false;
+  }
+  auto x_diff = dest_move_x - old_move_x;
+  auto y_diff = dest_move_y - old_move_y;
+  auto duration = editor_area->move_animation_duration();
+  auto animation_left = move_animation_time / duration;
+  float animation_finished = 1.0f - animation_left;
+  float scale = move_scaler(animation_finished);
+  cur_left = old_move_x + (float(x_diff) * scale);
+  cur_top = old_move_y + (float(y_diff) * scale);
+  update_position(cur_left, cur_top);
+  return true;
+}
+
+QPaintGrid::~QPaintGrid()
+{
+  editor_area->frame_scheduler().stop_animation(&move_animation_time);
+  editor_area->frame_scheduler().stop_animation(&scroll_animation_time);
 }
 
 void QPaintGrid::draw_cursor(QPainter& painter, const Cursor& cursor)
@@ -444,7 +747,7 @@ void QPaintGrid::draw_cursor(QPainter& painter, const Cursor& cursor)
   if (idx >= area.size()) return;
   const auto& gc = area[idx];
   float scale_factor = 1.0f;
-  if (gc.double_width) scale_factor = 2.0f;
+  if (gc.double_width()) scale_factor = 2.0f;
   auto rect_opt = cursor.rect(font_width, font_height, scale_factor);
   if (!rect_opt) return;
   auto [rect, hl_id, should_draw_text] = rect_opt.value();
@@ -458,11 +761,13 @@ void QPaintGrid::draw_cursor(QPainter& painter, const Cursor& cursor)
     float left = (x + pos.col) * font_width;
     float top = (y + pos.row) * font_height;
     const QPointF bot_left {left, top};
-    auto font_idx = editor_area->font_for_ucs(gc.ucs);
-    QFont chosen_font = editor_area->fallback_list()[font_idx].font();
+    auto font_idx = editor_area->font_for_ucs(gc.ucs());
+    const QFont& chosen_font = editor_area->fallback_list()[font_idx].styled(
+      cursor_attr.bold(), cursor_attr.italic()
+    );
     QRectF text_rect(left, top, font_width * scale_factor * 5., font_height);
     draw_text(
-      painter, gc.text, fg, cursor_attr.sp(), text_rect,
+      painter, gc.text(), fg, cursor_attr.sp(), text_rect,
       cursor_attr.font_opts, chosen_font, font_width, font_height
     );
   }
@@ -1,37 +1,117 @@
 #ifndef NVUI_GRID_HPP
 #define NVUI_GRID_HPP
 
+#include <QBrush>
+#include <QImage>
+#include <QRegion>
 #include <QStaticText>
 #include <QString>
-#include <QTimer>
+#include <QStringView>
 #include <QWidget>
+#include <algorithm>
 #include <cmath>
+#include <type_traits>
 #include <queue>
+#include <span>
+#include <vector>
+#include "decoration_tile.hpp"
 #include "hlstate.hpp"
+#include "lru_cache.hpp"
 #include "utils.hpp"
 #include "scalers.hpp"
+#include "scrollback_ring.hpp"
 #include "cursor.hpp"
 
-using grid_char = QString;
+/// The text of a grid cell. This is either a single code point,
+/// or an id into the cluster table (see GridChar::cluster_bit).
+using grid_char = std::uint32_t;
 
 class EditorArea;
 
+/// A single grid cell, packed into 8 bytes so that a grid
+/// stays small and can be copied/scrolled with a memmove.
+/// Text that doesn't fit in a single code point (e.g. combining
+/// characters) is interned in a cluster table shared by all grids.
 struct GridChar
 {
-  int hl_id; // Shouldn't have more than 65k highlight attributes
-  grid_char text;
-  bool double_width = false;
-  std::uint32_t ucs;
-  static grid_char grid_char_from_str(const std::string& s);
+  using u32 = std::uint32_t;
+  /// Set if the text is an id into the cluster table.
+  static constexpr u32 cluster_bit = 1u << 31;
+  /// Set if this cell holds a double-width character.
+  static constexpr u32 double_width_bit = 1u << 30;
+  GridChar() = default;
+  GridChar(grid_char text, int hl, bool dbl = false)
+    : code(text | (dbl ? double_width_bit : 0)),
+      hl_id(hl)
+  {
+  }
+  grid_char text_id() const { return code & ~double_width_bit; }
+  /// Cells after a double-width character have no text.
+  bool empty() const { return text_id() == 0; }
+  bool double_width() const { return code & double_width_bit; }
+  void set_double_width(bool dbl)
+  {
+    if (dbl) code |= double_width_bit;
+    else code &= ~double_width_bit;
+  }
+  /// The (first) code point of the text.
+  u32 ucs() const
+  {
+    if (code & cluster_bit) return cluster_ucs(text_id());
+    return text_id();
+  }
+  bool is_space() const { return QChar::isSpace(ucs()); }
+  /// Append the text of this cell to s.
+  void append_to(QString& s) const
+  {
+    const grid_char t = text_id();
+    if (t & cluster_bit) s.append(cluster_text(t));
+    else if (t == 0) return;
+    else if (QChar::requiresSurrogates(t))
+    {
+      s.append(QChar(QChar::highSurrogate(t)));
+      s.append(QChar(QChar::lowSurrogate(t)));
+    }
+    else s.append(QChar(static_cast<ushort>(t)));
+  }
+  QString text() const
+  {
+    QString s;
+    append_to(s);
+    return s;
+  }
+  /// Converts UTF-8 text to a grid_char, interning it if it's
+  /// not a single code point.
+  static grid_char grid_char_from_str(std::string_view s)
+  {
+    // Almost every cell is a single ASCII character, which is
+    // its own code point
+    // (1-127, whether char is signed or not)
+    if (s.size() == 1 && static_cast<unsigned char>(s[0]) - 1u < 0x7f)
+    {
+      return grid_char(static_cast<unsigned char>(s[0]));
+    }
+    return grid_char_from_utf8(s);
+  }
+  u32 code = 0;
+  int hl_id = 0; // Shouldn't have more than 65k highlight attributes
+private:
+  static grid_char grid_char_from_utf8(std::string_view s);
+  static QString cluster_text(grid_char id);
+  static u32 cluster_ucs(grid_char id);
 };
 
+static_assert(sizeof(GridChar) == 8);
+static_assert(std::is_trivially_copyable_v<GridChar>);
+
 // Differentiate between redrawing and clearing (since clearing is
 // a lot easier)
 enum PaintKind : std::uint8_t
 {
   Clear,
   Draw,
-  Redraw
+  Redraw,
+  Scroll
 };
 
 struct PaintEventItem
@@ -39,6 +119,27 @@ struct PaintEventItem
   PaintKind type;
   std::uint16_t grid_num;
   QRect rect;
+  /// For Scroll events, the number of rows the contents of rect
+  /// move up by (negative to move down).
+  int rows = 0;
+};
+
+/// Columns [start, end) of a row that have to be drawn.
+struct DirtySpan
+{
+  std::uint16_t start = 0;
+  std::uint16_t end = 0;
+  bool empty() const { return start >= end; }
+  void merge(DirtySpan o)
+  {
+    if (o.empty()) return;
+    if (empty()) *this = o;
+    else
+    {
+      start = std::min(start, o.start);
+      end = std::max(end, o.end);
+    }
+  }
 };
 
 struct Viewport
@@ -49,104 +150,57 @@ struct Viewport
   std::uint32_t curcol;
 };
 
-// Default delete does nothing (variables clean up themselves)
-template<typename T>
-struct do_nothing_deleter
+/// Hits and misses of a grid's text cache.
+struct CacheStats
 {
-  void operator()(T* p) const { Q_UNUSED(p); }
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
 };
 
-/// LRUCache with optional custom deleter
-/// I use the custom deleter for IDWriteTextLayout1
-/// so they get automatically released
-/// The caching strategy for QPaintGrid (using QStaticText)
-/// cleans up itself so the deleter doesn't need to be specified
-/// Once again, using Neovide's idea of caching text blobs.
-/// See
-/// https://github.com/neovide/neovide/blob/main/src/renderer/fonts/caching_shaper.rs
-/// Uses QHash internally since it's expected to be used with QString
-/// to cache drawn text.
-template<typename K, typename V, typename ValueDeleter = do_nothing_deleter<V>>
-class LRUCache
+/// Key of the caches of shaped text runs.
+struct TextCacheKey
 {
-public:
-  using key_type = K;
-  using value_type = V;
-  LRUCache(std::size_t capacity)
-    : max_size(capacity),
-      map(),
-      keys()
-  {
-    map.reserve(static_cast<int>(max_size));
-  }
+  QString text;
+  FontOptions font_opts = 0;
+};
 
-  V& put(K k, V v)
-  {
-    V* ptr = nullptr;
-    auto it = map.find(k);
-    if (it != map.end())
-    {
-      it->first = std::move(v);
-      ptr = &it->first;
-      move_to_front(it->second);
-    }
-    else
-    {
-      keys.push_front(k);
-      auto& pair_ref = map[k];
-      pair_ref = {v, keys.begin()};
-      ptr = &pair_ref.first;
-    }
-    if (keys.size() > max_size)
-    {
-      const auto& back_key = keys.back();
-      auto erase_it = map.find(back_key);
-      ValueDeleter()(std::addressof(erase_it->first));
-      map.erase(erase_it);
-      keys.pop_back();
-    }
-    return *ptr;
-  }
+/// A TextCacheKey that doesn't own its text, for looking
+/// up entries without copying the text.
+struct TextCacheKeyView
+{
+  QStringView text;
+  FontOptions font_opts = 0;
+};
 
-  V* get(const K& k)
+struct TextCacheHash
+{
+  std::size_t operator()(const TextCacheKeyView& k) const noexcept
   {
-    auto it = map.find(k);
-    if (it != map.end())
-    {
-      move_to_front(it->second);
-      return std::addressof(it->first);
-    }
-    else
-    {
-      return nullptr;
-    }
+    return qHash(k.text) ^ (std::size_t(k.font_opts) * 0x9E3779B9u);
   }
-
-  ~LRUCache()
+  std::size_t operator()(const TextCacheKey& k) const noexcept
   {
-    constexpr auto deleter = ValueDeleter();
-    for(auto& val : map) deleter(std::addressof(val.first));
+    return (*this)(TextCacheKeyView {k.text, k.font_opts});
   }
+};
 
-  void clear()
+struct TextCacheEqual
+{
+  bool operator()(const TextCacheKey& a, const TextCacheKeyView& b) const noexcept
   {
-    constexpr auto deleter = ValueDeleter();
-    for(auto& val : map) deleter(std::addressof(val.first));
-    map.clear();
-    keys.clear();
+    return a.font_opts == b.font_opts && QStringView(a.text) == b.text;
   }
-
-private:
-  // https://stackoverflow.com/questions/14579957/std-container-c-move-to-front
-  void move_to_front(typename std::list<K>::iterator it)
+  bool operator()(const TextCacheKey& a, const TextCacheKey& b) const noexcept
   {
-    if (it != keys.begin()) keys.splice(keys.begin(), keys, it);
+    return (*this)(a, TextCacheKeyView {b.text, b.font_opts});
   }
-  std::size_t max_size = 10;
-  QHash<K, QPair<V, typename std::list<K>::iterator>> map;
-  std::list<K> keys;
 };
 
+/// LRU cache of shaped text, looked up by TextCacheKeyView.
+template<typename V, typename ValueDeleter = do_nothing_deleter<V>>
+using TextCache =
+  LRUCache<TextCacheKey, V, ValueDeleter, TextCacheHash, TextCacheEqual>;
+
 /// The base grid object, no rendering functionality.
 /// Contains some convenience functions for setting text,
 /// position, size, etc.
@@ -171,13 +225,16 @@ public:
       rows(h),
       id(id),
       area(w * h),
+      dirty(h),
+      sent_hash(h),
       viewport({0, 0, 0, 0})
   {
   }
   GridBase(const GridBase& other)
   : QObject{}, x(other.x), y(other.y), cols(other.cols), rows(other.rows),
     id(other.id), area(other.area), hidden(other.hidden),
-    viewport(other.viewport)
+    dirty(other.dirty), sent_hash(other.sent_hash),
+    sent_generation(other.sent_generation), viewport(other.viewport)
   {
   }
   GridBase& operator=(const GridBase& other)
@@ -189,6 +246,9 @@ public:
     id = other.id;
     area = other.area;
     hidden = other.hidden;
+    dirty = other.dirty;
+    sent_hash = other.sent_hash;
+    sent_generation = other.sent_generation;
     viewport = other.viewport;
     return *this;
   }
@@ -202,37 +262,33 @@ public:
     bool is_dbl_width
   )
   {
-    std::uint32_t ucs;
-    if (c.isEmpty()) ucs = 0;
-    else
-    {
-      if (c.at(0).isHighSurrogate())
-      {
-        assert(c.size() >= 2);
-        ucs = QChar::surrogateToUcs4(c.at(0), c.at(1));
-      }
-      else ucs = c.at(0).unicode();
-    }
     // Neovim should make sure this isn't out-of-bounds
     assert(col + repeat <= cols);
-    for(std::uint16_t i = 0; i < repeat; ++i)
-    {
-      std::size_t idx = row * cols + col + i;
-      if (idx >= area.size()) return;
-      area[idx] = {hl_id, c, is_dbl_width, ucs};
-    }
+    const std::size_t idx = row * cols + col;
+    if (idx >= area.size()) return;
+    const std::size_t count = std::min<std::size_t>(repeat, area.size() - idx);
+    std::fill_n(area.begin() + idx, count, GridChar(c, hl_id, is_dbl_width));
+  }
+  /// Copy cells into row, starting at col
+  /// (clipped to the end of the row).
+  void set_cells(u16 row, u16 col, std::span<const GridChar> cells)
+  {
+    if (row >= rows || col >= cols) return;
+    const std::size_t count = std::min<std::size_t>(cells.size(), cols - col);
+    std::copy_n(cells.begin(), count, area.begin() + row * cols + col);
   }
-
   /**
    * Set the size of the grid (cols x rows)
    * to width x height.
    */
   virtual void set_size(u16 w, u16 h)
   {
-    static const GridChar empty_cell = {0, " ", false, QChar(' ').unicode()};
+    static const GridChar empty_cell = {' ', 0};
     resize_1d_vector(area, w, h, cols, rows, empty_cell);
     cols = w;
     rows = h;
+    dirty.assign(h, {});
+    sent_hash.assign(h, 0);
   }
   /**
    * Set the position of the grid in terms of
@@ -249,15 +305,164 @@ public:
   {
     clear_event_queue();
     evt_q.push({PaintKind::Redraw, 0, QRect()});
+    std::fill(sent_hash.begin(), sent_hash.end(), 0);
+    queued_damage = QRect(0, 0, cols, rows);
   }
   void send_clear()
   {
     clear_event_queue();
     evt_q.push({PaintKind::Clear, 0, QRect()});
+    std::fill(sent_hash.begin(), sent_hash.end(), 0);
+    queued_damage = QRect(0, 0, cols, rows);
   }
+  /// Mark the cells in r as needing to be drawn.
+  /// Rather than queueing an event for each call, this merges r
+  /// into per-row dirty spans, so that each row is drawn at most
+  /// once per process_events no matter how many updates it got.
   void send_draw(QRect r)
   {
-    evt_q.push({PaintKind::Draw, 0, r});
+    const DirtySpan span = clamp_span(r.left(), r.left() + r.width());
+    const int top = std::max(r.top(), 0);
+    const int bot = std::min(r.top() + r.height(), int(dirty.size()));
+    for(int row = top; row < bot; ++row)
+    {
+      dirty[row].merge(span);
+      sent_hash[row] = 0;
+    }
+  }
+  /**
+   * Same as send_draw, but rows whose contents are the same as the
+   * last time they were sent this way (with the same highlight
+   * generation) are skipped, since their pixels are already up to date.
+   * Neovim often resends lines that didn't change (statuslines, sign
+   * columns, the rest of a line after an edit).
+   */
+  void send_draw_changed(QRect r, u32 hl_generation)
+  {
+    if (hl_generation != sent_generation)
+    {
+      std::fill(sent_hash.begin(), sent_hash.end(), 0);
+      sent_generation = hl_generation;
+    }
+    const DirtySpan span = clamp_span(r.left(), r.left() + r.width());
+    const int top = std::max(r.top(), 0);
+    const int bot = std::min(r.top() + r.height(), int(dirty.size()));
+    for(int row = top; row < bot; ++row)
+    {
+      const u64 hash = row_hash(row);
+      if (hash == sent_hash[row]) continue;
+      sent_hash[row] = hash;
+      dirty[row].merge(span);
+    }
+  }
+  /// Hash of the cells of a row (never 0).
+  u64 row_hash(int row) const
+  {
+    u64 hash = 0xcbf29ce484222325;
+    const std::size_t start = std::size_t(row) * cols;
+    const std::size_t end = std::min(start + cols, area.size());
+    for(std::size_t i = start; i < end; ++i)
+    {
+      const u64 cell = u64(area[i].code) << 32 | u32(area[i].hl_id);
+      hash = (hash ^ cell) * 0x100000001b3;
+      hash ^= hash >> 29;
+    }
+    return hash | 1;
+  }
+  /// Shift the already painted contents of r (in cells) up by rows
+  /// (down if negative). The rows that are scrolled in still have
+  /// to be drawn.
+  void send_scroll(QRect r, int rows)
+  {
+    evt_q.push({PaintKind::Scroll, 0, r, rows});
+    queued_damage |= r;
+    // Pending draws move along with the cells they belong to,
+    // since they'll be drawn after the pixels have been shifted.
+    const DirtySpan cols_span = clamp_span(r.left(), r.left() + r.width());
+    const int top = std::max(r.top(), 0);
+    const int bot = std::min(r.top() + r.height(), int(dirty.size()));
+    if (top >= bot || cols_span.empty()) return;
+    // Rows only keep their hash if all of their pixels moved
+    const bool full_width = cols_span.start == 0 && cols_span.end == cols;
+    std::vector<u64> shifted_hash(bot - top, 0);
+    for(int row = top; row < bot; ++row)
+    {
+      const int src = row + rows;
+      if (full_width && src >= top && src < bot)
+      {
+        shifted_hash[row - top] = sent_hash[src];
+      }
+    }
+    std::copy(shifted_hash.begin(), shifted_hash.end(), sent_hash.begin() + top);
+    std::vector<DirtySpan> shifted(bot - top);
+    for(int row = top; row < bot; ++row)
+    {
+      const int src = row + rows;
+      DirtySpan& span = shifted[row - top];
+      // Rows that are scrolled in get drawn anyway
+      if (src < top || src >= bot) span = cols_span;
+      else span = intersect(dirty[src], cols_span);
+      // Columns outside of the scrolled region stay where they were
+      const DirtySpan& old = dirty[row];
+      if (old.start < cols_span.start || old.end > cols_span.end)
+      {
+        span.merge(old);
+      }
+    }
+    std::copy(shifted.begin(), shifted.end(), dirty.begin() + top);
+  }
+  /// Calls f with each run of consecutive dirty rows (as a rect,
+  /// in cells), then clears the dirty spans.
+  template<typename F>
+  void take_dirty(F&& f)
+  {
+    const int num_rows = int(dirty.size());
+    for(int row = 0; row < num_rows;)
+    {
+      if (dirty[row].empty()) { ++row; continue; }
+      DirtySpan run = dirty[row];
+      int end_row = row;
+      while(end_row < num_rows && !dirty[end_row].empty())
+      {
+        run.merge(dirty[end_row]);
+        dirty[end_row] = {};
+        ++end_row;
+      }
+      f(QRect(run.start, row, run.end - run.start, end_row - row));
+      row = end_row;
+    }
+  }
+  /// Whether the whole grid is going to be redrawn.
+  bool redraw_pending() const
+  {
+    return !evt_q.empty() && evt_q.front().type == PaintKind::Redraw;
+  }
+  /// Whether there's anything left to paint.
+  bool has_pending_paint() const
+  {
+    return !evt_q.empty() || std::any_of(dirty.begin(), dirty.end(), [](const auto& d) {
+      return !d.empty();
+    });
+  }
+  /**
+   * Returns the cells (relative to the grid) that have changed since
+   * the last call: what the queued events touch, plus every row with
+   * a dirty span, since rows are drawn whole.
+   */
+  QRegion take_damage()
+  {
+    QRegion damage {queued_damage};
+    queued_damage = QRect();
+    const int num_rows = int(dirty.size());
+    for(int row = 0; row < num_rows;)
+    {
+      if (dirty[row].empty()) { ++row; continue; }
+      int end_row = row;
+      while(end_row < num_rows && !dirty[end_row].empty()) ++end_row;
+      damage += QRect(0, row, cols, end_row - row);
+      row = end_row;
+    }
+    return damage;
   }
   /// Grid's top left position
   QPoint top_left() { return {x, y}; };
@@ -269,12 +474,59 @@ public:
   void clear_event_queue()
   {
     decltype(evt_q)().swap(evt_q);
+    std::fill(dirty.begin(), dirty.end(), DirtySpan {});
   }
   /// Change the viewport to the new viewport.
   virtual void viewport_changed(Viewport vp)
   {
     viewport = vp;
   }
+  /// Bytes held for smooth scrolling, if the grid keeps any.
+  virtual std::size_t snapshot_memory() const { return 0; }
+  /// Bytes held for the grid's paint buffer, if it has one.
+  virtual std::size_t buffer_memory() const { return 0; }
+  virtual CacheStats text_cache_stats() const { return {}; }
+  /// Whether the grid can become a w x h grid without
+  /// reallocating its paint buffer (see GridPool).
+  virtual bool can_reuse(u16, u16) const { return true; }
+  /// Called when Neovim destroys the grid and it's kept for reuse.
+  /// Stops anything that's still running for it.
+  virtual void retire() { clear_event_queue(); }
+  /// Give back paint buffer space the grid doesn't need anymore
+  /// (after a live resize).
+  virtual void trim_buffer() {}
+  /// Rough size of a cached text layout (the key, the text and
+  /// its shaped glyphs), neither Qt nor DirectWrite tell.
+  static constexpr std::size_t text_cache_entry_bytes = 512;
+  /// Estimated bytes held by the cached text layouts.
+  virtual std::size_t text_cache_memory() const { return 0; }
+  /**
+   * The functions below free memory for the MemoryBudget, and
+   * return the number of bytes that were freed.
+   * Free the smooth scrolling snapshots, unless they're being used.
+   */
+  virtual std::size_t drop_snapshots() { return 0; }
+  /// Free at least bytes of the least recently used text layouts.
+  virtual std::size_t trim_text_cache(std::size_t) { return 0; }
+  /// Free the paint buffer of a hidden grid. It's allocated
+  /// and repainted once the grid is drawn again.
+  virtual std::size_t drop_buffer() { return 0; }
+  /// Make the grid the same as a new grid created with these
+  /// arguments, keeping its buffers.
+  virtual void reuse(u16 new_x, u16 new_y, u16 w, u16 h, u16 new_id)
+  {
+    id = new_id;
+    z_index = 0;
+    winid = 0;
+    hidden = false;
+    is_float_grid = false;
+    viewport = {0, 0, 0, 0};
+    static const GridChar empty_cell = {' ', 0};
+    std::fill(area.begin(), area.end(), empty_cell);
+    GridBase::set_pos(new_x, new_y);
+    set_size(w, h);
+    send_redraw();
+  }
   bool is_float() const { return is_float_grid; }
   void set_floating(bool f) { is_float_grid = f; }
   void win_pos(u16 x, u16 y)
@@ -287,6 +539,19 @@ public:
     set_pos(x, y);
     set_floating(true);
   }
+private:
+  DirtySpan clamp_span(int start, int end) const
+  {
+    start = std::clamp(start, 0, int(cols));
+    end = std::clamp(end, 0, int(cols));
+    return {u16(start), u16(end)};
+  }
+  static DirtySpan intersect(DirtySpan a, DirtySpan b)
+  {
+    DirtySpan res {std::max(a.start, b.start), std::min(a.end, b.end)};
+    if (res.empty()) return {};
+    return res;
+  }
 public:
   u16 x;
   u16 y;
@@ -297,7 +562,18 @@ public:
   std::int64_t winid = 0;
   std::vector<GridChar> area; // Size = rows * cols
   bool hidden = false;
+  /// Clear, Redraw and Scroll events, in order.
+  /// Draws are tracked through the dirty spans.
   std::queue<PaintEventItem> evt_q;
+  /// Dirty columns of each row (size = rows).
+  std::vector<DirtySpan> dirty;
+  /// row_hash() of each row when it was last sent with
+  /// send_draw_changed(), 0 if its pixels may not match it.
+  std::vector<u64> sent_hash;
+  u32 sent_generation = 0;
+  /// Cells touched by the Clear, Redraw and Scroll events queued since
+  /// the last take_damage().
+  QRect queued_damage;
   Viewport viewport;
   bool is_float_grid = false;
   /// Not used in GridBase (may not even be used at all
@@ -315,34 +591,60 @@ class QPaintGrid : public GridBase
 {
   Q_OBJECT
   using GridBase::u16;
-  struct Snapshot
-  {
-    Viewport vp;
-    QPixmap image;
-  };
 public:
   template<typename... GridBaseArgs>
   QPaintGrid(EditorArea* ea, GridBaseArgs... args)
     : GridBase(args...),
       editor_area(ea),
-      pixmap(),
+      backbuffer(),
       top_left(),
       text_cache(2000)
   {
-    update_pixmap_size();
+    update_backbuffer_size();
+    send_redraw();
     update_position(x, y);
     initialize_cache();
-    initialize_scroll_animation();
-    initialize_move_animation();
   }
-  ~QPaintGrid() override = default;
+  ~QPaintGrid() override;
   void set_size(u16 w, u16 h) override;
   void set_pos(u16 new_x, u16 new_y) override;
   void viewport_changed(Viewport vp) override;
-  /// Process the draw commands in the event queue
+  /// Resolve the fallback fonts of every cell process_events is
+  /// going to draw. Must be called on the GUI thread first.
+  void resolve_fonts();
+  /// Process the draw commands in the event queue.
+  /// This only paints to the grid's own backbuffer, and can run on
+  /// any thread once resolve_fonts() has been called.
   void process_events();
-  /// Returns the grid's paint buffer (QPixmap)
-  const QPixmap& buffer() const { return pixmap; }
+  /// Returns the grid's paint buffer
+  const QImage& buffer() const { return backbuffer; }
+  /// Bytes used for the smooth scrolling snapshots.
+  std::size_t snapshot_memory() const override
+  {
+    return scrollback.sizeInBytes();
+  }
+  std::size_t buffer_memory() const override
+  {
+    return storage.sizeInBytes();
+  }
+  CacheStats text_cache_stats() const override
+  {
+    return {text_cache.hits(), text_cache.misses()};
+  }
+  std::size_t text_cache_memory() const override
+  {
+    return text_cache.size() * text_cache_entry_bytes;
+  }
+  bool can_reuse(u16 w, u16 h) const override;
+  void retire() override;
+  void reuse(u16 new_x, u16 new_y, u16 w, u16 h, u16 new_id) override;
+  void trim_buffer() override;
+  std::size_t drop_snapshots() override;
+  std::size_t trim_text_cache(std::size_t bytes) override;
+  std::size_t drop_buffer() override;
+  /// Backbuffers are allocated in steps of this many pixels, so
+  /// that grids of similar sizes can share them.
+  static constexpr int buffer_bucket = 64;
   /// The top-left corner of the grid (where to start drawing the buffer).
   QPointF pos() const { return top_left; }
   /// Renders to the painter.
@@ -350,20 +652,22 @@ public:
   /// Draws the cursor on the painter, relative to the grid's
   /// current position (see pos())
   void draw_cursor(QPainter& painter, const Cursor& cursor);
-private:
+protected:
   /// Draw the grid range given by the rect.
-  void draw(QPainter& p, QRect r, const double font_offset);
-  /// Draw the given text with attr and def_clrs indicating
-  /// the background, foreground colors and font options.
+  virtual void draw(QPainter& p, QRect r, const double font_offset);
+  /// Shift the pixels of r (in cells) up by the given number of rows.
+  void scroll_pixels(QPainter& p, QRect r, int rows);
+  /// Draw the given text with hl indicating the background,
+  /// foreground colors and font options.
+  /// font should already be styled for hl (see Font::styled).
   void draw_text_and_bg(
     QPainter& painter,
     const QString& text,
-    const HLAttr& attr,
-    const HLAttr& def_clrs,
+    const ResolvedHL& hl,
     const QPointF& start,
     const QPointF& end,
     const int offset,
-    QFont font,
+    const QFont& font,
     float font_width,
     float font_height
   );
@@ -374,26 +678,49 @@ private:
     const std::optional<Color>& sp,
     const QRectF& rect,
     const FontOptions font_opts,
-    QFont& font,
+    const QFont& font,
+    float font_width,
+    float font_height
+  );
+  /// Fill the bottom of rect with the undercurl tile for color.
+  void draw_undercurl(
+    QPainter& painter,
+    const QRectF& rect,
+    const Color& color,
     float font_width,
     float font_height
   );
-  /// Update the pixmap size
-  void update_pixmap_size();
+  /// Update the backbuffer size. Returns true if the storage was big
+  /// enough, so the pixels that were drawn are still there.
+  bool update_backbuffer_size();
   /// Initialize the cache
   void initialize_cache();
-  /// Initialize scroll animation timer
-  void initialize_scroll_animation();
-  /// Initialize move animation timer
-  void initialize_move_animation();
+  /// Advance the scroll animation by dt seconds.
+  /// Returns false once it has finished.
+  bool step_scroll_animation(float dt);
+  /// Advance the move animation by dt seconds.
+  /// Returns false once it has finished.
+  bool step_move_animation(float dt);
   /// Update the grid's position (new position can be found through pos()).
   void update_position(double new_x, double new_y);
-private:
-  std::vector<Snapshot> snapshots;
   /// Links up with the default Qt rendering
   EditorArea* editor_area;
-  QPixmap pixmap;
-  QTimer move_update_timer {};
+private:
+  /// Save the rows of the backbuffer that are about to be scrolled out
+  /// of view (going from the current viewport to vp) to the scrollback.
+  void save_scrolled_rows(const Viewport& vp);
+  /// Rows that were scrolled out of view, drawn during the smooth
+  /// scrolling animation. Twice the height of the backbuffer, and
+  /// allocated on the first scroll.
+  QImage scrollback;
+  ScrollbackRing ring;
+  /// What backbuffer points into, rounded up to buffer_bucket
+  /// pixels. Only reallocated when the grid grows past it.
+  QImage storage;
+  /// The grid's pixels, the top-left of storage.
+  /// A QImage rather than a QPixmap so it can be painted
+  /// outside the GUI thread.
+  QImage backbuffer;
   float move_animation_time = -1.f;
   QPointF top_left;
   float start_scroll_y = 0.f;
@@ -402,14 +729,14 @@ private:
   float cur_top = 0.f;
   bool is_scrolling = false;
   float scroll_animation_time;
-  QTimer scroll_animation_timer {};
   float dest_move_x = 0.f;
   float dest_move_y = 0.f;
   float old_move_x = 0.f;
   float old_move_y = 0.f;
   float destination_scroll_y = 0.f;
   using FontOptions = decltype(HLAttr::font_opts);
-  LRUCache<QPair<QString, FontOptions>, QStaticText> text_cache;
+  TextCache<QStaticText> text_cache;
+  decoration::TileCache<QBrush> undercurl_tiles {decoration::tile_cache_size};
 };
 
 #endif // NVUI_GRID_HPP
@@ -0,0 +1,115 @@
+#ifndef NVUI_GRID_LINES_HPP
+#define NVUI_GRID_LINES_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "grid.hpp"
+#include "object.hpp"
+#include "redraw_events.hpp"
+
+/// The cells of every grid_line event in a redraw batch, decoded
+/// into GridChars.
+/// Decoding is most of the work of a grid_line and doesn't depend on
+/// the grids, so it's done on Nvim's reader thread while the GUI
+/// thread is busy with earlier batches. The GUI thread then only
+/// has to copy the cells into place, in the same order as the events.
+class GridLines
+{
+public:
+  using u16 = std::uint16_t;
+  using u32 = std::uint32_t;
+  /// One line of a grid_line event.
+  struct Line
+  {
+    u16 grid = 0;
+    u16 row = 0;
+    u16 col = 0;
+    u32 first = 0;
+    u32 count = 0;
+  };
+  /// Decode the grid_line events of a "redraw" notification.
+  void decode(const Object& redraw)
+  {
+    const auto* arr = redraw.array();
+    if (!arr || arr->size() < 3) return;
+    const auto* events = arr->at(2).array();
+    if (!events) return;
+    for(const auto& o : *events)
+    {
+      // Same as what's dispatched by Window::handle_redraw
+      const auto* task = o.array();
+      if (!task || task->size() == 0) continue;
+      const auto name = task->at(0).str();
+      if (!name || redraw_events::from_name(*name) != RedrawEvent::grid_line)
+      {
+        continue;
+      }
+      decode_event(std::span {task->data() + 1, task->size() - 1});
+    }
+  }
+  /// Decode the arguments of a grid_line event. Each argument
+  /// becomes one Line, even if it's invalid (with no cells).
+  void decode_event(std::span<const Object> args)
+  {
+    // hl_id carries over from the previous cell that had one
+    int hl_id = 0;
+    for(const auto& arg : args)
+    {
+      Line& line = lines.emplace_back();
+      line.first = u32(cells.size());
+      const auto* arr = arg.array();
+      if (!arr || arr->size() < 4) continue;
+      const auto* line_cells = arr->at(3).array();
+      if (!line_cells) continue;
+      line.grid = arr->at(0).try_convert<u16>().value_or(0);
+      line.row = arr->at(1).try_convert<u16>().value_or(0);
+      line.col = arr->at(2).try_convert<u16>().value_or(0);
+      for(const auto& cell : *line_cells)
+      {
+        // [text, (hl_id, repeat)]
+        const auto* cell_arr = cell.array();
+        if (!cell_arr || cell_arr->empty()) continue;
+        const auto text = cell_arr->at(0).str();
+        if (!text) continue;
+        const grid_char c = GridChar::grid_char_from_str(*text);
+        // The cell after a double-width character is empty. If that's
+        // the first cell, the GUI thread has to mark the grid's cell.
+        if (c == 0 && cells.size() > line.first)
+        {
+          cells.back().set_double_width(true);
+        }
+        int repeat = 1;
+        if (cell_arr->size() >= 2)
+        {
+          hl_id = cell_arr->at(1).try_convert<int>().value_or(hl_id);
+        }
+        if (cell_arr->size() >= 3)
+        {
+          repeat = std::max(cell_arr->at(2).try_convert<int>().value_or(1), 0);
+        }
+        cells.insert(cells.end(), std::size_t(repeat), GridChar(c, hl_id));
+      }
+      line.count = u32(cells.size()) - line.first;
+    }
+  }
+  /// The next line, in the order they were decoded,
+  /// or nullptr if there are none left.
+  const Line* next()
+  {
+    if (next_line >= lines.size()) return nullptr;
+    return &lines[next_line++];
+  }
+  std::span<const GridChar> cells_of(const Line& line) const
+  {
+    return {cells.data() + line.first, line.count};
+  }
+  std::size_t size() const { return lines.size(); }
+private:
+  std::vector<GridChar> cells;
+  std::vector<Line> lines;
+  std::size_t next_line = 0;
+};
+
+#endif // NVUI_GRID_LINES_HPP
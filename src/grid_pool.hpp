@@ -0,0 +1,64 @@
+#ifndef NVUI_GRID_POOL_HPP
+#define NVUI_GRID_POOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+/// Grids that Neovim destroyed, kept around so that the next grids
+/// can reuse them (and their paint buffers, caches and timers)
+/// instead of being allocated from scratch. Plugins open and close
+/// floats (hover docs, signature help, pickers, notifications)
+/// many times per second.
+/// Grid must have can_reuse(w, h) and buffer_memory().
+template<typename Grid>
+class GridPool
+{
+public:
+  using u16 = std::uint16_t;
+  explicit GridPool(std::size_t max_size = 4) : max_size(max_size) {}
+  /// Keep grid for later. When the pool is full, the grid that was
+  /// released first is freed.
+  void release(std::unique_ptr<Grid> grid)
+  {
+    if (!grid || max_size == 0) return;
+    if (grids.size() >= max_size) grids.pop_front();
+    grids.push_back(std::move(grid));
+  }
+  /// Take the grid with the smallest buffer that can hold a w x h
+  /// grid, or nullptr if there's none.
+  std::unique_ptr<Grid> acquire(u16 w, u16 h)
+  {
+    auto best = grids.end();
+    for(auto it = grids.begin(); it != grids.end(); ++it)
+    {
+      if (!(*it)->can_reuse(w, h)) continue;
+      if (best == grids.end()
+        || (*it)->buffer_memory() < (*best)->buffer_memory())
+      {
+        best = it;
+      }
+    }
+    if (best == grids.end()) return nullptr;
+    auto grid = std::move(*best);
+    grids.erase(best);
+    return grid;
+  }
+  /// Bytes held by the buffers of the pooled grids.
+  std::size_t buffer_memory() const
+  {
+    std::size_t total = 0;
+    for(const auto& grid : grids) total += grid->buffer_memory();
+    return total;
+  }
+  std::size_t size() const { return grids.size(); }
+  bool empty() const { return grids.empty(); }
+  void clear() { grids.clear(); }
+private:
+  std::size_t max_size;
+  std::deque<std::unique_ptr<Grid>> grids;
+};
+
+#endif // NVUI_GRID_POOL_HPP
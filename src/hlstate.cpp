@@ -106,25 +106,61 @@ int HLState::id_for_name(const std::string &name) const
 
 void HLState::set_name_id(const std::string& name, std::uint32_t hl_id)
 {
-  name_to_id[name] = hl_id;
+  auto& id = name_to_id[name];
+  if (id == hl_id) return;
+  id = hl_id;
+  ++resolved_generation;
 }
 
 void HLState::set_id_attr(int id, HLAttr attr)
 {
+  // Neovim defines new ids all the time while redrawing, which
+  // can't change anything that was drawn with the ones before
+  // them. Only a redefined id can.
+  if (id < (int) id_to_attr.size()) ++resolved_generation;
   if (id > (int) id_to_attr.size())
   {
     // Shouldn't happen with the way Neovim gives us highlight
     // attributes but just to make sure
     id_to_attr.resize(id + 1);
+    resolved_attrs.resize(id + 1, resolved_default);
   }
   if (id == (int) id_to_attr.size())
   {
+    resolved_attrs.push_back(resolve(attr));
     id_to_attr.emplace_back(std::move(attr));
     return;
   }
+  resolved_attrs[id] = resolve(attr);
   id_to_attr[id] = std::move(attr);
 }
 
+ResolvedHL HLState::resolve(const HLAttr& attr) const
+{
+  ResolvedHL r;
+  // Neovim sends the default colors before drawing anything,
+  // but attributes can be defined before that
+  r.fg = attr.foreground.value_or(default_colors.foreground.value_or(Color()));
+  r.bg = attr.background.value_or(default_colors.background.value_or(Color()));
+  r.sp = attr.special.value_or(default_colors.special.value_or(r.fg));
+  if (attr.reverse) std::swap(r.fg, r.bg);
+  r.qfg = r.fg.qcolor();
+  r.qbg = r.bg.qcolor();
+  r.qsp = r.sp.qcolor();
+  r.font_opts = attr.font_opts;
+  return r;
+}
+
+void HLState::resolve_all()
+{
+  ++resolved_generation;
+  resolved_default = resolve(default_colors);
+  for(std::size_t i = 0; i < id_to_attr.size(); ++i)
+  {
+    resolved_attrs[i] = resolve(id_to_attr[i]);
+  }
+}
+
 void HLState::default_colors_set(const Object& obj)
 {
   // We only look at the first three values (the others are ctermfg
@@ -138,6 +174,7 @@ void HLState::default_colors_set(const Object& obj)
   default_colors.foreground = *fg;
   default_colors.background = *bg;
   default_colors.special = *sp;
+  resolve_all();
 }
 
 const HLAttr& HLState::default_colors_get() const
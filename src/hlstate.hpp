@@ -129,6 +129,28 @@ public:
   float opacity = 1;
 };
 
+/// A highlight attribute with the default colors and reverse
+/// already applied, so the renderers don't have to resolve it
+/// for every run of text they draw.
+struct ResolvedHL
+{
+  Color fg {};
+  Color bg {};
+  Color sp {};
+  QColor qfg;
+  QColor qbg;
+  QColor qsp;
+  FontOptions font_opts = FontOpts::Normal;
+  bool bold() const { return font_opts & FontOpts::Bold; }
+  bool italic() const { return font_opts & FontOpts::Italic; }
+  /// Whether there's an underline, undercurl or strikethrough to draw.
+  bool decorated() const
+  {
+    return font_opts
+      & (FontOpts::Underline | FontOpts::Undercurl | FontOpts::Strikethrough);
+  }
+};
+
 /// Keeps the highlight state of Neovim
 /// HlState is essentially a map of highlight names to their
 /// corresponding id's, and a secondary map of id's to
@@ -177,11 +199,36 @@ public:
   Color default_bg() const { return default_colors.bg().value(); }
   Color default_fg() const { return default_colors.fg().value(); }
   HLAttr::ColorPair colors_for(const HLAttr& attr) const;
+  /**
+   * Returns the resolved highlight attribute for the given id.
+   * These are only recomputed when an attribute is defined
+   * or the default colors change.
+   */
+  const ResolvedHL& resolved_for_id(int id) const
+  {
+    if (id < 0 || id >= (int) resolved_attrs.size()) return resolved_default;
+    return resolved_attrs[id];
+  }
+  /**
+   * Incremented when an id that was already defined is defined
+   * again, when the default colors change, or when the id of a
+   * highlight group changes. Defining a new id doesn't change it:
+   * nothing drawn before can use that id. Defining one may move the
+   * attributes though, so keep ids rather than references to them.
+   */
+  std::uint32_t generation() const { return resolved_generation; }
 private:
+  ResolvedHL resolve(const HLAttr& attr) const;
+  /// Re-resolve every attribute, for when the default colors change.
+  void resolve_all();
   HLAttr default_colors;
   std::unordered_map<std::string, std::uint32_t> name_to_id;
   //std::unordered_map<int, HLAttr> id_to_attr;
   std::vector<HLAttr> id_to_attr {1};
+  /// Indexed the same way as id_to_attr
+  std::vector<ResolvedHL> resolved_attrs {1};
+  ResolvedHL resolved_default;
+  std::uint32_t resolved_generation = 0;
 };
 
 /// Defining a function to parse "hl_attr_define" data
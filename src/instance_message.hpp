@@ -0,0 +1,45 @@
+#ifndef NVUI_INSTANCE_MESSAGE_HPP
+#define NVUI_INSTANCE_MESSAGE_HPP
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// What an nvui started with --single-instance sends to the one
+/// that's already running: the Neovim arguments for the new tab.
+/// The message is a magic line followed by each argument and a NUL,
+/// arguments on a command line can't contain one.
+namespace instance_message
+{
+  inline constexpr std::string_view magic = "nvui-open 1\n";
+
+  inline std::string encode(const std::vector<std::string>& args)
+  {
+    std::string out {magic};
+    for(const auto& arg : args)
+    {
+      out += arg;
+      out += '\0';
+    }
+    return out;
+  }
+
+  /// The arguments in data, nullopt if it isn't a complete message.
+  inline std::optional<std::vector<std::string>> decode(std::string_view data)
+  {
+    if (!data.starts_with(magic)) return std::nullopt;
+    data.remove_prefix(magic.size());
+    if (!data.empty() && data.back() != '\0') return std::nullopt;
+    std::vector<std::string> args;
+    while(!data.empty())
+    {
+      const auto end = data.find('\0');
+      args.emplace_back(data.substr(0, end));
+      data.remove_prefix(end + 1);
+    }
+    return args;
+  }
+}
+
+#endif // NVUI_INSTANCE_MESSAGE_HPP
@@ -0,0 +1,260 @@
+#ifndef NVUI_LATENCY_TRACE_HPP
+#define NVUI_LATENCY_TRACE_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fmt/format.h>
+
+/// Key-to-photon latency tracing (--trace-latency, NVUI_LATENCY_TRACE).
+/// Every key press is timed through each stage until its result is on
+/// screen, to tell which stage dominates typing latency.
+/// Stages are marked from the GUI, writer and reader threads. When
+/// tracing is off, marking a stage is a single relaxed load.
+class LatencyTrace
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  enum Stage : std::uint8_t
+  {
+    /// EditorArea::keyPressEvent
+    Key,
+    /// The key was written to Neovim
+    Write,
+    /// The first redraw batch after the write was received
+    Redraw,
+    /// Neovim's flush was handled
+    Flush,
+    /// A frame was painted
+    Present,
+    num_stages
+  };
+  static constexpr std::array<const char*, num_stages> stage_names {
+    "key", "write", "redraw", "flush", "present"
+  };
+  /// Finished keys kept for the statistics and the trace export.
+  static constexpr std::size_t max_samples = 4096;
+  /// Keys in flight. When there are more, the oldest is dropped.
+  static constexpr std::size_t max_open = 64;
+  /// Keys that get no further than this (e.g. a key that's waiting
+  /// for the rest of a mapping) are dropped.
+  static constexpr auto timeout = std::chrono::seconds(2);
+  /// Upper bounds (in ms) of the histogram buckets, the last
+  /// bucket has everything above.
+  static constexpr std::array<double, 10> bucket_bounds {
+    0.5, 1, 2, 4, 8, 16, 32, 64, 128, 256
+  };
+  struct Sample
+  {
+    std::array<Clock::time_point, num_stages> at {};
+    std::uint8_t reached = Key;
+    /// Milliseconds from stage from to stage to.
+    double ms(Stage from, Stage to) const
+    {
+      return std::chrono::duration<double, std::milli>(at[to] - at[from]).count();
+    }
+  };
+  struct Summary
+  {
+    std::size_t count = 0;
+    double p50 = 0.;
+    double p90 = 0.;
+    double p99 = 0.;
+    double max = 0.;
+  };
+
+  void set_enabled(bool enable)
+  {
+    std::lock_guard lock {mutex};
+    if (!enable) open.clear();
+    on.store(enable, std::memory_order_relaxed);
+  }
+  bool enabled() const { return on.load(std::memory_order_relaxed); }
+  /**
+   * Mark that stage s happened. A Key starts a new sample, any other
+   * stage is recorded for every key that's at the stage before it
+   * (keys that were written together have the same redraw).
+   */
+  void mark(Stage s, Clock::time_point now = Clock::now())
+  {
+    if (!enabled()) return;
+    std::lock_guard lock {mutex};
+    while(!open.empty() && now - open.front().at[open.front().reached] > timeout)
+    {
+      open.pop_front();
+    }
+    if (s == Key)
+    {
+      if (open.size() >= max_open) open.pop_front();
+      Sample& sample = open.emplace_back();
+      sample.at[Key] = now;
+      return;
+    }
+    for(auto& sample : open)
+    {
+      if (sample.reached + 1 != s) continue;
+      sample.at[s] = now;
+      sample.reached = s;
+    }
+    if (s != Present) return;
+    while(!open.empty() && open.front().reached == Present)
+    {
+      if (done.size() >= max_samples) done.pop_front();
+      done.push_back(open.front());
+      open.pop_front();
+    }
+  }
+  /// The keys that made it to the screen, oldest first.
+  std::vector<Sample> samples() const
+  {
+    std::lock_guard lock {mutex};
+    return {done.begin(), done.end()};
+  }
+  void clear()
+  {
+    std::lock_guard lock {mutex};
+    open.clear();
+    done.clear();
+  }
+  /// Statistics of the time from stage from to stage to.
+  Summary summary(Stage from, Stage to) const
+  {
+    auto times = durations(from, to);
+    Summary res;
+    res.count = times.size();
+    if (times.empty()) return res;
+    std::sort(times.begin(), times.end());
+    const auto at = [&](double p) {
+      return times[static_cast<std::size_t>(p * double(times.size() - 1))];
+    };
+    res.p50 = at(0.5);
+    res.p90 = at(0.9);
+    res.p99 = at(0.99);
+    res.max = times.back();
+    return res;
+  }
+  /// Number of samples in each of the buckets of bucket_bounds
+  /// (plus one for everything above), from stage from to stage to.
+  std::array<std::size_t, bucket_bounds.size() + 1> histogram(
+    Stage from,
+    Stage to
+  ) const
+  {
+    std::array<std::size_t, bucket_bounds.size() + 1> counts {};
+    for(double ms : durations(from, to))
+    {
+      const auto it = std::lower_bound(bucket_bounds.begin(), bucket_bounds.end(), ms);
+      ++counts[std::size_t(it - bucket_bounds.begin())];
+    }
+    return counts;
+  }
+  /// Percentiles of every stage and of the total, for NVUI_LATENCY_STATS.
+  std::vector<std::pair<std::string, double>> report() const
+  {
+    std::vector<std::pair<std::string, double>> res;
+    const auto add = [&](const std::string& name, Stage from, Stage to) {
+      const auto s = summary(from, to);
+      res.emplace_back(name + "_p50_ms", s.p50);
+      res.emplace_back(name + "_p90_ms", s.p90);
+      res.emplace_back(name + "_p99_ms", s.p99);
+      res.emplace_back(name + "_max_ms", s.max);
+    };
+    for(std::uint8_t s = Write; s < num_stages; ++s)
+    {
+      add(interval_name(Stage(s - 1), Stage(s)), Stage(s - 1), Stage(s));
+    }
+    add("total", Key, Present);
+    res.emplace_back("samples", double(summary(Key, Present).count));
+    return res;
+  }
+  /// A table of the percentiles of each stage, and a histogram
+  /// of the total latency.
+  std::string format_report() const
+  {
+    std::string out = fmt::format(
+      "Key-to-photon latency of {} keys (ms)\n{:<18}{:>9}{:>9}{:>9}{:>9}\n",
+      summary(Key, Present).count, "", "p50", "p90", "p99", "max"
+    );
+    const auto row = [&](const std::string& name, Stage from, Stage to) {
+      const auto s = summary(from, to);
+      out += fmt::format(
+        "{:<18}{:>9.2f}{:>9.2f}{:>9.2f}{:>9.2f}\n",
+        name, s.p50, s.p90, s.p99, s.max
+      );
+    };
+    for(std::uint8_t s = Write; s < num_stages; ++s)
+    {
+      row(interval_name(Stage(s - 1), Stage(s)), Stage(s - 1), Stage(s));
+    }
+    row("total", Key, Present);
+    const auto counts = histogram(Key, Present);
+    const std::size_t most = *std::max_element(counts.begin(), counts.end());
+    for(std::size_t i = 0; i < counts.size(); ++i)
+    {
+      const auto label = i < bucket_bounds.size()
+        ? fmt::format("<= {}", bucket_bounds[i])
+        : fmt::format("> {}", bucket_bounds.back());
+      const std::size_t width = most ? counts[i] * 40 / most : 0;
+      out += fmt::format(
+        "{:>9} |{:<40} {}\n", label, std::string(width, '#'), counts[i]
+      );
+    }
+    return out;
+  }
+  /**
+   * The samples as a Chrome trace (chrome://tracing, Perfetto):
+   * one complete event per stage of each key, on one track per stage.
+   */
+  std::string chrome_trace() const
+  {
+    const auto all = samples();
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    const auto us = [](Clock::time_point t) {
+      return std::chrono::duration<double, std::micro>(t.time_since_epoch()).count();
+    };
+    for(std::size_t i = 0; i < all.size(); ++i)
+    {
+      const auto& sample = all[i];
+      for(std::uint8_t s = Write; s < num_stages; ++s)
+      {
+        out += fmt::format(
+          "{}{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},"
+          "\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"key\":{}}}}}",
+          first ? "" : ",", interval_name(Stage(s - 1), Stage(s)), int(s),
+          us(sample.at[s - 1]), us(sample.at[s]) - us(sample.at[s - 1]), i
+        );
+        first = false;
+      }
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return out;
+  }
+  static std::string interval_name(Stage from, Stage to)
+  {
+    return fmt::format("{}_to_{}", stage_names[from], stage_names[to]);
+  }
+private:
+  std::vector<double> durations(Stage from, Stage to) const
+  {
+    std::lock_guard lock {mutex};
+    std::vector<double> res;
+    res.reserve(done.size());
+    for(const auto& sample : done) res.push_back(sample.ms(from, to));
+    return res;
+  }
+  std::atomic<bool> on = false;
+  mutable std::mutex mutex;
+  std::deque<Sample> open;
+  std::deque<Sample> done;
+};
+
+#endif // NVUI_LATENCY_TRACE_HPP
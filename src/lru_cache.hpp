@@ -0,0 +1,248 @@
+#ifndef NVUI_LRU_CACHE_HPP
+#define NVUI_LRU_CACHE_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Default delete does nothing (variables clean up themselves)
+template<typename T>
+struct do_nothing_deleter
+{
+  void operator()(T*) const {}
+};
+
+/// Fixed-capacity LRU cache with an optional custom deleter.
+/// I use the custom deleter for IDWriteTextLayout1
+/// so they get automatically released.
+/// Once again, using Neovide's idea of caching text blobs.
+/// See
+/// https://github.com/neovide/neovide/blob/main/src/renderer/fonts/caching_shaper.rs
+///
+/// All of the entries live in a pool that's allocated up front, and are
+/// linked into the hash buckets and the recency list by index, so
+/// neither put nor get allocate. Lookups can be done with any type that
+/// Hash and KeyEqual accept (e.g. a view of the key), and with a hash
+/// that was computed beforehand.
+/// K and V must be default constructible.
+template<
+  typename K,
+  typename V,
+  typename ValueDeleter = do_nothing_deleter<V>,
+  typename Hash = std::hash<K>,
+  typename KeyEqual = std::equal_to<>
+>
+class LRUCache
+{
+  using index = std::uint32_t;
+  static constexpr index npos = std::numeric_limits<index>::max();
+  struct Node
+  {
+    K key {};
+    V value {};
+    std::size_t hash = 0;
+    index prev = npos;
+    index next = npos;
+    /// Next node in the same bucket
+    index chain = npos;
+  };
+public:
+  using key_type = K;
+  using value_type = V;
+  LRUCache(std::size_t capacity)
+    : nodes(std::max<std::size_t>(capacity, 1)),
+      buckets(bucket_count_for(nodes.size()), npos)
+  {
+    assert(nodes.size() < npos);
+  }
+  LRUCache(const LRUCache&) = delete;
+  LRUCache& operator=(const LRUCache&) = delete;
+  ~LRUCache()
+  {
+    for_each_live([](Node& n) { ValueDeleter()(std::addressof(n.value)); });
+  }
+
+  /// Insert (or replace) the value for k, evicting the least recently
+  /// used entry if the cache is full.
+  V& put(K k, V v)
+  {
+    const std::size_t h = Hash()(k);
+    return put(std::move(k), std::move(v), h);
+  }
+  /// Same as put(k, v), with hash == Hash()(k).
+  V& put(K k, V v, std::size_t hash)
+  {
+    if (index i = find(k, hash); i != npos)
+    {
+      Node& n = nodes[i];
+      ValueDeleter()(std::addressof(n.value));
+      n.value = std::move(v);
+      move_to_front(i);
+      return n.value;
+    }
+    index i;
+    if (free_nodes != npos)
+    {
+      i = free_nodes;
+      free_nodes = nodes[i].chain;
+      ++used;
+    }
+    else if (top < nodes.size())
+    {
+      i = index(top++);
+      ++used;
+    }
+    else
+    {
+      i = tail;
+      ValueDeleter()(std::addressof(nodes[i].value));
+      unlink_bucket(i);
+      unlink_list(i);
+    }
+    Node& n = nodes[i];
+    n.key = std::move(k);
+    n.value = std::move(v);
+    n.hash = hash;
+    auto& bucket = buckets[hash & (buckets.size() - 1)];
+    n.chain = bucket;
+    bucket = i;
+    push_front(i);
+    return n.value;
+  }
+
+  /// Returns the value for the key equal to q, or nullptr if there is
+  /// none. Marks the entry as the most recently used.
+  template<typename Q>
+  V* get(const Q& q)
+  {
+    return get(q, Hash()(q));
+  }
+  /// Same as get(q), with hash == Hash()(q).
+  template<typename Q>
+  V* get(const Q& q, std::size_t hash)
+  {
+    const index i = find(q, hash);
+    if (i == npos)
+    {
+      ++miss_count;
+      return nullptr;
+    }
+    ++hit_count;
+    move_to_front(i);
+    return std::addressof(nodes[i].value);
+  }
+
+  void clear()
+  {
+    for_each_live([](Node& n) {
+      ValueDeleter()(std::addressof(n.value));
+      n.key = K {};
+      n.value = V {};
+    });
+    std::fill(buckets.begin(), buckets.end(), npos);
+    head = tail = npos;
+    used = top = 0;
+    free_nodes = npos;
+  }
+  /// Remove up to n of the least recently used entries, returns
+  /// how many were removed.
+  std::size_t evict(std::size_t n)
+  {
+    std::size_t removed = 0;
+    for(; removed < n && tail != npos; ++removed)
+    {
+      const index i = tail;
+      Node& node = nodes[i];
+      ValueDeleter()(std::addressof(node.value));
+      unlink_bucket(i);
+      unlink_list(i);
+      node.key = K {};
+      node.value = V {};
+      node.chain = free_nodes;
+      free_nodes = i;
+      --used;
+    }
+    return removed;
+  }
+
+  std::size_t size() const { return used; }
+  std::size_t capacity() const { return nodes.size(); }
+  std::uint64_t hits() const { return hit_count; }
+  std::uint64_t misses() const { return miss_count; }
+  void reset_stats() { hit_count = miss_count = 0; }
+
+private:
+  static std::size_t bucket_count_for(std::size_t capacity)
+  {
+    std::size_t count = 1;
+    while(count < capacity) count <<= 1;
+    return count;
+  }
+  template<typename Q>
+  index find(const Q& q, std::size_t hash) const
+  {
+    for(index i = buckets[hash & (buckets.size() - 1)]; i != npos; i = nodes[i].chain)
+    {
+      const Node& n = nodes[i];
+      if (n.hash == hash && KeyEqual()(n.key, q)) return i;
+    }
+    return npos;
+  }
+  template<typename F>
+  void for_each_live(F&& f)
+  {
+    for(index i = head; i != npos; i = nodes[i].next) f(nodes[i]);
+  }
+  void unlink_bucket(index i)
+  {
+    index* link = &buckets[nodes[i].hash & (buckets.size() - 1)];
+    while(*link != i) link = &nodes[*link].chain;
+    *link = nodes[i].chain;
+    nodes[i].chain = npos;
+  }
+  void unlink_list(index i)
+  {
+    Node& n = nodes[i];
+    if (n.prev != npos) nodes[n.prev].next = n.next;
+    else head = n.next;
+    if (n.next != npos) nodes[n.next].prev = n.prev;
+    else tail = n.prev;
+    n.prev = n.next = npos;
+  }
+  void push_front(index i)
+  {
+    Node& n = nodes[i];
+    n.prev = npos;
+    n.next = head;
+    if (head != npos) nodes[head].prev = i;
+    head = i;
+    if (tail == npos) tail = i;
+  }
+  void move_to_front(index i)
+  {
+    if (i == head) return;
+    unlink_list(i);
+    push_front(i);
+  }
+  std::vector<Node> nodes;
+  std::vector<index> buckets;
+  /// Number of entries.
+  std::size_t used = 0;
+  /// Nodes [0, top) have been handed out, the ones that were
+  /// evicted since are in free_nodes (linked through chain).
+  std::size_t top = 0;
+  index free_nodes = npos;
+  /// Most recently used
+  index head = npos;
+  /// Least recently used
+  index tail = npos;
+  std::uint64_t hit_count = 0;
+  std::uint64_t miss_count = 0;
+};
+
+#endif // NVUI_LRU_CACHE_HPP
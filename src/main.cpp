@@ -6,6 +6,8 @@
 #include <QStyleFactory>
 #include <QStringBuilder>
 #include <charconv>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -14,6 +16,8 @@
 #include <fstream>
 #include <iostream>
 #include "nvim.hpp"
+#include "session_tabs.hpp"
+#include "single_instance.hpp"
 #include "window.hpp"
 #include <msgpack.hpp>
 #include <fmt/format.h>
@@ -109,6 +113,7 @@ bool is_executable(std::string_view path)
 
 int main(int argc, char** argv)
 {
+  const auto start_time = std::chrono::steady_clock::now();
   const auto args = get_args(argc, argv);
 #ifdef Q_OS_LINUX
   // See issue #21
@@ -173,16 +178,95 @@ int main(int argc, char** argv)
   QApplication app {argc, argv};
   try
   {
-    Nvim nvim {nvim_path, nvim_args};
+    // --server=host:port (or a socket path) attaches to a Neovim
+    // that's already running instead of starting one
+    const auto server = get_arg(args, "--server=");
+    // --single-instance hands the files to the nvui that's already
+    // running, which opens them in a new tab (so implies --tabs)
+    const auto single_arg = get_arg(args, "--single-instance");
+    const bool one_instance = single_arg && single_arg->empty();
+    if (one_instance
+      && single_instance::hand_off(single_instance::server_name(), cl_nvim_args))
+    {
+      return 0;
+    }
+    const auto tabs_arg = get_arg(args, "--tabs");
+    if (one_instance || (tabs_arg && tabs_arg->empty()))
+    {
+      // Tabs don't have a titlebar of their own, and recording and
+      // tracing follow a single session
+      for(const auto* arg : {"--titlebar", "--record=", "--trace-latency"})
+      {
+        if (get_arg(args, arg)) fmt::print("{} is ignored with --tabs\n", arg);
+      }
+      // Sessions opened later only get the files they're opened with
+      SessionTabs::Options options {nvim_path, {"--embed"}, width, height, capabilities};
+      SessionTabs tabs {std::move(options)};
+      std::unique_ptr<InstanceServer> instance_server;
+      if (one_instance)
+      {
+        const auto name = single_instance::server_name();
+        instance_server = std::make_unique<InstanceServer>(name, tabs);
+        // Another nvui started listening after the first hand_off
+        if (!instance_server->listening()
+          && single_instance::hand_off(name, cl_nvim_args))
+        {
+          return 0;
+        }
+      }
+      Window* first = tabs.add_session(std::make_unique<Nvim>(
+        server
+          ? connect_to_server(std::string(*server))
+          : spawn_nvim(nvim_path, nvim_args)
+      ));
+      first->editor().perf_stats().start_time = start_time;
+      tabs.show();
+      return app.exec();
+    }
+    Nvim nvim {
+      server
+        ? connect_to_server(std::string(*server))
+        : spawn_nvim(nvim_path, nvim_args)
+    };
+    if (auto record = get_arg(args, "--record="))
+    {
+      if (!nvim.record_output(std::string(*record)))
+      {
+        fmt::print("Could not open {} for recording\n", *record);
+      }
+    }
+    // Attach right away so that Neovim loads its config while we
+    // set up the window. What it sends in the meantime is kept
+    // until the handlers are registered.
+    nvim.defer_notifications();
+    nvim.set_var("nvui", 1);
+    nvim.attach_ui(width, height, capabilities);
     Window w(nullptr, &nvim, width, height, custom_titlebar);
+    w.editor().perf_stats().start_time = start_time;
+    // --trace-latency prints the key-to-photon latency on exit,
+    // --trace-latency=<file> also writes it as a Chrome trace
+    const auto trace_latency = get_arg(args, "--trace-latency");
+    if (trace_latency) w.editor().latency_trace().set_enabled(true);
     w.register_handlers();
+    nvim.resume_notifications();
     w.show();
-    nvim.set_var("nvui", 1);
-    nvim.attach_ui(width, height, capabilities);
     nvim.on_exit([&] {
       QMetaObject::invokeMethod(&w, &QMainWindow::close, Qt::QueuedConnection);
     });
-    return app.exec();
+    const int exit_code = app.exec();
+    if (trace_latency)
+    {
+      fmt::print("{}", w.editor().latency_trace().format_report());
+      if (trace_latency->starts_with("="))
+      {
+        const auto path = std::string(trace_latency->substr(1));
+        if (!w.write_latency_trace(path))
+        {
+          fmt::print("Could not write the latency trace to {}\n", path);
+        }
+      }
+    }
+    return exit_code;
   }
   catch (const std::exception& e)
   {
@@ -0,0 +1,83 @@
+#ifndef NVUI_MEMORY_BUDGET_HPP
+#define NVUI_MEMORY_BUDGET_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+
+/// One budget for the memory that's held for rendering
+/// (NVUI_MEMORY_BUDGET), instead of only the fixed per-grid limits.
+/// The editor reports how many bytes each pool holds after every
+/// flush, and when the total is over the budget, plan() tells it how
+/// much to free from the pools that can be freed, cheapest to
+/// rebuild first.
+class MemoryBudget
+{
+public:
+  enum Pool : std::uint8_t
+  {
+    /// Smooth scrolling snapshots, only needed while scrolling.
+    Snapshots,
+    /// Cached text layouts, the least recently used go first.
+    TextLayouts,
+    /// Paint buffers of hidden and pooled grids, which have
+    /// to be repainted when they're shown again.
+    HiddenBuffers,
+    /// Paint buffers of the grids on screen. Tracked, never freed.
+    Buffers,
+    /// The popup menu and its icons. Tracked, never freed.
+    Widgets,
+    num_pools
+  };
+  /// Pools [0, num_evictable) can be freed, in that order.
+  static constexpr std::size_t num_evictable = HiddenBuffers + 1;
+  static constexpr std::array<const char*, num_pools> pool_names {
+    "snapshot", "text_layout", "hidden_buffer", "buffer", "widget"
+  };
+  using Plan = std::array<std::size_t, num_evictable>;
+
+  /// Set the budget in bytes, 0 for no budget.
+  void set_budget(std::size_t bytes) { limit = bytes; }
+  std::size_t budget() const { return limit; }
+  void set_usage(Pool pool, std::size_t bytes) { used[pool] = bytes; }
+  std::size_t usage(Pool pool) const { return used[pool]; }
+  std::size_t total() const
+  {
+    return std::accumulate(used.begin(), used.end(), std::size_t(0));
+  }
+  bool over_budget() const { return limit && total() > limit; }
+  /**
+   * Bytes to free from each of the evictable pools so the total
+   * gets back under the budget. Frees down to a bit under the budget
+   * so that it isn't hit again on the next flush. A pool is only
+   * touched once the ones before it are empty.
+   */
+  Plan plan() const
+  {
+    Plan res {};
+    if (!over_budget()) return res;
+    std::size_t excess = total() - (limit - limit / 8);
+    for(std::size_t pool = 0; pool < num_evictable && excess; ++pool)
+    {
+      res[pool] = std::min(excess, used[pool]);
+      excess -= res[pool];
+    }
+    return res;
+  }
+  /// Record that bytes were freed from pool.
+  void evicted(Pool pool, std::size_t bytes)
+  {
+    used[pool] -= std::min(bytes, used[pool]);
+    evicted_total[pool] += bytes;
+  }
+  /// Bytes freed from pool since the start.
+  std::uint64_t evicted_bytes(Pool pool) const { return evicted_total[pool]; }
+private:
+  std::size_t limit = 0;
+  std::array<std::size_t, num_pools> used {};
+  std::array<std::uint64_t, num_pools> evicted_total {};
+};
+
+#endif // NVUI_MEMORY_BUDGET_HPP
@@ -0,0 +1,124 @@
+#ifndef NVUI_MSGPACK_SCAN_HPP
+#define NVUI_MSGPACK_SCAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Finds where a msgpack object ends without decoding it, so that a
+/// message that arrives over many reads is only decoded once, when
+/// all of it is there (see MsgpackStream::parse_next).
+/// The scan picks up where the last one stopped, each byte is only
+/// looked at once.
+class MsgpackScanner
+{
+public:
+  /**
+   * Continue scanning the object that starts at data, of which size
+   * bytes have arrived (including the ones scanned before).
+   * Returns true once all of it is there, its length is size() then.
+   * Bytes that aren't valid msgpack end the object, decoding it
+   * reports the error.
+   */
+  bool scan(const char* data, std::size_t size)
+  {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    while(!(started && remaining.empty()))
+    {
+      if (pos >= size) return false;
+      const unsigned char b = bytes[pos];
+      std::size_t header = 1;
+      std::uint64_t payload = 0;
+      std::uint64_t count = 0;
+      bool container = false;
+      const auto be = [&](std::size_t n) {
+        std::uint64_t v = 0;
+        for(std::size_t i = 1; i <= n; ++i) v = (v << 8) | bytes[pos + i];
+        return v;
+      };
+      // Length of the header and the size that follows it
+      std::size_t len_bytes = 0;
+      if (b <= 0x7f || b >= 0xe0) {}
+      else if (b <= 0x8f) { container = true; count = 2 * (b & 0x0f); }
+      else if (b <= 0x9f) { container = true; count = b & 0x0f; }
+      else if (b <= 0xbf) payload = b & 0x1f;
+      else switch(b)
+      {
+        case 0xc0: case 0xc2: case 0xc3: break;
+        case 0xc4: case 0xd9: len_bytes = 1; break;
+        case 0xc5: case 0xda: len_bytes = 2; break;
+        case 0xc6: case 0xdb: len_bytes = 4; break;
+        // ext: size, then type
+        case 0xc7: len_bytes = 1; payload = 1; break;
+        case 0xc8: len_bytes = 2; payload = 1; break;
+        case 0xc9: len_bytes = 4; payload = 1; break;
+        case 0xca: payload = 4; break;
+        case 0xcb: payload = 8; break;
+        case 0xcc: case 0xd0: payload = 1; break;
+        case 0xcd: case 0xd1: payload = 2; break;
+        case 0xce: case 0xd2: payload = 4; break;
+        case 0xcf: case 0xd3: payload = 8; break;
+        // fixext: type, then data
+        case 0xd4: payload = 2; break;
+        case 0xd5: payload = 3; break;
+        case 0xd6: payload = 5; break;
+        case 0xd7: payload = 9; break;
+        case 0xd8: payload = 17; break;
+        case 0xdc: container = true; len_bytes = 2; break;
+        case 0xdd: container = true; len_bytes = 4; break;
+        case 0xde: container = true; len_bytes = 2; break;
+        case 0xdf: container = true; len_bytes = 4; break;
+        default:
+          // 0xc1 is never used
+          ++pos;
+          remaining.clear();
+          started = true;
+          return true;
+      }
+      header += len_bytes;
+      if (pos + header > size) return false;
+      if (len_bytes)
+      {
+        const auto len = be(len_bytes);
+        if (!container) payload += len;
+        else count = (b == 0xde || b == 0xdf) ? 2 * len : len;
+      }
+      if (container)
+      {
+        pos += header;
+        started = true;
+        if (count > 0)
+        {
+          remaining.push_back(count);
+          continue;
+        }
+      }
+      else
+      {
+        if (pos + header + payload > size) return false;
+        pos += header + std::size_t(payload);
+        started = true;
+      }
+      // An element is done, and with it every container that
+      // it was the last element of
+      while(!remaining.empty() && --remaining.back() == 0) remaining.pop_back();
+    }
+    return true;
+  }
+  /// Length of the object, once scan() returned true.
+  std::size_t size() const { return pos; }
+  /// Start over, for the object after this one.
+  void reset()
+  {
+    pos = 0;
+    started = false;
+    remaining.clear();
+  }
+private:
+  std::size_t pos = 0;
+  bool started = false;
+  /// Elements left in each container that's open.
+  std::vector<std::uint64_t> remaining;
+};
+
+#endif // NVUI_MSGPACK_SCAN_HPP
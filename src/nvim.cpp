@@ -1,6 +1,5 @@
 #include <exception>
 #include <mutex>
-#define BOOST_PROCESS_WINDOWS_USE_NAMED_PIPE
 #include "nvim.hpp"
 #include <fstream>
 #include <iostream>
@@ -10,19 +9,12 @@
 #include <string>
 #include <thread>
 #include <tuple>
-#include <boost/process.hpp>
 #include <algorithm>
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <QtCore>
 #include "object.hpp"
 
-#ifdef _WIN32
-#include <boost/process/windows.hpp>
-#endif
-
-namespace bp = boost::process;
-
 // ######################## SETTING UP ####################################
 
 using Lock = std::lock_guard<std::mutex>;
@@ -38,38 +30,30 @@ using Lock = std::lock_guard<std::mutex>;
 //}
 /// Constructor
 Nvim::Nvim(std::string path, std::vector<std::string> args)
+: Nvim(spawn_nvim(std::move(path), std::move(args)))
+{
+}
+
+Nvim::Nvim(std::unique_ptr<Transport> t)
 : notification_handlers(),
   request_handlers(),
+  transport(std::move(t)),
   closed(false),
   num_responses(0),
-  current_msgid(0),
-  proc_group(),
-  stdout_pipe(),
-  stdin_pipe(),
-  error()
+  current_msgid(0)
 {
-  auto nvim_path = boost::filesystem::path(path);
-  if (path.empty())
-  {
-    nvim_path = bp::search_path("nvim");
-    if (nvim_path.empty())
-    {
-      throw std::runtime_error("Neovim not found in PATH");
+  assert(transport);
+  transport->start(
+    [this] { return read_area = stream.write_area(); },
+    [this](std::size_t n) { on_read(n); },
+    [this] {
+      // Make sure we're not adding an exit handler at the same time
+      // we're calling it
+      Lock exit_lock {exit_handler_mutex};
+      on_exit_handler();
     }
-  }
-  nvim = bp::child(
-    nvim_path,
-    args,
-    bp::std_out > stdout_pipe,
-    bp::std_in < stdin_pipe,
-    bp::std_err > error,
-    proc_group
-#ifdef _WIN32
-    , bp::windows::create_no_window
-#endif
   );
-  err_reader = std::thread(std::bind(&Nvim::read_error_sync, this));
-  out_reader = std::thread(std::bind(&Nvim::read_output_sync, this));
+  writer = std::thread(std::bind(&Nvim::write_input_sync, this));
 }
 
 //static int file_num = 0;
@@ -96,95 +80,170 @@ static const std::unordered_map<std::string, bool> default_capabilities {
   {"ext_hlstate", true}
 };
 
-// Although this is synchronous, it will be performed on another thread.
-void Nvim::read_output_sync()
+// Called on the transport's I/O thread.
+void Nvim::on_read(std::size_t n)
 {
-  constexpr int buffer_maxsize = 1024 * 1024;
-  auto buffer = std::make_unique<char[]>(buffer_maxsize);
-  char* buf = buffer.get();
-  while(!closed && running())
+  bytes_read.fetch_add(n, std::memory_order_relaxed);
+  if (recording)
+  {
+    Lock lock {record_mutex};
+    record_file.write(read_area.data(), static_cast<std::streamsize>(n));
+  }
+  stream.commit(n);
+  while(stream.pending() > 0)
   {
-    using std::size_t;
-    auto msg_size = static_cast<size_t>(stdout_pipe.read(buf, buffer_maxsize));
-    if (!msg_size) continue;
-    std::string_view sv {buf, msg_size};
-    std::size_t offset = 0;
-    while(offset < msg_size)
+    if (deferring.load(std::memory_order_acquire))
     {
-      auto parsed = Object::from_msgpack(sv, offset);
-      auto* arr = parsed.array();
-      if (!(arr && (arr->size() == 3 || arr->size() == 4))) continue;
-      const auto msg_type = arr->at(0).u64();
-      if (!msg_type) continue;
-      switch(*msg_type)
+      // Handlers may not exist yet, so everything is parsed
+      // into an Object that owns its data.
+      auto parsed = stream.next();
+      if (!parsed) break;
+      if (parsed->is_err())
       {
-        case Type::Notification:
-        {
-          assert(arr->size() == 3);
-          const auto method_str = arr->at(1).string();
-          if (!method_str) continue;
-          notification_handlers_mutex.lock();
-          const auto func_it = notification_handlers.find(*method_str);
-          if (func_it == notification_handlers.end())
-          {
-            notification_handlers_mutex.unlock();
-          }
-          else
-          {
-            const auto func = func_it->second;
-            notification_handlers_mutex.unlock();
-            func(std::move(parsed));
-          }
-          break;
-        }
-        case Type::Request:
-        {
-          assert(arr->size() == 4);
-          const auto* method_str = arr->at(2).string();
-          if (!method_str) continue;
-          request_handlers_mutex.lock();
-          const auto func_it = request_handlers.find(*method_str);
-          if (func_it == request_handlers.end())
-          {
-            request_handlers_mutex.unlock();
-          }
-          else
-          {
-            const auto func = func_it->second;
-            request_handlers_mutex.unlock();
-            func(std::move(parsed));
-          }
-          break;
-        }
-        case Type::Response:
-        {
-          assert(arr->size() == 4);
-          const auto msgid = arr->at(1).u64();
-          assert(msgid);
-          if (!msgid) continue;
-          response_cb_mutex.lock();
-          const auto cb_it = singleshot_callbacks.find(*msgid);
-          if (cb_it != singleshot_callbacks.end())
-          {
-            const auto cb = cb_it->second;
-            response_cb_mutex.unlock();
-            cb(std::move(arr->at(3)), std::move(arr->at(2)));
-          }
-          else response_cb_mutex.unlock();
-          break;
-        }
-        default:
-          qWarning() << "Received an invalid msgpack message type: " << *msg_type << '\n';
-          continue;
+        fmt::print("Could not parse message from Neovim\n");
+        continue;
+      }
+      if (!defer(*parsed)) dispatch(std::move(*parsed));
+      continue;
+    }
+    // Notifications with a borrowed handler are parsed without
+    // copying their strings out of the read buffer, and their
+    // arrays come from an arena that is freed all at once
+    msgpack_view_callback view_handler;
+    const auto method = stream.peek_notification_method();
+    if (!method.empty())
+    {
+      Lock lock {notification_handlers_mutex};
+      const auto it = borrowed_notification_handlers.find(std::string(method));
+      if (it != borrowed_notification_handlers.end()) view_handler = it->second;
+    }
+    if (view_handler)
+    {
+      auto view = stream.next_view();
+      if (!view) break;
+      if (view->obj.is_err())
+      {
+        fmt::print("Could not parse message from Neovim\n");
+        continue;
       }
+      view_handler(std::move(*view));
+      continue;
+    }
+    auto parsed = stream.next();
+    if (!parsed) break;
+    if (parsed->is_err())
+    {
+      fmt::print("Could not parse message from Neovim\n");
+      continue;
+    }
+    dispatch(std::move(*parsed));
+  }
+}
+
+void Nvim::dispatch(Object parsed)
+{
+  auto* arr = parsed.array();
+  if (!(arr && (arr->size() == 3 || arr->size() == 4))) return;
+  const auto msg_type = arr->at(0).u64();
+  if (!msg_type) return;
+  switch(*msg_type)
+  {
+    case Type::Notification:
+    {
+      assert(arr->size() == 3);
+      const auto method_str = arr->at(1).string();
+      if (!method_str) return;
+      notification_handlers_mutex.lock();
+      const auto func_it = notification_handlers.find(*method_str);
+      if (func_it == notification_handlers.end())
+      {
+        notification_handlers_mutex.unlock();
+      }
+      else
+      {
+        const auto func = func_it->second;
+        notification_handlers_mutex.unlock();
+        func(std::move(parsed));
+      }
+      break;
+    }
+    case Type::Request:
+    {
+      assert(arr->size() == 4);
+      const auto* method_str = arr->at(2).string();
+      if (!method_str) return;
+      request_handlers_mutex.lock();
+      const auto func_it = request_handlers.find(*method_str);
+      if (func_it == request_handlers.end())
+      {
+        request_handlers_mutex.unlock();
+      }
+      else
+      {
+        const auto func = func_it->second;
+        request_handlers_mutex.unlock();
+        func(std::move(parsed));
+      }
+      break;
+    }
+    case Type::Response:
+    {
+      assert(arr->size() == 4);
+      const auto msgid = arr->at(1).u64();
+      assert(msgid);
+      if (!msgid) return;
+      if (auto cb = singleshot_callbacks.take(*msgid))
+      {
+        (*cb)(std::move(arr->at(3)), std::move(arr->at(2)));
+      }
+      break;
+    }
+    default:
+      qWarning() << "Received an invalid msgpack message type: " << *msg_type << '\n';
+      return;
+  }
+}
+
+bool Nvim::defer(Object& parsed)
+{
+  auto* arr = parsed.array();
+  if (arr && arr->size() == 4 && arr->at(0).u64()
+    && *arr->at(0).u64() == Type::Response)
+  {
+    return false;
+  }
+  Lock lock {deferred_mutex};
+  // Resumed since the check
+  if (!deferring) return false;
+  deferred.push_back(std::move(parsed));
+  return true;
+}
+
+void Nvim::defer_notifications()
+{
+  deferring = true;
+}
+
+void Nvim::resume_notifications()
+{
+  Lock lock {deferred_mutex};
+  for(auto& msg : deferred)
+  {
+    auto* arr = msg.array();
+    const auto* method = arr && arr->size() == 3 ? arr->at(1).string() : nullptr;
+    msgpack_view_callback view_handler;
+    if (method)
+    {
+      Lock handlers_lock {notification_handlers_mutex};
+      const auto it = borrowed_notification_handlers.find(*method);
+      if (it != borrowed_notification_handlers.end()) view_handler = it->second;
     }
+    // An owned Object is a valid view with no storage
+    if (view_handler) view_handler(ObjectView {nullptr, std::move(msg)});
+    else dispatch(std::move(msg));
   }
-  // Exiting. When Nvim closes both the error and output pipe close,
-  // but we don't want to call the exit handler twice.
-  // Make sure we're not adding an exit handler at the same time we're
-  // calling it
-  Lock exit_lock {exit_handler_mutex};
-  on_exit_handler();
+  deferred.clear();
+  deferring = false;
 }
 
 void Nvim::attach_ui(const int rows, const int cols)
@@ -196,38 +255,85 @@ void Nvim::attach_ui(const int rows, const int cols, std::unordered_map<std::str
 {
   send_notification("nvim_ui_attach", std::make_tuple(rows, cols, std::move(capabilities)));
 }
-void Nvim::read_error_sync()
+void Nvim::write_input_sync()
 {
-  // 500KB should be enough for stderr (not receving any huge input)
-  constexpr int buffer_maxsize = 512 * 1024;
-  auto buffer = std::make_unique<char[]>(buffer_maxsize);
-  std::uint32_t bytes_read;
-  bp::pipe& err_pipe = error.pipe();
-  while(!closed && running())
+  static const std::string nvim_input = "nvim_input";
+  static const std::string nvim_input_mouse = "nvim_input_mouse";
+  const std::uint64_t msg_type = Type::Notification;
+  std::vector<WriteQueue::Item> items;
+  // Everything that was queued goes out in one write
+  std::string out;
+  BufferWriter out_writer {out};
+  while(write_queue.wait_and_take(items))
   {
-    bytes_read = err_pipe.read(buffer.get(), buffer_maxsize);
-    if (bytes_read)
+    bool has_keys = false;
+    for(auto& item : items)
     {
-      std::string s(buffer.get(), bytes_read);
-      std::cout << "Error occurred: " << s << '\n';
+      if (auto* packed = std::get_if<WriteQueue::Buffer>(&item))
+      {
+        out.append(*packed);
+        write_queue.recycle(std::move(*packed));
+      }
+      else if (auto* input = std::get_if<WriteQueue::Input>(&item))
+      {
+        has_keys = true;
+        msgpack::pack(out_writer, std::tuple {
+          msg_type, nvim_input, std::array<std::string, 1> {input->keys}
+        });
+      }
+      else if (auto* mouse = std::get_if<WriteQueue::Mouse>(&item))
+      {
+        msgpack::pack(out_writer, std::tuple {
+          msg_type, nvim_input_mouse, std::tuple {
+            mouse->button, mouse->action, mouse->modifiers,
+            mouse->grid, mouse->row, mouse->col
+          }
+        });
+      }
+    }
+    items.clear();
+    // Neovim is being closed, there's no one left to read it
+    if (closed) break;
+    try
+    {
+      transport->write(out);
+      if (has_keys)
+      {
+        Lock lock {latency_mutex};
+        if (latency_trace) latency_trace->mark(LatencyTrace::Write);
+      }
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    catch (const std::exception& e)
+    {
+      fmt::print("Exception occurred: {}\n", e.what());
+    }
+    out.clear();
   }
 }
 
+bool Nvim::record_output(const std::string& path)
+{
+  Lock lock {record_mutex};
+  record_file.open(path, std::ios::binary | std::ios::trunc);
+  recording = record_file.is_open();
+  return recording;
+}
+
+void Nvim::set_latency_trace(LatencyTrace* trace)
+{
+  Lock lock {latency_mutex};
+  latency_trace = trace;
+}
+
 int Nvim::exit_code()
 {
-  if (nvim.running())
-  {
-    return INT_MIN;
-  }
-  return nvim.exit_code();
+  return transport->exit_code();
 }
 
 
 bool Nvim::running()
 {
-  return nvim.running();
+  return transport->running();
 }
 
 void Nvim::set_notification_handler(
@@ -239,6 +345,15 @@ void Nvim::set_notification_handler(
   notification_handlers.emplace(method, handler);
 }
 
+void Nvim::set_borrowed_notification_handler(
+  const std::string& method,
+  msgpack_view_callback handler
+)
+{
+  Lock lock {notification_handlers_mutex};
+  borrowed_notification_handlers.emplace(method, handler);
+}
+
 void Nvim::set_request_handler(
   const std::string& method,
   msgpack_callback handler
@@ -282,7 +397,8 @@ void Nvim::send_input(
 
 void Nvim::send_input(std::string key)
 {
-  send_notification("nvim_input", std::array<std::string, 1> {std::move(key)});
+  // Merged with any other keys that haven't been written yet
+  write_queue.push_input(key);
 }
 
 void Nvim::on_exit(std::function<void ()> handler)
@@ -301,6 +417,11 @@ void Nvim::eval_cb(const std::string& expr, response_cb cb)
   send_request_cb("nvim_eval", std::make_tuple(expr), std::move(cb));
 }
 
+std::future<Nvim::Response> Nvim::eval_async(const std::string& expr)
+{
+  return send_request_async("nvim_eval", std::make_tuple(expr));
+}
+
 void Nvim::exec_viml(
   const std::string& str,
   bool capture_output,
@@ -317,6 +438,14 @@ void Nvim::exec_viml(
   }
 }
 
+std::future<Nvim::Response> Nvim::exec_viml_async(
+  const std::string& str,
+  bool capture_output
+)
+{
+  return send_request_async("nvim_exec", std::make_tuple(str, capture_output));
+}
+
 void Nvim::input_mouse(
   std::string button,
   std::string action,
@@ -326,9 +455,10 @@ void Nvim::input_mouse(
   int col
 )
 {
-  send_notification("nvim_input_mouse", std::tuple {
-      std::move(button), std::move(action), std::move(modifiers),
-      grid, row, col
+  // Drags that haven't been written yet only keep the latest position
+  write_queue.push_mouse({
+    std::move(button), std::move(action), std::move(modifiers),
+    grid, row, col
   });
 }
 
@@ -337,10 +467,8 @@ Nvim::~Nvim()
 {
   // Close I/O Pipes and terminate process
   closed = true;
-  nvim.terminate();
-  error.pipe().close();
-  stdout_pipe.close();
-  stdin_pipe.close();
-  out_reader.join();
-  err_reader.join();
+  write_queue.close();
+  transport->stop();
+  writer.join();
+  transport->close();
 }
@@ -1,10 +1,10 @@
 #ifndef NVUI_NVIM_HPP
 #define NVUI_NVIM_HPP
 
-#include <boost/process/pipe.hpp>
-#include <boost/process.hpp>
 #include <atomic>
+#include <fstream>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <optional>
 #include <thread>
@@ -13,7 +13,11 @@
 #include <msgpack.hpp>
 #include <atomic>
 #include <optional>
+#include "latency_trace.hpp"
 #include "object.hpp"
+#include "response_table.hpp"
+#include "transport.hpp"
+#include "write_queue.hpp"
 #include <fmt/format.h>
 #include <fmt/core.h>
 
@@ -26,20 +30,38 @@ enum Type : std::uint64_t
 enum Notifications : std::uint8_t;
 enum Request : std::uint8_t;
 using msgpack_callback = std::function<void (Object)>;
-/// The Nvim class contains an embedded Neovim instance and
-/// some useful functions to receive output and send input
-/// using the msgpack-rpc protocol.
+using msgpack_view_callback = std::function<void (ObjectView)>;
+/// Lets msgpack::pack write straight into a WriteQueue::Buffer.
+struct BufferWriter
+{
+  WriteQueue::Buffer& buf;
+  void write(const char* data, std::size_t size) { buf.append(data, size); }
+};
+/// The Nvim class contains an embedded Neovim instance (or a connection
+/// to a remote one) and some useful functions to receive output and
+/// send input using the msgpack-rpc protocol.
 class Nvim
 {
 private:
   using response_cb = std::function<void (Object, Object)>;
 public:
+  /// The result of a request, see send_request_async.
+  struct Response
+  {
+    Object result;
+    Object error;
+  };
   ~Nvim();
   /**
    * Constructs an embedded Neovim instance and establishes communication.
    * The Neovim instance is created with the command "nvim --embed".
    */
   Nvim(std::string path = "", std::vector<std::string> args = {"--embed"});
+  /**
+   * Talks to Neovim over the given transport, e.g. one returned
+   * by connect_to_server.
+   */
+  Nvim(std::unique_ptr<Transport> transport);
   /**
    * Get the exit code of the Neovim instance.
    * If Neovim is still running, the exit code that is return will be INT_MIN.
@@ -108,6 +130,19 @@ public:
     const std::string& method,
     msgpack_callback handler
   );
+  /**
+   * Same as set_notification_handler, but the strings in the
+   * message borrow from the read buffer instead of being copied
+   * (see Object::str()), and its arrays and maps are allocated from
+   * an arena (see MsgpackStream::next_view). The message stays valid
+   * for as long as the ObjectView exists.
+   * This takes priority over a regular notification handler
+   * for the same method.
+   */
+  void set_borrowed_notification_handler(
+    const std::string& method,
+    msgpack_view_callback handler
+  );
   /**
    * Sets a request handler for the given method.
    * Same as set_notification_handler, but for requests.
@@ -118,6 +153,21 @@ public:
     const std::string& method,
     msgpack_callback handler
   );
+  /**
+   * Keep notifications and requests from Neovim instead of dispatching
+   * them, until resume_notifications() is called. Responses are still
+   * dispatched.
+   * This lets the UI attach before the handlers exist (e.g. while the
+   * window is still being built), without missing any redraw events.
+   */
+  void defer_notifications();
+  /**
+   * Dispatch the messages that came in since defer_notifications(),
+   * in order, before any new ones, then go back to dispatching as
+   * they come in.
+   * The handlers are called on the calling thread.
+   */
+  void resume_notifications();
   /**
    * Runs cmd in Neovim.
    * This can be used to set autocommands, among other things.
@@ -133,8 +183,6 @@ public:
    * NOTE: For callbacks, cb is run on the Neovim thread.
    * Make sure you take precautions before handling the data on another
    * thread.
-   * Another NOTE: Do not add another request callback directly
-   * from the passed callback, otherwise a deadlock will occur.
    */
   template<typename T>
   void send_request_cb(
@@ -142,6 +190,19 @@ public:
     T&& params,
     response_cb cb
   );
+  /**
+   * Same as send_request_cb, but returns a future that is fulfilled
+   * with the response instead of calling a callback.
+   * Requests don't wait for each other, so many of them can be sent
+   * before waiting on any of the results.
+   * NOTE: Don't wait on the future from a notification/request handler,
+   * since those run on the thread that receives the response.
+   */
+  template<typename T>
+  std::future<Response> send_request_async(
+    const std::string& method,
+    T&& params
+  );
   /**
    * Resize and send a callback when a response is received.
    */
@@ -151,6 +212,10 @@ public:
    * the response/error.
    */
   void eval_cb(const std::string& expr, response_cb cb);
+  /**
+   * Evaluate the VimL expression, returning a future of the result.
+   */
+  std::future<Response> eval_async(const std::string& expr);
   /**
    * Execute a block of VimL code. If response_cb contains a callback,
    * the callback is called with the result.
@@ -162,6 +227,13 @@ public:
     bool capture_output = false,
     std::optional<response_cb> cb = std::nullopt
   );
+  /**
+   * Same as exec_viml, returning a future of the result.
+   */
+  std::future<Response> exec_viml_async(
+    const std::string& str,
+    bool capture_output = false
+  );
   /**
    * Send a mouse input event with the given parameters.
    * Corresponds directly to Neovim API's nvim_input_mouse function.
@@ -207,74 +279,115 @@ public:
   }
   template<typename T>
   void ui_set_option(const std::string& name, T&& val);
+  /**
+   * Append everything Neovim sends from now on, as is, to the file
+   * at path. A trace recorded this way can be replayed with nvui_bench.
+   * Returns false if the file couldn't be opened.
+   */
+  bool record_output(const std::string& path);
+  /**
+   * Mark LatencyTrace::Write on trace whenever keys have been
+   * written to Neovim. Set it to nullptr before trace is destroyed.
+   */
+  void set_latency_trace(LatencyTrace* trace);
+  /**
+   * Total number of bytes received from Neovim.
+   */
+  std::uint64_t bytes_received() const
+  {
+    return bytes_read.load(std::memory_order_relaxed);
+  }
 private:
   std::function<void ()> on_exit_handler = [](){};
   std::unordered_map<std::string, msgpack_callback> notification_handlers;
+  std::unordered_map<std::string, msgpack_view_callback> borrowed_notification_handlers;
   std::unordered_map<std::string, msgpack_callback> request_handlers;
-  std::unordered_map<std::uint32_t, response_cb> singleshot_callbacks;
-  std::thread err_reader;
-  std::thread out_reader;
+  ResponseTable<response_cb> singleshot_callbacks;
+  std::unique_ptr<Transport> transport;
+  /// Messages bigger than one read (e.g. a large redraw batch)
+  /// are kept in the stream until the rest of their data arrives.
+  MsgpackStream stream;
+  /// Where the transport's last read went.
+  std::span<char> read_area;
+  /// Writes everything that's sent to Neovim, so that the sending
+  /// threads (usually the GUI thread) never block on the pipe.
+  std::thread writer;
+  WriteQueue write_queue;
+  std::atomic<std::uint64_t> bytes_read = 0;
+  std::atomic<bool> deferring = false;
+  /// Protects deferred, and is held while they are dispatched so
+  /// that new messages wait for them.
+  std::mutex deferred_mutex;
+  std::vector<Object> deferred;
+  std::atomic<bool> recording = false;
+  std::mutex latency_mutex;
+  LatencyTrace* latency_trace = nullptr;
+  std::mutex record_mutex;
+  std::ofstream record_file;
   // Condition variable to check if we are closing
   std::atomic<bool> closed;
-  std::mutex input_mutex;
   std::mutex notification_handlers_mutex;
   std::mutex request_handlers_mutex;
   std::mutex exit_handler_mutex;
-  std::mutex response_cb_mutex;
   std::uint32_t num_responses;
-  std::uint32_t current_msgid;
-  boost::process::group proc_group;
-  boost::process::child nvim;
-  boost::process::pipe stdout_pipe;
-  boost::process::pipe stdin_pipe;
-  boost::process::ipstream error;
+  std::atomic<std::uint32_t> current_msgid;
   template<typename T>
   void send_request(const std::string& method, T&& params);
   template<typename T>
+  void send_request(
+    std::uint32_t msgid,
+    const std::string& method,
+    T&& params
+  );
+  template<typename T>
   void send_notification(const std::string& method, T&& params);
-  void read_output_sync();
-  void read_error_sync();
+  void on_read(std::size_t n);
+  void write_input_sync();
+  /// Pack msg into a pooled buffer and queue it for the writer.
+  template<typename T>
+  void queue_message(const T& msg);
+  /// Dispatches a message received from Neovim
+  /// to its handler.
+  void dispatch(Object msg);
+  /// Keeps parsed if messages are being deferred.
+  /// Returns false if it should be dispatched.
+  bool defer(Object& parsed);
 };
 
+template<typename T>
+void Nvim::queue_message(const T& msg)
+{
+  auto buf = write_queue.acquire();
+  BufferWriter packer {buf};
+  msgpack::pack(packer, msg);
+  write_queue.push(std::move(buf));
+}
+
 template<typename T>
 void Nvim::send_request(const std::string& method, T&& params)
 {
-  std::unique_lock<std::mutex> lock {input_mutex};
+  send_request(current_msgid++, method, std::forward<T>(params));
+}
+
+template<typename T>
+void Nvim::send_request(
+  std::uint32_t msgid,
+  const std::string& method,
+  T&& params
+)
+{
   const std::uint64_t msg_type = Type::Request;
-  msgpack::sbuffer sbuf;
-  const auto msg = std::tuple {
-    msg_type, current_msgid, method, std::forward<T>(params)
-  };
-  msgpack::pack(sbuf, msg);
-  // Potential for an exception when calling below code
-  try
-  {
-    stdin_pipe.write(sbuf.data(), static_cast<int>(sbuf.size()));
-    ++current_msgid;
-  }
-  catch (const std::exception& e)
-  {
-    fmt::print("Exception occurred: {}\n", e.what());
-  }
+  queue_message(std::tuple {
+    msg_type, msgid, method, std::forward<T>(params)
+  });
 }
 
 template<typename T>
 void Nvim::send_notification(const std::string& method, T&& params)
 {
   // Same deal as Nvim::send_request, but for a notification this time
-  std::unique_lock<std::mutex> lock {input_mutex};
   const std::uint64_t msg_type = Type::Notification;
-  msgpack::sbuffer sbuf;
-  const auto msg = std::tuple {msg_type, method, std::forward<T>(params)};
-  msgpack::pack(sbuf, msg);
-  try
-  {
-    stdin_pipe.write(sbuf.data(), static_cast<int>(sbuf.size()));
-  }
-  catch (const std::exception& e)
-  {
-    fmt::print("Exception occurred: {}\n", e.what());
-  }
+  queue_message(std::tuple {msg_type, method, std::forward<T>(params)});
 }
 
 template<typename Res, typename Err>
@@ -284,21 +397,10 @@ void Nvim::send_response(
   Err&& err
 )
 {
-  std::unique_lock<std::mutex> lock {input_mutex};
   const std::uint64_t type = Type::Response;
-  const auto msg = std::tuple {
+  queue_message(std::tuple {
     type, msgid, std::forward<Err>(err), std::forward<Res>(res)
-  };
-  msgpack::sbuffer sbuf;
-  msgpack::pack(sbuf, msg);
-  try
-  {
-    stdin_pipe.write(sbuf.data(), static_cast<int>(sbuf.size()));
-  }
-  catch(...)
-  {
-    fmt::print("Could not send response. Msgid: {}\n", msgid);
-  }
+  });
 }
 
 template<typename T>
@@ -308,9 +410,26 @@ void Nvim::send_request_cb(
   response_cb cb
 )
 {
-  std::unique_lock<std::mutex> lock {response_cb_mutex};
-  singleshot_callbacks[current_msgid] = std::move(cb);
-  send_request(method, std::forward<T>(params));
+  // Registered before sending so the response can't come in first
+  const std::uint32_t msgid = current_msgid++;
+  singleshot_callbacks.add(msgid, std::move(cb));
+  send_request(msgid, method, std::forward<T>(params));
+}
+
+template<typename T>
+std::future<Nvim::Response> Nvim::send_request_async(
+  const std::string& method,
+  T&& params
+)
+{
+  auto promise = std::make_shared<std::promise<Response>>();
+  auto future = promise->get_future();
+  send_request_cb(method, std::forward<T>(params),
+    [promise = std::move(promise)](Object res, Object err) {
+      promise->set_value({std::move(res), std::move(err)});
+    }
+  );
+  return future;
 }
 
 template<typename T>
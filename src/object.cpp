@@ -1,5 +1,7 @@
 #include "msgpack_overrides.hpp"
 #include "object.hpp"
+#include <atomic>
+#include <cstring>
 #include <iostream>
 #include <span>
 #include <sstream>
@@ -15,6 +17,7 @@ void Object::to_stream(std::stringstream& ss) const
   std::visit(overloaded {
     [&](const std::monostate&) { ss << "null"; },
     [&](const std::string& s) { ss << '"' << s << '"'; },
+    [&](const std::string_view& s) { ss << '"' << s << '"'; },
     [&](const int64_t& i) { ss << i; },
     [&](const uint64_t& u) { ss << u; },
     [&](const ObjectArray& v) {
@@ -71,19 +74,32 @@ struct MsgpackVisitor
     InsufficientBytesError,
     ParseError
   };
-  MsgpackVisitor(Object& o): result(o), stack() {}
+  MsgpackVisitor(
+    Object& o,
+    bool borrow_strings = false,
+    std::pmr::memory_resource* res = std::pmr::get_default_resource()
+  )
+  : result(o), stack(), borrow(borrow_strings), resource(res) {}
   Object& result;
   Error error = Error::None;
   bool in_map = false;
   bool map_key_ended = false;
   Object* current = nullptr;
   std::stack<Object*, std::vector<Object*>> stack;
-  const std::string* cur_key = nullptr;
+  const std::pmr::string* cur_key = nullptr;
+  /// Strings point into the parsed data instead of being copied.
+  /// Map keys are always copied.
+  bool borrow = false;
+  /// Where arrays, maps and map keys get their memory from.
+  std::pmr::memory_resource* resource;
+  /// Something was placed that holds memory of its own (not
+  /// from resource).
+  bool owns_heap = false;
 
   bool start_array(std::uint32_t len)
   {
     stack.push(current);
-    auto* obj = place(ObjectArray());
+    auto* obj = place(ObjectArray(resource));
     assert(obj);
     obj->get<ObjectArray>().reserve(len);
     current = obj;
@@ -93,7 +109,7 @@ struct MsgpackVisitor
   bool start_map(std::uint32_t len)
   {
     stack.push(current);
-    auto* obj = place(ObjectMap());
+    auto* obj = place(ObjectMap(ObjectMap::allocator_type(resource)));
     assert(obj);
     obj->get<ObjectMap>().reserve(len);
     current = obj;
@@ -150,6 +166,7 @@ struct MsgpackVisitor
   bool visit_bin(const char* v, std::uint32_t size)
   {
     place(std::string(v, size));
+    owns_heap = true;
     return true;
   }
 
@@ -157,12 +174,26 @@ struct MsgpackVisitor
   {
     std::int8_t type = static_cast<int8_t>(*v);
     place(NeovimExt {type, QByteArray(v + 1, size - 1)});
+    owns_heap = true;
     return true;
   }
 
   bool visit_str(const char* v, std::uint32_t len)
   {
-    place(std::string(v, len));
+    const bool is_key = current && current->has<ObjectMap>() && !cur_key;
+    if (is_key)
+    {
+      // Keys come from the same memory as their map
+      auto& mp = current->get<ObjectMap>();
+      auto p = mp.emplace(std::pmr::string(v, len, resource), Object());
+      cur_key = &p.first->first;
+    }
+    else if (borrow) place(std::string_view(v, len));
+    else
+    {
+      place(std::string(v, len));
+      owns_heap = true;
+    }
     return true;
   }
 
@@ -204,16 +235,8 @@ private:
     else if (current->has<ObjectMap>())
     {
       auto& mp = current->get<ObjectMap>();
-      if (!cur_key)
-      {
-        if constexpr (std::is_same_v<T, std::string>)
-        {
-          auto p = mp.emplace(std::forward<T>(arg), Object());
-          cur_key = &p.first->first;
-          return nullptr;
-        }
-      }
-      else
+      // Keys are placed by visit_str
+      if (cur_key)
       {
         assert(mp.contains(*cur_key));
         Object* o = &mp[*cur_key];
@@ -244,6 +267,193 @@ Object Object::from_msgpack(std::string_view sv, std::size_t& offset) noexcept
   }
 }
 
+MsgpackStream::MsgpackStream(std::size_t read_sz)
+: buffer(),
+  spare_buffers(),
+  read_size(read_sz)
+{
+  buffer = take_buffer(read_size);
+}
+
+MsgpackStream::Buffer MsgpackStream::take_buffer(std::size_t capacity)
+{
+  for(auto it = spare_buffers.begin(); it != spare_buffers.end(); ++it)
+  {
+    if (it->data.use_count() == 1 && it->capacity >= capacity)
+    {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      Buffer b = std::move(*it);
+      spare_buffers.erase(it);
+      return b;
+    }
+  }
+  return {std::shared_ptr<char[]>(new char[capacity]), capacity};
+}
+
+std::span<char> MsgpackStream::write_area()
+{
+  constexpr std::size_t max_spare_buffers = 4;
+  const std::size_t size = end - start;
+  const std::size_t needed = size + read_size;
+  const bool borrowed_from = buffer.data.use_count() > 1;
+  const bool oversized = size == 0 && buffer.capacity > read_size;
+  if (borrowed_from || buffer.capacity < needed || oversized)
+  {
+    // Objects may still borrow from the current buffer, so the
+    // incomplete message (if any) is copied over to a different one.
+    Buffer next_buffer = take_buffer(needed);
+    std::memcpy(next_buffer.data.get(), buffer.data.get() + start, size);
+    if (borrowed_from && buffer.capacity == read_size
+      && spare_buffers.size() < max_spare_buffers)
+    {
+      spare_buffers.push_back(std::move(buffer));
+    }
+    buffer = std::move(next_buffer);
+    start = 0;
+    end = size;
+  }
+  else if (start > 0)
+  {
+    // Only the incomplete message is moved, not the whole buffer
+    std::memmove(buffer.data.get(), buffer.data.get() + start, size);
+    start = 0;
+    end = size;
+  }
+  return {buffer.data.get() + end, read_size};
+}
+
+void MsgpackStream::commit(std::size_t n) noexcept
+{
+  assert(end + n <= buffer.capacity);
+  end += n;
+}
+
+struct MsgpackStream::ViewStorage
+{
+  static constexpr std::size_t initial_arena_size = 64 * 1024;
+  std::shared_ptr<const void> buffer;
+  std::pmr::monotonic_buffer_resource arena {initial_arena_size};
+};
+
+std::optional<Object> MsgpackStream::next(bool borrow) noexcept
+{
+  return parse_next(borrow, std::pmr::get_default_resource());
+}
+
+std::optional<ObjectView> MsgpackStream::next_view() noexcept
+{
+  constexpr std::size_t max_view_storage = 8;
+  std::shared_ptr<ViewStorage> storage;
+  for(const auto& vs : view_storage)
+  {
+    if (vs.use_count() == 1)
+    {
+      // Synchronizes with the release of the last view
+      std::atomic_thread_fence(std::memory_order_acquire);
+      storage = vs;
+      storage->arena.release();
+      break;
+    }
+  }
+  if (!storage)
+  {
+    storage = std::make_shared<ViewStorage>();
+    if (view_storage.size() < max_view_storage) view_storage.push_back(storage);
+  }
+  storage->buffer = buffer.data;
+  bool owns_heap = false;
+  auto obj = parse_next(true, &storage->arena, &owns_heap);
+  if (!obj)
+  {
+    storage->buffer.reset();
+    return std::nullopt;
+  }
+  return ObjectView {std::move(storage), std::move(*obj), !owns_heap};
+}
+
+std::optional<Object> MsgpackStream::parse_next(
+  bool borrow,
+  std::pmr::memory_resource* resource,
+  bool* owns_heap
+) noexcept
+{
+  if (start == end) return std::nullopt;
+  // Wait for the rest of the message without decoding what's there
+  if (!scanner.scan(buffer.data.get() + start, end - start)) return std::nullopt;
+  scanner.reset();
+  Object obj;
+  MsgpackVisitor v {obj, borrow, resource};
+  std::size_t offset = start;
+  msgpack::parse(buffer.data.get(), end, offset, v);
+  // Errors have messages of their own
+  if (owns_heap) *owns_heap = v.owns_heap || v.error != MsgpackVisitor::None;
+  switch(v.error)
+  {
+    case MsgpackVisitor::None:
+      start = offset;
+      return obj;
+    case MsgpackVisitor::InsufficientBytesError:
+      // Shouldn't happen, the scanner saw all of it
+      return std::nullopt;
+    default:
+      start = end = 0;
+      return Object(Error {"Parse error"});
+  }
+}
+
+std::string_view MsgpackStream::peek_notification_method() const noexcept
+{
+  // Notifications are [2, method, params], so they start with
+  // a fixarray of size 3, the positive fixint 2, then the method string.
+  const char* data = buffer.data.get() + start;
+  const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+  const std::size_t size = end - start;
+  if (size < 3 || bytes[0] != 0x93 || bytes[1] != 0x02) return {};
+  std::size_t header = 0;
+  std::size_t len = 0;
+  if ((bytes[2] & 0xe0) == 0xa0)
+  {
+    header = 3;
+    len = bytes[2] & 0x1f;
+  }
+  else if (bytes[2] == 0xd9 && size > 3)
+  {
+    header = 4;
+    len = bytes[3];
+  }
+  else return {};
+  if (size < header + len) return {};
+  return {data + header, len};
+}
+
+bool Object::make_owned()
+{
+  // Strings up to this long are stored in the string itself
+  static const std::size_t inline_capacity = std::string().capacity();
+  bool allocated = false;
+  std::vector<Object*> stack {this};
+  while(!stack.empty())
+  {
+    Object* cur = stack.back();
+    stack.pop_back();
+    if (auto* s = cur->borrowed())
+    {
+      std::string owned {*s};
+      allocated |= owned.capacity() > inline_capacity;
+      cur->v = std::move(owned);
+    }
+    else if (auto* arr = cur->array())
+    {
+      for(auto& o : *arr) stack.push_back(&o);
+    }
+    else if (auto* mp = cur->map())
+    {
+      for(auto& p : *mp) stack.push_back(&p.second);
+    }
+  }
+  return allocated;
+}
+
 Object Object::parse(const msgpack::object& obj)
 {
   Object o;
@@ -259,6 +469,13 @@ std::size_t Object::children() const noexcept
   else return 0;
 }
 
+ObjectView::~ObjectView()
+{
+  // Reusing the storage without running the destructors is fine,
+  // nothing in the tree needs them
+  if (arena_only) std::construct_at(&obj);
+}
+
 Object::~Object()
 {
   std::stack<Object*, std::vector<Object*>> stack;
@@ -5,14 +5,18 @@
 #include <span>
 #include <string>
 #include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <optional>
 #include <variant>
 #include <tuple>
+#include <vector>
 #include <QByteArray>
 #include <QString>
 #include <string_view>
 #include <boost/container/vector.hpp>
 #include <boost/container/flat_map.hpp>
+#include "msgpack_scan.hpp"
 #include "utils.hpp"
 
 struct NeovimExt
@@ -28,10 +32,19 @@ struct Error
 
 struct Object
 {
-  using Map = boost::container::flat_map<std::string, Object, std::less<>>;
-  using Array = std::vector<Object>;
+  // Arrays and maps (and map keys) can be allocated from an arena
+  // (see MsgpackStream::next_view), otherwise they use the default
+  // memory resource.
+  using Map = boost::container::flat_map<
+    std::pmr::string, Object, std::less<>,
+    std::pmr::polymorphic_allocator<std::pair<std::pmr::string, Object>>
+  >;
+  using Array = std::pmr::vector<Object>;
   using null_type = std::monostate;
   using string_type = std::string;
+  /// String that borrows from a buffer it doesn't own
+  /// (see MsgpackStream::next).
+  using view_type = std::string_view;
   using signed_type = std::int64_t;
   using unsigned_type = std::uint64_t;
   using array_type = Array;
@@ -45,6 +58,7 @@ struct Object
     signed_type,
     unsigned_type,
     string_type,
+    view_type,
     array_type,
     map_type,
     bool_type,
@@ -73,6 +87,7 @@ struct Object
   std::string to_string() const noexcept;
   auto* array() noexcept { return std::get_if<Array>(&v); }
   auto* string() noexcept { return std::get_if<string_type>(&v); }
+  auto* borrowed() noexcept { return std::get_if<view_type>(&v); }
   auto* i64() noexcept { return std::get_if<int64_t>(&v); }
   auto* u64() noexcept { return std::get_if<uint64_t>(&v); }
   auto* map() noexcept { return std::get_if<Map>(&v); }
@@ -83,6 +98,7 @@ struct Object
   // Const versions
   auto* array() const noexcept { return std::get_if<Array>(&v); }
   auto* string() const noexcept { return std::get_if<string_type>(&v); }
+  auto* borrowed() const noexcept { return std::get_if<view_type>(&v); }
   auto* i64() const noexcept { return std::get_if<int64_t>(&v); }
   auto* u64() const noexcept { return std::get_if<uint64_t>(&v); }
   auto* map() const noexcept { return std::get_if<Map>(&v); }
@@ -90,6 +106,19 @@ struct Object
   auto* f64() const noexcept { return std::get_if<double>(&v); }
   auto* ext() const noexcept { return std::get_if<NeovimExt>(&v); }
   auto* err() const noexcept { return std::get_if<Error>(&v); }
+  /// Returns a view of the string held by this Object, whether
+  /// it is owned or borrowed. Returns std::nullopt if it's not a string.
+  std::optional<std::string_view> str() const noexcept
+  {
+    if (auto* s = string()) return *s;
+    if (auto* s = borrowed()) return *s;
+    return std::nullopt;
+  }
+  /// Replaces every borrowed string in this Object (and its children)
+  /// with an owned copy, so it no longer depends on the buffer it
+  /// was parsed from. Returns whether any copy needed memory of its
+  /// own, i.e. didn't fit in the string itself.
+  bool make_owned();
   bool is_null() const noexcept { return has<null_type>(); }
   bool is_err() const noexcept { return has<err_type>(); }
   bool is_string() const noexcept { return has<string_type>(); }
@@ -144,10 +173,16 @@ struct Object
   {
     using type = std::optional<T>;
     return std::visit([](const auto& arg) -> type {
+      using arg_type = std::decay_t<decltype(arg)>;
       if constexpr(std::is_convertible_v<decltype(arg), T>)
       {
         return std::optional<T>(arg);
       }
+      else if constexpr(std::is_same_v<T, string_type>
+        && std::is_same_v<arg_type, view_type>)
+      {
+        return std::optional<T>(std::in_place, arg);
+      }
       return std::nullopt;
     }, v);
   }
@@ -204,4 +239,105 @@ private:
 using ObjectArray = Object::Array;
 using ObjectMap = Object::Map;
 
+/// An Object that may contain borrowed strings, along with the
+/// storage they point into. The storage is declared first so
+/// that it outlives the Object.
+struct ObjectView
+{
+  ObjectView() = default;
+  ObjectView(std::shared_ptr<const void> s, Object o, bool arena = false)
+    : storage(std::move(s)),
+      obj(std::move(o)),
+      arena_only(arena)
+  {
+  }
+  ObjectView(ObjectView&&) = default;
+  ObjectView& operator=(ObjectView&& other)
+  {
+    // The old tree has to go before its storage does
+    ObjectView old {std::move(*this)};
+    storage = std::move(other.storage);
+    obj = std::move(other.obj);
+    arena_only = other.arena_only;
+    return *this;
+  }
+  /// An arena_only tree isn't walked, the arena in storage
+  /// frees all of it in one step.
+  ~ObjectView();
+  std::shared_ptr<const void> storage;
+  Object obj;
+  /// Everything obj holds comes from the arena in storage (see
+  /// MsgpackStream::next_view). Whoever gives obj memory of its own
+  /// (e.g. with make_owned) has to reset this.
+  bool arena_only = false;
+};
+
+/// Reassembles Objects from a stream of msgpack data that may be
+/// split at arbitrary points, e.g. a large redraw batch that
+/// arrives over several pipe reads.
+/// Data is read into the area returned by write_area() and then
+/// committed with commit(). Complete objects are taken out with
+/// next(), while an incomplete object at the end is kept until the
+/// rest of its bytes arrive.
+class MsgpackStream
+{
+public:
+  MsgpackStream(std::size_t read_size = 1024 * 1024);
+  /// Returns the area that the next read should write to.
+  /// This is always read_size bytes long, and comes right after
+  /// any data that hasn't been consumed yet.
+  std::span<char> write_area();
+  /// Marks the first n bytes of the last write_area() as filled.
+  void commit(std::size_t n) noexcept;
+  /// Parses the next complete object.
+  /// Returns std::nullopt if more data is needed.
+  /// If the data is malformed, the buffered data is discarded
+  /// and an Error object is returned.
+  /// If borrow is true, strings in the object point into the
+  /// stream's buffer instead of being copied. Such an object stays
+  /// valid for as long as a copy of storage() (taken right after
+  /// parsing) is kept.
+  std::optional<Object> next(bool borrow = false) noexcept;
+  /// Handle that keeps the buffer currently being parsed alive.
+  std::shared_ptr<const void> storage() const noexcept { return buffer.data; }
+  /// Parses the next complete object with borrowed strings, allocating
+  /// its arrays and maps from an arena that belongs to the returned view.
+  /// The whole object is released in one step once the view goes away.
+  std::optional<ObjectView> next_view() noexcept;
+  /// If the next object looks like a notification,
+  /// returns its method name without parsing the whole object.
+  /// Returns an empty string otherwise.
+  std::string_view peek_notification_method() const noexcept;
+  /// Number of bytes that have been committed but not consumed.
+  std::size_t pending() const noexcept { return end - start; }
+private:
+  struct Buffer
+  {
+    std::shared_ptr<char[]> data;
+    std::size_t capacity = 0;
+  };
+  /// Returns a buffer of at least the given capacity that
+  /// no borrowed object points into.
+  Buffer take_buffer(std::size_t capacity);
+  struct ViewStorage;
+  Buffer buffer;
+  /// Previously used buffers, reused once nothing borrows from them.
+  std::vector<Buffer> spare_buffers;
+  /// Arenas of ObjectViews that may be reused once the views are gone.
+  std::vector<std::shared_ptr<ViewStorage>> view_storage;
+  /// owns_heap is set if the object holds memory that isn't
+  /// from resource.
+  std::optional<Object> parse_next(
+    bool borrow,
+    std::pmr::memory_resource* resource,
+    bool* owns_heap = nullptr
+  ) noexcept;
+  std::size_t start = 0;
+  std::size_t end = 0;
+  std::size_t read_size;
+  /// How much of the object at start has arrived, so that it's
+  /// only decoded once it's complete.
+  MsgpackScanner scanner;
+};
+
 #endif // NVUI_OBJECT_HPP
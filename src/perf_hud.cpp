@@ -0,0 +1,66 @@
+#include "perf_hud.hpp"
+#include "editor.hpp"
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QPainter>
+#include <algorithm>
+
+static constexpr int padding = 6;
+
+PerfHud::PerfHud(EditorArea* parent)
+  : QWidget(parent),
+    editor_area(parent)
+{
+  setAttribute(Qt::WA_TransparentForMouseEvents);
+  setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  refresh_timer.setInterval(refresh_interval_ms);
+  QObject::connect(&refresh_timer, &QTimer::timeout, this, &PerfHud::refresh);
+}
+
+void PerfHud::refresh()
+{
+  if (editor_area->suspended()) return;
+  lines.clear();
+  for(const auto& [name, value] : editor_area->perf_report())
+  {
+    lines.append(QString("%1: %2").arg(
+      QString::fromStdString(name).leftJustified(22),
+      QString::number(value, 'f', 2)
+    ));
+  }
+  QFontMetrics metrics {font()};
+  int width = 0;
+  for(const auto& line : lines) width = std::max(width, metrics.horizontalAdvance(line));
+  resize(width + padding * 2, metrics.height() * lines.size() + padding * 2);
+  move(editor_area->width() - this->width(), 0);
+  raise();
+  update();
+}
+
+void PerfHud::paintEvent(QPaintEvent* event)
+{
+  Q_UNUSED(event);
+  QPainter p(this);
+  p.fillRect(rect(), QColor(0, 0, 0, 180));
+  p.setPen(Qt::white);
+  QFontMetrics metrics {font()};
+  int y = padding + metrics.ascent();
+  for(const auto& line : lines)
+  {
+    p.drawText(padding, y, line);
+    y += metrics.height();
+  }
+}
+
+void PerfHud::showEvent(QShowEvent* event)
+{
+  Q_UNUSED(event);
+  refresh();
+  refresh_timer.start();
+}
+
+void PerfHud::hideEvent(QHideEvent* event)
+{
+  Q_UNUSED(event);
+  refresh_timer.stop();
+}
@@ -0,0 +1,32 @@
+#ifndef NVUI_PERF_HUD_HPP
+#define NVUI_PERF_HUD_HPP
+
+#include <QPaintEvent>
+#include <QStringList>
+#include <QTimer>
+#include <QWidget>
+
+class EditorArea;
+
+/// Overlay in the top-right corner of the editor area showing
+/// its performance counters (see EditorArea::perf_report).
+/// Toggled with NVUI_PERF_HUD.
+class PerfHud : public QWidget
+{
+  Q_OBJECT
+public:
+  PerfHud(EditorArea* parent);
+  /// How often the counters are refreshed while the HUD is visible.
+  static constexpr int refresh_interval_ms = 500;
+protected:
+  void paintEvent(QPaintEvent* event) override;
+  void showEvent(QShowEvent* event) override;
+  void hideEvent(QHideEvent* event) override;
+private:
+  void refresh();
+  EditorArea* editor_area;
+  QTimer refresh_timer;
+  QStringList lines;
+};
+
+#endif // NVUI_PERF_HUD_HPP
@@ -0,0 +1,118 @@
+#ifndef NVUI_PERF_STATS_HPP
+#define NVUI_PERF_STATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/// Counters for the performance HUD (NVUI_PERF_HUD) and the
+/// NVUI_PERF_STATS request, to tell whether decoding, rasterization
+/// or compositing is what's slow.
+/// The atomic counters may be bumped from any thread, the rest is
+/// only used on the GUI thread.
+class PerfStats
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  /// Number of frame times kept for the averages.
+  static constexpr std::size_t frame_window = 128;
+  std::atomic<std::uint64_t> redraw_batches {0};
+  std::atomic<std::uint64_t> redraw_events {0};
+  /// Redraw batches waiting between the reader thread and the GUI thread,
+  /// as of the last drain.
+  std::atomic<std::size_t> queue_depth {0};
+
+  struct Rates
+  {
+    double batches = 0.;
+    double events = 0.;
+    double bytes = 0.;
+  };
+
+  /// When nvui was started, main() sets this as early as it can.
+  Clock::time_point start_time = Clock::now();
+  /// Neovim has sent a flush, so the next frame shows its content.
+  void content_flushed() { has_content = true; }
+  /// Call after painting a frame. The first one that has content
+  /// sets the time to first frame.
+  void frame_painted(Clock::time_point now)
+  {
+    if (!has_content || first_frame) return;
+    first_frame = std::chrono::duration<double, std::milli>(now - start_time).count();
+  }
+  /// Milliseconds from start_time to the first frame with Neovim's
+  /// content, 0 if there hasn't been one yet.
+  double first_frame_time() const { return first_frame; }
+  /// Record how long a frame took to paint.
+  void add_frame(double ms)
+  {
+    frame_times[frame_count % frame_window] = ms;
+    ++frame_count;
+  }
+  std::uint64_t frames() const { return frame_count; }
+  double frame_time_avg() const
+  {
+    const auto n = frames_in_window();
+    if (n == 0) return 0.;
+    double total = 0.;
+    for(std::size_t i = 0; i < n; ++i) total += frame_times[i];
+    return total / double(n);
+  }
+  double frame_time_max() const
+  {
+    const auto n = frames_in_window();
+    if (n == 0) return 0.;
+    return *std::max_element(frame_times.begin(), frame_times.begin() + n);
+  }
+  /// Frame time that p (0 to 1) of the recent frames were faster than.
+  double frame_time_percentile(double p) const
+  {
+    const auto n = frames_in_window();
+    if (n == 0) return 0.;
+    auto sorted = frame_times;
+    std::sort(sorted.begin(), sorted.begin() + n);
+    return sorted[static_cast<std::size_t>(p * double(n - 1))];
+  }
+  /// Per-second rates since the last call (or since the first call
+  /// to this function). now is in seconds, bytes is the total number
+  /// of bytes decoded so far.
+  Rates update_rates(double now, std::uint64_t bytes)
+  {
+    const auto batches = redraw_batches.load(std::memory_order_relaxed);
+    const auto events = redraw_events.load(std::memory_order_relaxed);
+    const double dt = now - last_sample.time;
+    if (last_sample.time >= 0. && dt > 0.)
+    {
+      last_rates = {
+        double(batches - last_sample.batches) / dt,
+        double(events - last_sample.events) / dt,
+        double(bytes - last_sample.bytes) / dt
+      };
+    }
+    last_sample = {now, batches, events, bytes};
+    return last_rates;
+  }
+private:
+  std::size_t frames_in_window() const
+  {
+    return std::min<std::uint64_t>(frame_count, frame_window);
+  }
+  struct Sample
+  {
+    double time = -1.;
+    std::uint64_t batches = 0;
+    std::uint64_t events = 0;
+    std::uint64_t bytes = 0;
+  };
+  std::array<double, frame_window> frame_times {};
+  std::uint64_t frame_count = 0;
+  Sample last_sample;
+  Rates last_rates;
+  bool has_content = false;
+  double first_frame = 0.;
+};
+
+#endif // NVUI_PERF_STATS_HPP
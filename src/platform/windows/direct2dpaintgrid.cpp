@@ -1,17 +1,14 @@
 #include "wineditor.hpp"
 #include "direct2dpaintgrid.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <d2d1.h>
 
 void D2DPaintGrid::set_size(u16 w, u16 h)
 {
   GridBase::set_size(w, h);
   update_bitmap_size();
-  for(auto& snapshot : snapshots)
-  {
-    SafeRelease(&snapshot.image);
-  }
-  snapshots.clear();
+  ring.clear(); // Outdated
 }
 
 void D2DPaintGrid::update_bitmap_size()
@@ -19,11 +16,50 @@ void D2DPaintGrid::update_bitmap_size()
   auto&& [font_width, font_height] = editor_area->font_dimensions();
   u32 width = std::ceil(cols * font_width);
   u32 height = std::ceil(rows * font_height);
-  editor_area->resize_bitmap(context, &bitmap, width, height);
+  // Reused grids often come back at the size they had
+  const bool same_size = bitmap
+    && bitmap->GetPixelSize().width == width
+    && bitmap->GetPixelSize().height == height;
+  if (!same_size) editor_area->resize_bitmap(context, &bitmap, width, height);
   context->SetTarget(bitmap);
   context->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_CLEARTYPE);
 }
 
+void D2DPaintGrid::retire()
+{
+  editor_area->frame_scheduler().stop_animation(&move_animation_time);
+  editor_area->frame_scheduler().stop_animation(&scroll_animation_time);
+  GridBase::retire();
+}
+
+void D2DPaintGrid::reuse(u16 new_x, u16 new_y, u16 w, u16 h, u16 new_id)
+{
+  move_animation_time = -1.f;
+  is_scrolling = false;
+  start_scroll_y = current_scroll_y = dest_scroll_y = 0.f;
+  cur_left = cur_top = 0.f;
+  old_move_x = old_move_y = dest_move_x = dest_move_y = 0.f;
+  ring.clear();
+  GridBase::reuse(new_x, new_y, w, h, new_id);
+  update_position(x, y);
+}
+
+std::size_t D2DPaintGrid::drop_snapshots()
+{
+  if (is_scrolling || !scrollback) return 0;
+  const std::size_t freed = snapshot_memory();
+  SafeRelease(&scrollback);
+  ring.clear();
+  return freed;
+}
+
+std::size_t D2DPaintGrid::trim_text_cache(std::size_t bytes)
+{
+  const std::size_t entries =
+    (bytes + text_cache_entry_bytes - 1) / text_cache_entry_bytes;
+  return layout_cache.evict(entries) * text_cache_entry_bytes;
+}
+
 void D2DPaintGrid::initialize_context()
 {
   editor_area->create_context(&context, &bitmap, 0, 0);
@@ -38,56 +74,43 @@ void D2DPaintGrid::initialize_cache()
   });
 }
 
-void D2DPaintGrid::initialize_move_animation()
+bool D2DPaintGrid::step_move_animation(float dt)
 {
-  move_update_timer.callOnTimeout([this] {
-    auto ms_interval = move_update_timer.interval();
-    move_animation_time -= float(ms_interval) / 1000.f;
-    if (move_animation_time <= 0)
-    {
-      move_update_timer.stop();
-      update_position(dest_move_x, dest_move_y);
-    }
-    else
-    {
-      auto x_diff = dest_move_x - old_move_x;
-      auto y_diff = dest_move_y - old_move_y;
-      auto duration = editor_area->move_animation_duration();
-      // What % of the animation is left (between 0 and 1)
-      auto animation_left = move_animation_time / duration;
-      float animation_finished = 1.0f - animation_left;
-      float scale = move_scaler(animation_finished);
-      cur_left = old_move_x + (float(x_diff) * scale);
-      cur_top = old_move_y + (float(y_diff) * scale);
-      update_position(cur_left, cur_top);
-    }
-    editor_area->update();
-  });
+  move_animation_time -= dt;
+  if (move_animation_time <= 0)
+  {
+    update_position(dest_move_x, dest_move_y);
+    return false;
+  }
+  auto x_diff = dest_move_x - old_move_x;
+  auto y_diff = dest_move_y - old_move_y;
+  auto duration = editor_area->move_animation_duration();
+  // What % of the animation is left (between 0 and 1)
+  auto animation_left = move_animation_time / duration;
+  float animation_finished = 1.0f - animation_left;
+  float scale = move_scaler(animation_finished);
+  cur_left = old_move_x + (float(x_diff) * scale);
+  cur_top = old_move_y + (float(y_diff) * scale);
+  update_position(cur_left, cur_top);
+  return true;
 }
 
-void D2DPaintGrid::initialize_scroll_animation()
+bool D2DPaintGrid::step_scroll_animation(float dt)
 {
-  scroll_animation_timer.callOnTimeout([this] {
-    auto timer_interval = scroll_animation_timer.interval();
-    scroll_animation_time -= float(timer_interval) / 1000.f;
-    if (scroll_animation_time <= 0.f)
-    {
-      scroll_animation_timer.stop();
-      is_scrolling = false;
-      for(auto& snapshot : snapshots) SafeRelease(&snapshot.image);
-      snapshots.clear();
-    }
-    else
-    {
-      auto diff = dest_scroll_y - start_scroll_y;
-      auto duration = editor_area->scroll_animation_duration();
-      auto animation_left = scroll_animation_time / duration;
-      float animation_finished = 1.0f - animation_left;
-      float scaled = scroll_scaler(animation_finished);
-      current_scroll_y = start_scroll_y + (diff * scaled);
-    }
-    editor_area->update();
-  });
+  scroll_animation_time -= dt;
+  if (scroll_animation_time <= 0.f)
+  {
+    is_scrolling = false;
+    ring.clear();
+    return false;
+  }
+  auto diff = dest_scroll_y - start_scroll_y;
+  auto duration = editor_area->scroll_animation_duration();
+  auto animation_left = scroll_animation_time / duration;
+  float animation_finished = 1.0f - animation_left;
+  float scaled = scroll_scaler(animation_finished);
+  current_scroll_y = start_scroll_y + (diff * scaled);
+  return true;
 }
 
 void D2DPaintGrid::process_events()
@@ -111,21 +134,65 @@ void D2DPaintGrid::process_events()
         context->FillRectangle(r, bg_brush);
         break;
       }
+      // Events can overlap each other and the dirty rows, so each
+      // one is flushed on its own
       case PaintKind::Redraw:
-        draw(context, {0, 0, cols, rows}, fg_brush, bg_brush);
+        draw({0, 0, cols, rows});
+        flush_batch(context, fg_brush);
         clear_event_queue();
         break;
       case PaintKind::Draw:
-        draw(context, evt.rect, fg_brush, bg_brush);
+        draw(evt.rect);
+        flush_batch(context, fg_brush);
+        break;
+      case PaintKind::Scroll:
+        context->EndDraw();
+        scroll_pixels(evt.rect, evt.rows);
+        context->BeginDraw();
         break;
     }
     if (!evt_q.empty()) evt_q.pop();
   }
+  // The dirty rows don't overlap, so they all go in one batch
+  take_dirty([&](QRect r) { draw(r); });
+  flush_batch(context, fg_brush);
   SafeRelease(&fg_brush);
   SafeRelease(&bg_brush);
   context->EndDraw();
 }
 
+void D2DPaintGrid::scroll_pixels(QRect r, int rows)
+{
+  const auto [font_width, font_height] = editor_area->font_dimensions();
+  const auto sz = bitmap->GetPixelSize();
+  if (!scroll_buffer || scroll_buffer->GetPixelSize().width != sz.width
+      || scroll_buffer->GetPixelSize().height != sz.height)
+  {
+    editor_area->resize_bitmap(context, &scroll_buffer, sz.width, sz.height);
+  }
+  // Rows that keep their contents
+  const int count = r.height() - std::abs(rows);
+  if (count <= 0) return;
+  const int src_row = rows > 0 ? r.top() + rows : r.top();
+  const int dst_row = src_row - rows;
+  const auto left = static_cast<UINT32>(std::round(r.left() * font_width));
+  const auto right = std::min(
+    static_cast<UINT32>(std::round((r.left() + r.width()) * font_width)), sz.width
+  );
+  const auto src_top = static_cast<UINT32>(std::round(src_row * font_height));
+  const auto src_bot = std::min(
+    static_cast<UINT32>(std::round((src_row + count) * font_height)), sz.height
+  );
+  const auto dst_top = static_cast<UINT32>(std::round(dst_row * font_height));
+  if (left >= right || src_top >= src_bot) return;
+  const auto src_rect = D2D1::RectU(left, src_top, right, src_bot);
+  const auto origin = D2D1::Point2U(0, 0);
+  scroll_buffer->CopyFromBitmap(&origin, bitmap, &src_rect);
+  const auto copied = D2D1::RectU(0, 0, right - left, src_bot - src_top);
+  const auto dst = D2D1::Point2U(left, dst_top);
+  bitmap->CopyFromBitmap(&dst, scroll_buffer, &copied);
+}
+
 static void draw_text_decorations(
   ID2D1RenderTarget* context,
   const FontOpts fo,
@@ -136,7 +203,7 @@ static void draw_text_decorations(
   ID2D1SolidColorBrush& brush
 )
 {
-  using d2pt = D2DPaintGrid::d2pt;
+  Q_UNUSED(font_width);
   switch(fo)
   {
     case FontOpts::Underline:
@@ -159,27 +226,134 @@ static void draw_text_decorations(
       );
       break;
     }
-    case FontOpts::Undercurl:
-    {
-      float line_thickness = 1.0f;
-      float line_height = std::min(font_height / 5.0f, 3.0f);
-      const double inc = font_width / 2.f;
-      d2pt prev_pos = {seq_start.x, seq_end.y - line_height};
-      bool top = false;
-      for(float x = seq_start.x + inc;; x += inc)
-      {
-        d2pt cur_pos = {std::min(x, seq_end.x), seq_end.y - (line_height * top)};
-        context->DrawLine(prev_pos, cur_pos, &brush, line_thickness);
-        prev_pos = cur_pos;
-        top = !top;
-        if (x >= seq_end.x) break;
-      }
-      break;
-    }
+    // Tiled, see D2DPaintGrid::draw_undercurl
     default: break;
   }
 }
 
+IDWriteTextLayout1* D2DPaintGrid::text_layout(
+  const QString& text,
+  const FontOptions font_opts,
+  float width,
+  float height,
+  IDWriteTextFormat* text_format
+)
+{
+  const TextCacheKeyView key {text, font_opts};
+  const auto hash = TextCacheHash()(key);
+  if (auto objptr = layout_cache.get(key, hash)) return *objptr;
+  IDWriteTextLayout* old_text_layout = nullptr;
+  IDWriteTextLayout1* text_layout = nullptr;
+  HRESULT hr;
+  auto* factory = editor_area->dwrite_factory();
+  hr = factory->CreateTextLayout(
+    (LPCWSTR) text.utf16(),
+    text.size(),
+    text_format,
+    // Sometimes the text clips weirdly & adding
+    // to the width solves it. It's probably because
+    // the text is just a little wider than the max width we set
+    // so we increase the max width by a little here.
+    width + 1000.f,
+    height,
+    &old_text_layout
+  );
+  if (FAILED(hr)) return nullptr;
+  // IDWriteTextLayout1 can set char spacing
+  hr = old_text_layout->QueryInterface(&text_layout);
+  SafeRelease(&old_text_layout);
+  if (FAILED(hr)) return nullptr;
+  DWRITE_TEXT_RANGE text_range {0, (UINT32) text.size()};
+  auto charspace = editor_area->charspacing();
+  if (charspace)
+  {
+    text_layout->SetCharacterSpacing(0, float(charspace), 0, text_range);
+  }
+  if (font_opts & FontOpts::Italic)
+  {
+    text_layout->SetFontStyle(DWRITE_FONT_STYLE_ITALIC, text_range);
+  }
+  if (font_opts & FontOpts::Bold)
+  {
+    text_layout->SetFontWeight(DWRITE_FONT_WEIGHT_BOLD, text_range);
+  }
+  layout_cache.put({QString(text.constData(), text.size()), font_opts}, text_layout, hash);
+  return text_layout;
+}
+
+static bool has_decorations(FontOptions font_opts)
+{
+  return font_opts & (FontOpts::Underline | FontOpts::Undercurl | FontOpts::Strikethrough);
+}
+
+static void draw_decorations(
+  ID2D1RenderTarget* target,
+  const FontOptions font_opts,
+  D2D1_POINT_2F top_left,
+  D2D1_POINT_2F bot_right,
+  float font_width,
+  float font_height,
+  ID2D1SolidColorBrush& brush
+)
+{
+  const auto draw_path = [&](const FontOpts fo) {
+    draw_text_decorations(
+      target, fo, top_left, bot_right, font_width, font_height, brush
+    );
+  };
+  if (font_opts & FontOpts::Underline) draw_path(FontOpts::Underline);
+  if (font_opts & FontOpts::Strikethrough) draw_path(FontOpts::Strikethrough);
+}
+
+void D2DPaintGrid::draw_undercurl(
+  ID2D1RenderTarget* target,
+  D2D1_POINT_2F start,
+  D2D1_POINT_2F end,
+  const Color& color
+)
+{
+  auto&& [font_width, font_height] = editor_area->font_dimensions();
+  const auto wave = decoration::undercurl(font_width, font_height);
+  const auto key = decoration::key_of(wave, color.to_uint32());
+  ID2D1BitmapBrush* tile = nullptr;
+  if (auto cached = undercurl_tiles.get(key)) tile = *cached;
+  else
+  {
+    const auto pixels = decoration::pixels(wave, color.to_uint32());
+    float dpi_x, dpi_y;
+    target->GetDpi(&dpi_x, &dpi_y);
+    const auto props = D2D1::BitmapProperties(
+      D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED),
+      dpi_x, dpi_y
+    );
+    ID2D1Bitmap* tile_bitmap = nullptr;
+    HRESULT hr = target->CreateBitmap(
+      D2D1::SizeU(wave.period, wave.height),
+      pixels.data(),
+      UINT32(wave.period * sizeof(decoration::u32)),
+      props,
+      &tile_bitmap
+    );
+    if (FAILED(hr)) return;
+    hr = target->CreateBitmapBrush(
+      tile_bitmap,
+      D2D1::BitmapBrushProperties(
+        D2D1_EXTEND_MODE_WRAP,
+        D2D1_EXTEND_MODE_CLAMP,
+        D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR
+      ),
+      &tile
+    );
+    SafeRelease(&tile_bitmap);
+    if (FAILED(hr)) return;
+    undercurl_tiles.put(key, tile);
+  }
+  const float top = end.y - float(wave.height);
+  // Every run starts at the top of the wave
+  tile->SetTransform(D2D1::Matrix3x2F::Translation(start.x, top));
+  target->FillRectangle({start.x, top, end.x, end.y}, tile);
+}
+
 void D2DPaintGrid::draw_text(
   ID2D1RenderTarget& target,
   const QString& text,
@@ -195,6 +369,11 @@ void D2DPaintGrid::draw_text(
   bool clip
 )
 {
+  auto* layout = text_layout(
+    text, font_opts, bot_right.x - top_left.x, bot_right.y - top_left.y,
+    text_format
+  );
+  if (!layout) return;
   if (clip)
   {
     target.PushAxisAlignedClip({
@@ -202,66 +381,22 @@ void D2DPaintGrid::draw_text(
     }, D2D1_ANTIALIAS_MODE_ALIASED);
   }
   fg_brush.SetColor(d2color(fg.to_uint32()));
-  using key_type = decltype(layout_cache)::key_type;
-  IDWriteTextLayout* old_text_layout = nullptr;
-  IDWriteTextLayout1* text_layout = nullptr;
-  key_type key = {text, font_opts};
-  auto objptr = layout_cache.get(key);
-  if (objptr) text_layout = *objptr;
-  else
-  {
-    HRESULT hr;
-    auto* factory = editor_area->dwrite_factory();
-    hr = factory->CreateTextLayout(
-      (LPCWSTR) text.utf16(),
-      text.size(),
-      text_format,
-      // Sometimes the text clips weirdly & adding
-      // to the width solves it. It's probably because
-      // the text is just a little wider than the max width we set
-      // so we increase the max width by a little here.
-      bot_right.x - top_left.x + 1000.f,
-      bot_right.y - top_left.y,
-      &old_text_layout
-    );
-    if (FAILED(hr)) return;
-    // IDWriteTextLayout1 can set char spacing
-    hr = old_text_layout->QueryInterface(&text_layout);
-    if (FAILED(hr)) { SafeRelease(&old_text_layout); return; }
-    DWRITE_TEXT_RANGE text_range {0, (UINT32) text.size()};
-    auto charspace = editor_area->charspacing();
-    if (charspace)
-    {
-      text_layout->SetCharacterSpacing(0, float(charspace), 0, text_range);
-    }
-    if (font_opts & FontOpts::Italic)
-    {
-      text_layout->SetFontStyle(DWRITE_FONT_STYLE_ITALIC, text_range);
-    }
-    if (font_opts & FontOpts::Bold)
-    {
-      text_layout->SetFontWeight(DWRITE_FONT_WEIGHT_BOLD, text_range);
-    }
-    layout_cache.put(key, text_layout);
-  }
   auto offset = float(editor_area->linespacing()) / 2.f;
   D2D1_POINT_2F text_pt = {top_left.x, top_left.y + offset};
   target.DrawTextLayout(
     text_pt,
-    text_layout,
+    layout,
     &fg_brush,
     D2D1_DRAW_TEXT_OPTIONS_ENABLE_COLOR_FONT
   );
   fg_brush.SetColor(D2D1::ColorF(sp.to_uint32()));
-  SafeRelease(&old_text_layout);
-  const auto draw_path = [&](const FontOpts fo) {
-    draw_text_decorations(
-      context, fo, top_left, bot_right, font_width, font_height, fg_brush
-    );
-  };
-  if (font_opts & FontOpts::Underline) draw_path(FontOpts::Underline);
-  if (font_opts & FontOpts::Undercurl) draw_path(FontOpts::Undercurl);
-  if (font_opts & FontOpts::Strikethrough) draw_path(FontOpts::Strikethrough);
+  draw_decorations(
+    &target, font_opts, top_left, bot_right, font_width, font_height, fg_brush
+  );
+  if (font_opts & FontOpts::Undercurl)
+  {
+    draw_undercurl(&target, top_left, bot_right, sp);
+  }
   if (clip) target.PopAxisAlignedClip();
 }
 
@@ -287,35 +422,87 @@ void D2DPaintGrid::draw_bg(
   draw_bg(target, bg, {rect.left, rect.top}, {rect.right, rect.bottom}, brush);
 }
 
-void D2DPaintGrid::draw_text_and_bg(
-  ID2D1RenderTarget* context,
+void D2DPaintGrid::batch_text_and_bg(
   const QString& buf,
-  const HLAttr& attr,
-  const HLAttr& fallback,
+  const ResolvedHL& hl,
   D2D1_POINT_2F start,
   D2D1_POINT_2F end,
-  float font_width,
-  float font_height,
-  IDWriteTextFormat* text_format,
-  ID2D1SolidColorBrush* fg_brush,
-  ID2D1SolidColorBrush* bg_brush
+  IDWriteTextFormat* text_format
 )
 {
-  auto [fg, bg, sp] = attr.fg_bg_sp(fallback);
-  auto bg_tl = D2D1::Point2F(std::floor(start.x), start.y);
-  draw_bg(*context, bg, bg_tl, end, *bg_brush);
-  draw_text(
-    *context, buf, fg, sp, attr.font_opts, start, end,
-    font_width, font_height, *fg_brush, text_format
-  );
+  fills.add(hl.bg.to_uint32(), {std::floor(start.x), start.y, end.x, end.y});
+  // Nothing would be drawn
+  const bool blank = std::all_of(buf.begin(), buf.end(), [](QChar c) {
+    return c == ' ';
+  });
+  if (blank && !has_decorations(hl.font_opts)) return;
+  text_runs.push_back({
+    buf, hl.fg, hl.sp, hl.font_opts, start, end, text_format
+  });
 }
 
-void D2DPaintGrid::draw(
-  ID2D1RenderTarget* context,
-  QRect r,
-  ID2D1SolidColorBrush* fg_brush,
-  ID2D1SolidColorBrush* bg_brush
+void D2DPaintGrid::flush_batch(
+  ID2D1RenderTarget* target,
+  ID2D1SolidColorBrush* brush
 )
+{
+  fills.flush(
+    [&](u32 color) { brush->SetColor(d2color(color)); },
+    [&](FillBatch::Rect r) {
+      target->FillRectangle({r.left, r.top, r.right, r.bottom}, brush);
+    }
+  );
+  if (text_runs.empty()) return;
+  const auto font_dims = editor_area->font_dimensions();
+  const float font_width = font_dims.width;
+  const float font_height = font_dims.height;
+  const float offset = float(editor_area->linespacing()) / 2.f;
+  const auto by_color = [&](auto color_of, auto draw_run) {
+    std::stable_sort(text_runs.begin(), text_runs.end(), [&](const auto& a, const auto& b) {
+      return color_of(a).to_uint32() < color_of(b).to_uint32();
+    });
+    for(std::size_t i = 0; i < text_runs.size(); ++i)
+    {
+      const auto color = color_of(text_runs[i]).to_uint32();
+      if (i == 0 || color != color_of(text_runs[i - 1]).to_uint32())
+      {
+        brush->SetColor(d2color(color));
+      }
+      draw_run(text_runs[i]);
+    }
+  };
+  by_color([](const TextRun& run) { return run.fg; }, [&](const TextRun& run) {
+    auto* layout = text_layout(
+      run.text, run.font_opts, run.end.x - run.start.x, run.end.y - run.start.y,
+      run.text_format
+    );
+    if (!layout) return;
+    target->DrawTextLayout(
+      {run.start.x, run.start.y + offset},
+      layout,
+      brush,
+      D2D1_DRAW_TEXT_OPTIONS_ENABLE_COLOR_FONT
+    );
+  });
+  const bool decorated = std::any_of(text_runs.begin(), text_runs.end(), [](const auto& run) {
+    return has_decorations(run.font_opts);
+  });
+  if (decorated)
+  {
+    by_color([](const TextRun& run) { return run.sp; }, [&](const TextRun& run) {
+      draw_decorations(
+        target, run.font_opts, run.start, run.end, font_width, font_height, *brush
+      );
+      if (run.font_opts & FontOpts::Undercurl)
+      {
+        draw_undercurl(target, run.start, run.end, run.sp);
+      }
+    });
+  }
+  text_runs.clear();
+}
+
+void D2DPaintGrid::draw(QRect r)
 {
   auto target_size = context->GetSize();
   const auto& fonts = editor_area->fallback_list();
@@ -327,21 +514,17 @@ void D2DPaintGrid::draw(
   const HLState* s = editor_area->hl_state();
   QString buffer;
   buffer.reserve(100);
-  const auto& def_clrs = s->default_colors_get();
   u32 cur_font_idx = 0;
   const auto get_pos = [&](int x, int y, int num_chars) {
     d2pt tl = {x * font_width, y * font_height};
     d2pt br = {(x + num_chars) * font_width, (y + 1) * font_height};
     return std::pair {tl, br};
   };
-  const auto draw_buf = [&](const HLAttr& main, d2pt start, d2pt end) {
+  const auto draw_buf = [&](const ResolvedHL& main, d2pt start, d2pt end) {
     if (buffer.isEmpty()) return;
     const auto& tf = fonts[cur_font_idx];
     reverse_qstring(buffer);
-    draw_text_and_bg(
-      context, buffer, main, def_clrs, start, end, font_width, font_height,
-      tf, fg_brush, bg_brush
-    );
+    batch_text_and_bg(buffer, main, start, end, tf);
     buffer.resize(0);
   };
   for(int y = start_y; y <= end_y && y < rows; ++y)
@@ -356,49 +539,49 @@ void D2DPaintGrid::draw(
     for(int x = cols - 1; x >= 0; --x)
     {
       const auto& gc = area[y * cols + x];
-      const auto font_idx = editor_area->font_for_ucs(gc.ucs);
+      const auto font_idx = editor_area->font_for_ucs(gc.ucs());
       /// Neovim double-width characters have an empty string after them.
       /// Iterating from right to left we see the empty string first,
       /// then the double width character, which is why we have to draw
       /// the buffer as soon as we see the empty string.
-      if (gc.text.isEmpty())
+      if (gc.empty())
       {
         const auto [tl, br] = get_pos(x + 1, y, 0);
-        draw_buf(s->attr_for_id(prev_hl_id), tl, end);
+        draw_buf(s->resolved_for_id(prev_hl_id), tl, end);
         end = br;
       }
-      if (font_idx != cur_font_idx && !gc.text[0].isSpace())
+      if (font_idx != cur_font_idx && !gc.is_space())
       {
         const auto [tl, br] = get_pos(x + 1, y, 0);
-        draw_buf(s->attr_for_id(prev_hl_id), tl, end);
+        draw_buf(s->resolved_for_id(prev_hl_id), tl, end);
         end = br;
         cur_font_idx = font_idx;
       }
-      if (gc.double_width)
+      if (gc.double_width())
       {
         // Assume previous text has already been drawn.
         const auto [tl, br] = get_pos(x, y, 2);
-        buffer.append(gc.text);
-        draw_buf(s->attr_for_id(gc.hl_id), tl, br);
+        gc.append_to(buffer);
+        draw_buf(s->resolved_for_id(gc.hl_id), tl, br);
         end = get_pos(x, y, 0).second;
         prev_hl_id = gc.hl_id;
       }
       else if (gc.hl_id == prev_hl_id)
       {
-        buffer.append(gc.text);
+        gc.append_to(buffer);
         continue;
       }
       else
       {
         const auto [tl, br] = get_pos(x + 1, y, 0);
-        draw_buf(s->attr_for_id(prev_hl_id), tl, end);
+        draw_buf(s->resolved_for_id(prev_hl_id), tl, end);
         end = br;
-        buffer.append(gc.text);
+        gc.append_to(buffer);
         prev_hl_id = gc.hl_id;
       }
     }
     d2pt start = {0, y * font_height};
-    draw_buf(s->attr_for_id(prev_hl_id), start, end);
+    draw_buf(s->resolved_for_id(prev_hl_id), start, end);
   }
 }
 
@@ -428,7 +611,7 @@ void D2DPaintGrid::set_pos(u16 new_x, u16 new_y)
 {
   if (!editor_area->animations_enabled())
   {
-    move_update_timer.stop();
+    editor_area->frame_scheduler().stop_animation(&move_animation_time);
     GridBase::set_pos(new_x, new_y);
     update_position(new_x, new_y);
     return;
@@ -438,13 +621,12 @@ void D2DPaintGrid::set_pos(u16 new_x, u16 new_y)
   dest_move_x = new_x;
   dest_move_y = new_y;
   move_animation_time = editor_area->move_animation_duration();
-  auto interval = editor_area->move_animation_frametime();
-  if (move_update_timer.interval() != interval)
-  {
-    move_update_timer.setInterval(interval);
-  }
   GridBase::set_pos(new_x, new_y);
-  if (!move_update_timer.isActive()) move_update_timer.start();
+  editor_area->frame_scheduler().start_animation(
+    &move_animation_time,
+    [this](float dt) { return step_move_animation(dt); },
+    editor_area->move_animation_frametime()
+  );
 }
 
 void D2DPaintGrid::update_position(double x, double y)
@@ -460,40 +642,66 @@ void D2DPaintGrid::viewport_changed(Viewport vp)
   // at http://02credits.com/blog/day96-neovide-smooth-scrolling.
   if (!editor_area->animations_enabled() || viewport.topline == vp.topline)
   {
-    //scroll_animation_timer.stop();
     GridBase::viewport_changed(vp);
     return;
   }
   auto dest_topline = vp.topline;
   start_scroll_y = current_scroll_y;
   dest_scroll_y = dest_topline;
-  snapshots.push_back({viewport, copy_bitmap(bitmap)});
-  if (snapshots.size() > editor_area->snapshot_limit())
-  {
-    SafeRelease(&snapshots[0].image);
-    snapshots.erase(snapshots.begin());
-  }
+  save_scrolled_rows(vp);
   GridBase::viewport_changed(vp);
-  auto interval = editor_area->scroll_animation_frametime();
   scroll_animation_time = editor_area->scroll_animation_duration();
-  if (scroll_animation_timer.interval() != interval)
+  is_scrolling = true;
+  editor_area->frame_scheduler().start_animation(
+    &scroll_animation_time,
+    [this](float dt) { return step_scroll_animation(dt); },
+    editor_area->scroll_animation_frametime()
+  );
+}
+
+void D2DPaintGrid::save_scrolled_rows(const Viewport& vp)
+{
+  auto font_height = editor_area->font_dimensions().height;
+  const auto sz = bitmap->GetPixelSize();
+  const u32 capacity = sz.height * 2;
+  if (!scrollback
+    || scrollback->GetPixelSize().width != sz.width
+    || scrollback->GetPixelSize().height != capacity)
   {
-    scroll_animation_timer.setInterval(interval);
+    editor_area->resize_bitmap(context, &scrollback, sz.width, capacity);
+    ring.reset(int(capacity));
   }
-  is_scrolling = true;
-  if (!scroll_animation_timer.isActive()) scroll_animation_timer.start();
+  const bool top = vp.topline > viewport.topline;
+  const u32 lines = std::min<u32>(
+    top ? vp.topline - viewport.topline : viewport.topline - vp.topline,
+    rows
+  );
+  const int height = std::min(
+    int(std::ceil(lines * font_height)), int(sz.height)
+  );
+  const auto strip = ring.push(
+    {viewport.topline, viewport.botline, top, 0, height},
+    editor_area->snapshot_limit()
+  );
+  const u32 src_y = top ? 0 : sz.height - strip.height;
+  auto dst = D2D1::Point2U(0, strip.ring_y);
+  auto src_rect = D2D1::RectU(0, src_y, sz.width, src_y + strip.height);
+  scrollback->CopyFromBitmap(&dst, bitmap, &src_rect);
 }
 
-ID2D1Bitmap1* D2DPaintGrid::copy_bitmap(ID2D1Bitmap1* src)
+std::size_t D2DPaintGrid::snapshot_memory() const
 {
-  assert(src);
-  ID2D1Bitmap1* dst = nullptr;
-  auto sz = src->GetPixelSize();
-  editor_area->resize_bitmap(context, &dst, sz.width, sz.height);
-  auto tl = D2D1::Point2U(0, 0);
-  auto src_rect = D2D1::RectU(0, 0, sz.width, sz.height);
-  dst->CopyFromBitmap(&tl, src, &src_rect);
-  return dst;
+  if (!scrollback) return 0;
+  auto sz = scrollback->GetPixelSize();
+  // 32bpp
+  return std::size_t(sz.width) * sz.height * 4;
+}
+
+std::size_t D2DPaintGrid::buffer_memory() const
+{
+  if (!bitmap) return 0;
+  auto sz = bitmap->GetPixelSize();
+  return std::size_t(sz.width) * sz.height * 4;
 }
 
 void D2DPaintGrid::render(ID2D1RenderTarget* render_target)
@@ -520,19 +728,43 @@ void D2DPaintGrid::render(ID2D1RenderTarget* render_target)
   SafeRelease(&bg_brush);
   float cur_scroll_y = current_scroll_y * font_height;
   float cur_snapshot_top = viewport.topline * font_height;
-  for(auto it = snapshots.rbegin(); it != snapshots.rend(); ++it)
+  u32 min_topline = viewport.topline;
+  u32 max_botline = viewport.botline;
+  const auto& strips = ring.strips();
+  for(auto it = strips.rbegin(); it != strips.rend(); ++it)
   {
-    const auto& snapshot = *it;
-    float snapshot_top = snapshot.vp.topline * font_height;
+    const auto& strip = *it;
+    float snapshot_top = strip.topline * font_height;
     float offset = snapshot_top - cur_scroll_y;
     auto pixmap_top = top_left.y() + offset;
-    d2pt pt = D2D1::Point2F(top_left.x(), pixmap_top);
-    r = D2D1::RectF(pt.x, pt.y, pt.x + sz.width, pt.y + sz.height);
+    float height = 0.f;
+    d2rect src;
+    d2pt pt;
+    if (strip.top && strip.topline < min_topline)
+    {
+      height = (min_topline - strip.topline) * font_height;
+      height = std::min(height, float(strip.height));
+      min_topline = strip.topline;
+      src = D2D1::RectF(0, strip.ring_y, sz.width, strip.ring_y + height);
+      pt = D2D1::Point2F(top_left.x(), pixmap_top);
+    }
+    else if (!strip.top && strip.botline > max_botline)
+    {
+      height = (strip.botline - max_botline) * font_height;
+      height = std::min(height, float(strip.height));
+      max_botline = strip.botline;
+      float src_bot = strip.ring_y + strip.height;
+      src = D2D1::RectF(0, src_bot - height, sz.width, src_bot);
+      pt = D2D1::Point2F(top_left.x(), pixmap_top + sz.height - height);
+    }
+    if (height <= 0.f) continue;
+    r = D2D1::RectF(pt.x, pt.y, pt.x + sz.width, pt.y + height);
     render_target->DrawBitmap(
-      snapshot.image,
+      scrollback,
       &r,
       1.0f,
-      D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR
+      D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR,
+      &src
     );
   }
   float offset = cur_snapshot_top - cur_scroll_y;
@@ -559,11 +791,11 @@ void D2DPaintGrid::draw_cursor(ID2D1RenderTarget *target, const Cursor &cursor)
   if (idx >= area.size()) return;
   const auto& gc = area[idx];
   float scale_factor = 1.0f;
-  if (gc.double_width) scale_factor = 2.0f;
+  if (gc.double_width()) scale_factor = 2.0f;
   const CursorRect rect = *cursor.rect(font_width, font_height, scale_factor);
   ID2D1SolidColorBrush* brush = nullptr;
-  const HLAttr& attr = hl->attr_for_id(rect.hl_id);
-  auto [fg, bg, sp] = attr.fg_bg_sp(hl->default_colors_get());
+  const ResolvedHL& attr = hl->resolved_for_id(rect.hl_id);
+  const Color bg = attr.bg;
   target->CreateSolidColorBrush(D2D1::ColorF(bg.to_uint32()), &brush);
   const QRectF& r = rect.rect;
   auto fill_rect = D2D1::RectF(r.left(), r.top(), r.right(), r.bottom());
@@ -573,12 +805,12 @@ void D2DPaintGrid::draw_cursor(ID2D1RenderTarget *target, const Cursor &cursor)
   {
     fill_rect.right = std::max(fill_rect.right, fill_rect.left + font_width);
     // If the rect exists, the pos must exist as well.
-    auto font_idx = editor_area->font_for_ucs(gc.ucs);
+    auto font_idx = editor_area->font_for_ucs(gc.ucs());
     assert(font_idx < text_formats.size());
     const auto start = D2D1::Point2F(fill_rect.left, fill_rect.top);
     const auto end = D2D1::Point2F(fill_rect.right, fill_rect.bottom);
     draw_text(
-      *target, gc.text, fg, sp, attr.font_opts, start, end,
+      *target, gc.text(), attr.fg, attr.sp, attr.font_opts, start, end,
       font_width, font_height, *brush, text_formats[font_idx], true
     );
   }
@@ -587,7 +819,10 @@ void D2DPaintGrid::draw_cursor(ID2D1RenderTarget *target, const Cursor &cursor)
 
 D2DPaintGrid::~D2DPaintGrid()
 {
-  for(auto& snapshot : snapshots) SafeRelease(&snapshot.image);
+  editor_area->frame_scheduler().stop_animation(&move_animation_time);
+  editor_area->frame_scheduler().stop_animation(&scroll_animation_time);
+  SafeRelease(&scrollback);
+  SafeRelease(&scroll_buffer);
   SafeRelease(&bitmap);
   SafeRelease(&context);
 }
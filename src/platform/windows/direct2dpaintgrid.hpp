@@ -14,6 +14,7 @@
 #include "grid.hpp"
 #include "hlstate.hpp"
 #include "cursor.hpp"
+#include "fill_batch.hpp"
 
 class WinEditorArea;
 
@@ -24,11 +25,6 @@ class WinEditorArea;
 class D2DPaintGrid : public GridBase
 {
   Q_OBJECT
-  struct Snapshot
-  {
-    Viewport vp;
-    ID2D1Bitmap1* image;
-  };
   template<typename Resource>
   struct WinDeleter
   {
@@ -48,8 +44,7 @@ public:
   using d2pt = D2D1_POINT_2F;
   using d2rect = D2D1_RECT_F;
   using d2color = D2D1::ColorF;
-  using cache_type =
-    LRUCache<QPair<QString, FontOptions>, IDWriteTextLayout1*, TextLayoutDeleter>;
+  using cache_type = TextCache<IDWriteTextLayout1*, TextLayoutDeleter>;
 public:
   template<typename... GridBaseArgs>
   D2DPaintGrid(WinEditorArea* wea, GridBaseArgs... args)
@@ -60,8 +55,6 @@ public:
     initialize_context();
     initialize_cache();
     update_bitmap_size();
-    initialize_scroll_animation();
-    initialize_move_animation();
   }
   ~D2DPaintGrid();
   ID2D1Bitmap1* buffer() { return bitmap; }
@@ -88,12 +81,29 @@ public:
   void render(ID2D1RenderTarget* render_target);
   /// Draw the given cursor to the render target at the appropriate position
   void draw_cursor(ID2D1RenderTarget* target, const Cursor& cursor);
+  /// Bytes used for the smooth scrolling snapshots.
+  std::size_t snapshot_memory() const override;
+  std::size_t buffer_memory() const override;
+  CacheStats text_cache_stats() const override
+  {
+    return {layout_cache.hits(), layout_cache.misses()};
+  }
+  std::size_t text_cache_memory() const override
+  {
+    return layout_cache.size() * text_cache_entry_bytes;
+  }
+  void retire() override;
+  void reuse(u16 new_x, u16 new_y, u16 w, u16 h, u16 new_id) override;
+  std::size_t drop_snapshots() override;
+  std::size_t trim_text_cache(std::size_t bytes) override;
 private:
-  std::vector<Snapshot> snapshots;
+  /// Rows that were scrolled out of view, see QPaintGrid.
+  /// Twice the height of the bitmap.
+  ID2D1Bitmap1* scrollback = nullptr;
+  ScrollbackRing ring;
   WinEditorArea* editor_area = nullptr;
   ID2D1Bitmap1* bitmap = nullptr;
   ID2D1DeviceContext* context = nullptr;
-  QTimer move_update_timer {};
   float move_animation_time = -1.f; // Number of seconds till animation ends
   QPointF top_left = {0, 0};
   float start_scroll_y = 0.f;
@@ -102,7 +112,6 @@ private:
   float cur_left = 0.f;
   float cur_top = 0.f;
   float scroll_animation_time;
-  QTimer scroll_animation_timer {};
   float dest_move_x = 0.f;
   float dest_move_y = 0.f;
   float old_move_x = 0.f;
@@ -119,34 +128,37 @@ private:
   void initialize_context();
   /// Initialize the cache
   void initialize_cache();
-  /// Initialize the move animation
-  void initialize_move_animation();
-  /// Initialize the scroll animation
-  void initialize_scroll_animation();
-  /// Draw the grid range given by the rect.
+  /// Advance the move animation by dt seconds.
+  /// Returns false once it has finished.
+  bool step_move_animation(float dt);
+  /// Advance the scroll animation by dt seconds.
+  /// Returns false once it has finished.
+  bool step_scroll_animation(float dt);
+  /// Add the grid range given by the rect to the batch.
   /// Since we draw from the top-left, no offset is needed
   /// (unlike in QPaintGrid).
-  void draw(
-    ID2D1RenderTarget* context,
-    QRect r,
-    ID2D1SolidColorBrush* fg_brush,
-    ID2D1SolidColorBrush* bg_brush
-  );
-  /// Draw text onto the given device context, clipped
-  /// between start and end. Background & foreground colors
-  /// are controlled by the main and fallback highlight attributes.
-  void draw_text_and_bg(
-    ID2D1RenderTarget* context,
+  void draw(QRect r);
+  /// Add a run of text and its background to the batch.
+  void batch_text_and_bg(
     const QString& buf,
-    const HLAttr& main,
-    const HLAttr& fallback,
+    const ResolvedHL& hl,
     D2D1_POINT_2F start,
     D2D1_POINT_2F end,
-    float font_width,
-    float font_height,
-    IDWriteTextFormat* text_format,
-    ID2D1SolidColorBrush* fg_brush,
-    ID2D1SolidColorBrush* bg_brush
+    IDWriteTextFormat* text_format
+  );
+  /// Draw everything in the batch: the backgrounds grouped by color,
+  /// then the text grouped by color, then the text decorations.
+  /// Text is drawn after every background so that glyphs that
+  /// overhang their cells aren't painted over.
+  void flush_batch(ID2D1RenderTarget* target, ID2D1SolidColorBrush* brush);
+  /// Returns the (cached) layout for text, or nullptr if it
+  /// couldn't be created.
+  IDWriteTextLayout1* text_layout(
+    const QString& text,
+    const FontOptions font_opts,
+    float width,
+    float height,
+    IDWriteTextFormat* text_format
   );
   void draw_text(
     ID2D1RenderTarget& target,
@@ -175,9 +187,37 @@ private:
     D2D1_RECT_F rect,
     ID2D1SolidColorBrush& brush
   );
-  /// Returns a copy of src.
-  /// NOTE: Must be released.
-  ID2D1Bitmap1* copy_bitmap(ID2D1Bitmap1* src);
+  /// Fill the bottom of the run from start to end with the undercurl
+  /// tile for color (see decoration_tile.hpp).
+  void draw_undercurl(
+    ID2D1RenderTarget* target,
+    D2D1_POINT_2F start,
+    D2D1_POINT_2F end,
+    const Color& color
+  );
+  decoration::TileCache<ID2D1BitmapBrush*, WinDeleter<ID2D1BitmapBrush>>
+    undercurl_tiles {decoration::tile_cache_size};
+  /// Save the rows of the bitmap that are about to be scrolled out
+  /// of view (going from the current viewport to vp) to the scrollback.
+  void save_scrolled_rows(const Viewport& vp);
+  /// Shift the pixels of r (in cells) up by the given number of rows.
+  /// Must be called outside of BeginDraw/EndDraw.
+  void scroll_pixels(QRect r, int rows);
+  /// Scratch bitmap for scrolling (a bitmap can't be copied onto itself).
+  ID2D1Bitmap1* scroll_buffer = nullptr;
+  struct TextRun
+  {
+    QString text;
+    Color fg;
+    Color sp;
+    FontOptions font_opts;
+    d2pt start;
+    d2pt end;
+    IDWriteTextFormat* text_format;
+  };
+  /// What draw() collected since the last flush_batch().
+  FillBatch fills;
+  std::vector<TextRun> text_runs;
 };
 
 #endif // NVUI_PLATFORM_WINDOWS_DIRECT2DPAINTGRID_HPP
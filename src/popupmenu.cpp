@@ -1,10 +1,12 @@
 #include "popupmenu.hpp"
 #include <iostream>
 #include <QPainter>
+#include <QThreadPool>
 #include <QStringBuilder>
 #include <QStringLiteral>
 #include "hlstate.hpp"
 #include "msgpack_overrides.hpp"
+#include "shared_store.hpp"
 #include "utils.hpp"
 
 QString PopupMenuIconManager::kind_to_iname(QString kind)
@@ -45,34 +47,116 @@ static std::pair<QColor, QColor> find_or_default(
   else return {default_fg, default_bg};
 }
 
-QPixmap PopupMenuIconManager::load_icon(const QString& iname, int width)
+namespace
+{
+  struct IconKey
+  {
+    QString iname;
+    int width;
+    QRgb fg;
+    bool operator==(const IconKey&) const = default;
+  };
+
+  struct IconKeyHash
+  {
+    std::size_t operator()(const IconKey& k) const noexcept
+    {
+      return qHash(k.iname) ^ (std::size_t(k.width) * 31 + k.fg);
+    }
+  };
+}
+
+/// Rendered icons of every popup menu in the process.
+static SharedStore<IconKey, const QPixmap, IconKeyHash>& icon_store()
+{
+  static SharedStore<IconKey, const QPixmap, IconKeyHash> store;
+  return store;
+}
+
+std::shared_ptr<const QPixmap>
+PopupMenuIconManager::load_icon(const QString& iname, int width)
 {
   auto&& [fg, bg] = find_or_default(colors, iname, default_fg, default_bg);
-  auto&& px = pixmap_from_svg(
-    constants::picon_fp() % iname % ".svg",
-    fg,
-    Qt::transparent,
-    width, width
-  );
-  return px.value_or(QPixmap());
+  return icon_store().get(IconKey {iname, width, fg.rgba()}, [&] {
+    auto&& img = image_from_svg(
+      constants::picon_fp() % iname % ".svg",
+      fg,
+      Qt::transparent,
+      width, width
+    );
+    if (!img) return std::make_shared<const QPixmap>();
+    return std::make_shared<const QPixmap>(QPixmap::fromImage(std::move(*img)));
+  });
 }
 
 void PopupMenuIconManager::load_icons(int width)
 {
   auto keys = icons.keys();
+  overridden.clear();
+  std::vector<std::pair<QString, QColor>> jobs;
   for(auto& key : keys)
   {
-    icons[key] = load_icon(key, width);
+    const auto fg = find_or_default(colors, key, default_fg, default_bg).first;
+    // Another session has it already
+    if (icon_store().contains({key, width, fg.rgba()}))
+    {
+      icons[key] = load_icon(key, width);
+      continue;
+    }
+    icons[key] = nullptr;
+    jobs.emplace_back(key, fg);
+  }
+  if (jobs.empty())
+  {
+    pending.reset();
+    return;
   }
+  pending = std::make_shared<IconBatch>();
+  // Only renders images, icons are only made (and freed)
+  // on the GUI thread
+  QThreadPool::globalInstance()->start(
+    [batch = pending, jobs = std::move(jobs), width] {
+      for(const auto& [iname, fg] : jobs)
+      {
+        auto img = image_from_svg(
+          constants::picon_fp() % iname % ".svg", fg, Qt::transparent, width, width
+        );
+        if (img) batch->images[iname] = std::move(*img);
+      }
+      batch->done.store(true, std::memory_order_release);
+    }
+  );
+}
+
+void PopupMenuIconManager::collect_icons()
+{
+  if (!pending || !pending->done.load(std::memory_order_acquire)) return;
+  // Colors and size are the ones the batch was started with, any
+  // change since then either started a new batch or is in overridden
+  for(auto it = pending->images.begin(); it != pending->images.end(); ++it)
+  {
+    if (overridden.contains(it.key())) continue;
+    auto& icon = icons[it.key()];
+    if (icon) continue;
+    const auto fg = find_or_default(colors, it.key(), default_fg, default_bg).first;
+    icon = icon_store().get(IconKey {it.key(), sq_width, fg.rgba()}, [&] {
+      return std::make_shared<const QPixmap>(QPixmap::fromImage(std::move(it.value())));
+    });
+  }
+  pending.reset();
+  overridden.clear();
 }
 
 const QPixmap* PopupMenuIconManager::icon_for_kind(const QString& kind)
 {
   if (kind.isEmpty()) return nullptr;
+  collect_icons();
   QString iname = kind_to_iname(kind).trimmed();
   const auto it = icons.find(iname);
   if (it == icons.end()) return nullptr;
-  else return &(*it);
+  // Not rendered in the background yet
+  if (!*it) *it = load_icon(iname, sq_width);
+  return it->get();
 }
 
 PopupMenuInfo::PopupMenuInfo(PopupMenu* parent)
@@ -119,7 +203,7 @@ PopupMenu::PopupMenu(const HLState* state, QWidget* parent)
   : QWidget(parent),
     hl_state(state),
     pixmap(),
-    completion_items(max_items),
+    completion_items(),
     info_widget(this),
     icon_manager(10),
     pmenu_font()
@@ -133,9 +217,7 @@ void PopupMenu::pum_show(std::span<const Object> objs)
 {
   is_hidden = false;
   completion_items.clear();
-  using std::tuple;
-  using std::vector;
-  using std::string;
+  first_visible = 0;
   for(std::size_t i = 0; i < objs.size(); ++i)
   {
     auto& obj = objs[i];
@@ -148,12 +230,9 @@ void PopupMenu::pum_show(std::span<const Object> objs)
     grid_num = (int) arr->at(4);
     assert(items);
     add_items(*items);
-    if (cur_selected >= 0 && cur_selected < int(completion_items.size()))
-    {
-      completion_items[i].selected = true;
-    }
-    paint();
   }
+  materialize_visible();
+  paint();
   resize(available_rect().size());
 }
 
@@ -163,10 +242,28 @@ void PopupMenu::pum_sel(std::span<const Object> objs)
   const auto& obj = objs.back();
   auto* arr = obj.array();
   assert(arr && arr->size() >= 1);
-  if (cur_selected >= 0) completion_items[cur_selected].selected = false;
+  const int prev_selected = cur_selected;
   cur_selected = static_cast<int>(arr->at(0));
-  if (cur_selected >= 0) completion_items[cur_selected].selected = true;
-  paint();
+  const auto first = pum_first_visible(
+    first_visible, cur_selected, max_items, completion_items.size()
+  );
+  if (first != first_visible)
+  {
+    // Scrolled, every row changes
+    first_visible = first;
+    materialize_visible();
+    paint();
+    return;
+  }
+  // Only the rows that were and are now selected need to be redrawn
+  update_highlight_attributes();
+  QPainter p(&pixmap);
+  for(const int index : {prev_selected, cur_selected})
+  {
+    if (!is_visible_index(index)) continue;
+    draw_row(p, index);
+    update(0, row_y(index), width(), std::ceil(cell_height));
+  }
 }
 
 void PopupMenu::pum_hide(std::span<const Object> objs)
@@ -179,58 +276,76 @@ void PopupMenu::pum_hide(std::span<const Object> objs)
 
 void PopupMenu::add_items(const ObjectArray& items)
 {
+  completion_items.reserve(completion_items.size() + items.size());
   for(const auto& item : items)
   {
     auto* arr = item.array();
     assert(arr && arr->size() >= 4);
-    auto word = QString::fromStdString(*arr->at(0).string());
-    auto kind = QString::fromStdString(*arr->at(1).string());
-    auto menu = QString::fromStdString(*arr->at(2).string());
-    auto info = QString::fromStdString(*arr->at(3).string());
-    completion_items.push_back({
-      false, std::move(word), std::move(kind), std::move(menu), std::move(info)
-    });
+    completion_items.add(
+      *arr->at(0).string(), *arr->at(1).string(),
+      *arr->at(2).string(), *arr->at(3).string()
+    );
+  }
+}
+
+void PopupMenu::materialize_visible()
+{
+  first_visible = pum_first_visible(
+    first_visible, cur_selected, max_items, completion_items.size()
+  );
+  const auto count = visible_count();
+  visible_items.resize(count);
+  for(std::size_t i = 0; i < count; ++i)
+  {
+    const auto index = first_visible + i;
+    const auto to_qstring = [&](PumItems::Field field) {
+      const auto text = completion_items.get(index, field);
+      return QString::fromUtf8(text.data(), int(text.size()));
+    };
+    visible_items[i] = {
+      to_qstring(PumItems::Word), to_qstring(PumItems::Kind),
+      to_qstring(PumItems::Menu), to_qstring(PumItems::Info)
+    };
   }
 }
 
 void PopupMenu::update_highlight_attributes()
 {
-  pmenu = &hl_state->attr_for_id(hl_state->id_for_name("Pmenu"));
-  pmenu_sbar = &hl_state->attr_for_id(hl_state->id_for_name("PmenuSbar"));
-  pmenu_sel = &hl_state->attr_for_id(hl_state->id_for_name("PmenuSel"));
-  pmenu_thumb = &hl_state->attr_for_id(hl_state->id_for_name("PmenuThumb"));
+  highlights.update(*hl_state);
 }
 
-void PopupMenu::paint()
+void PopupMenu::draw_row(QPainter& p, std::size_t index)
 {
-  update_highlight_attributes();
-  QPainter p(&pixmap);
-  int cur_y = std::ceil(border_width);
-  bool nothing_selected = cur_selected == -1;
-  if (nothing_selected) cur_selected = 0;
-  for(std::size_t i = 0; i < std::min(completion_items.size(), max_items) + 1; ++i)
+  const PMenuItem& item = visible_items[index - first_visible];
+  const HLAttr& pmenu = hl_state->attr_for_id(highlights.pmenu);
+  if (int(index) == cur_selected)
   {
-    std::size_t index = (cur_selected + i) % completion_items.size();
-    if (completion_items[index].selected)
+    draw_with_attr(p, hl_state->attr_for_id(highlights.sel), item, row_y(index));
+    if (!item.info.trimmed().isEmpty())
     {
-      const auto& item = completion_items[index];
-      draw_with_attr(p, *pmenu_sel, item, cur_y);
-      if (!item.info.trimmed().isEmpty())
-      {
-        draw_info(p, *pmenu, item.info);
-      }
-      else
-      {
-        draw_info(p, *pmenu, QString());
-      }
+      draw_info(p, pmenu, item.info);
     }
     else
     {
-      draw_with_attr(p, *pmenu, completion_items[index], cur_y);
+      draw_info(p, pmenu, QString());
     }
-    cur_y += cell_height;
   }
-  if (nothing_selected) cur_selected = -1;
+  else
+  {
+    draw_with_attr(p, pmenu, item, row_y(index));
+  }
+}
+
+void PopupMenu::paint()
+{
+  update_highlight_attributes();
+  // max_items may have changed
+  if (visible_items.size() != visible_count()) materialize_visible();
+  QPainter p(&pixmap);
+  for(std::size_t i = 0; i < visible_items.size(); ++i)
+  {
+    draw_row(p, first_visible + i);
+  }
   update();
 }
 
@@ -1,6 +1,9 @@
 #ifndef NVUI_POPUPMENU_HPP
 #define NVUI_POPUPMENU_HPP
+#include <atomic>
+#include <memory>
 #include <optional>
+#include <QSet>
 #include <QWidget>
 #include <QCompleter>
 #include <QDebug>
@@ -10,6 +13,7 @@
 #include <msgpack.hpp>
 #include "hlstate.hpp"
 #include "object.hpp"
+#include "pum_items.hpp"
 #include "utils.hpp"
 #include <fmt/core.h>
 #include <fmt/format.h>
@@ -17,16 +21,18 @@
 
 /// Manages the popup menu icons and gives the appropriate
 /// icon for each popup menu item kind (useful for LSP).
-/// Icons are square
+/// Icons are square, and shared with the popup menus of other
+/// sessions that use the same size and colors (see --tabs).
 class PopupMenuIconManager
 {
 public:
   using color_opt = std::optional<QColor>;
   using fg_bg = std::pair<color_opt, color_opt>;
+  /// Icons aren't rendered until the first call to size_changed
+  /// (or until one is needed).
   PopupMenuIconManager(int pm_size)
     : sq_width(pm_size)
   {
-    load_icons(pm_size);
   }
 
   void size_changed(int new_size)
@@ -75,7 +81,9 @@ public:
   inline void update_icon(const QString& name)
   {
     if (!icons.contains(name)) return;
-    else icons[name] = load_icon(name, sq_width);
+    icons[name] = load_icon(name, sq_width);
+    // Whatever is being rendered in the background has the old colors
+    overridden.insert(name);
   }
 
   std::vector<std::string> icon_list() const
@@ -89,6 +97,18 @@ public:
     return vs;
   }
 
+  /// Bytes held by the rendered icons.
+  std::size_t memory_usage() const
+  {
+    std::size_t total = 0;
+    for(const auto& icon : icons)
+    {
+      if (!icon) continue;
+      total += std::size_t(icon->width()) * icon->height() * (icon->depth() / 8);
+    }
+    return total;
+  }
+
   const QColor* bg_for_kind(const QString& kind) const
   {
     if (!colors.contains(kind)) return nullptr;
@@ -97,8 +117,23 @@ public:
     return &*clr;
   }
 private:
-  QPixmap load_icon(const QString& iname, int width);
+  /// Icons being rendered on a worker thread.
+  struct IconBatch
+  {
+    std::atomic<bool> done = false;
+    QHash<QString, QImage> images;
+  };
+  /// The icon iname rendered at width with its current colors,
+  /// rendered here if no one has it yet.
+  std::shared_ptr<const QPixmap> load_icon(const QString& iname, int width);
+  /**
+   * Throw away the current icons and start rendering new ones in
+   * the background. Until they're done, icons that are needed
+   * are rendered on the spot.
+   */
   void load_icons(int width);
+  /// Take the icons of a finished batch.
+  void collect_icons();
   QString iname_to_kind(const QString& iname);
   QString kind_to_iname(QString kind);
   // Map string (iname) to (foreground, background) tuple
@@ -135,7 +170,8 @@ private:
     {"structure", {}},
     {"variable", {}}
   };
-  QHash<QString, QPixmap> icons {
+  /// nullptr until the icon is rendered.
+  QHash<QString, std::shared_ptr<const QPixmap>> icons {
     {"array", {}},
     {"boolean", {}},
     {"class", {}},
@@ -166,14 +202,38 @@ private:
     {"structure", {}},
     {"variable", {}}
   };
+  std::shared_ptr<IconBatch> pending;
+  /// Icons that changed since pending was started.
+  QSet<QString> overridden;
   int sq_width = 0;
   QColor default_fg = Qt::blue;
   QColor default_bg = Qt::transparent;
 };
 
+/// The highlight ids of the popup menu's groups. They're only looked
+/// up again when HLState::generation() changes, the attributes are
+/// looked up by id whenever they're drawn (defining new ids moves them).
+struct PmenuHighlights
+{
+  int pmenu = 0;
+  int sel = 0;
+  int sbar = 0;
+  int thumb = 0;
+  /// The generation the ids were looked up at.
+  std::optional<std::uint32_t> generation;
+  void update(const HLState& state)
+  {
+    if (generation == state.generation()) return;
+    generation = state.generation();
+    pmenu = state.id_for_name("Pmenu");
+    sel = state.id_for_name("PmenuSel");
+    sbar = state.id_for_name("PmenuSbar");
+    thumb = state.id_for_name("PmenuThumb");
+  }
+};
+
 struct PMenuItem
 {
-  bool selected = false;
   QString word;
   QString kind;
   QString menu;
@@ -355,6 +415,13 @@ public:
     return icon_manager.icon_list();
   }
 
+  /// Bytes held by the menu's pixmap and its icons.
+  std::size_t memory_usage() const
+  {
+    return std::size_t(pixmap.width()) * pixmap.height() * (pixmap.depth() / 8)
+      + icon_manager.memory_usage();
+  }
+
   auto& info_display() { return info_widget; }
 
   auto selected_idx() { return cur_selected; }
@@ -373,16 +440,34 @@ private:
    * and with the given attribute.
    */
   void draw_with_attr(QPainter& p, const HLAttr& attr, const PMenuItem& item, int y);
+  /**
+   * Draw the item at index (which must be visible) in its row.
+   */
+  void draw_row(QPainter& p, std::size_t index);
+  /**
+   * Convert the items in the visible window to QStrings.
+   */
+  void materialize_visible();
+  std::size_t visible_count() const
+  {
+    return std::min(completion_items.size(), max_items);
+  }
+  bool is_visible_index(int index) const
+  {
+    return index >= 0 && std::size_t(index) >= first_visible
+      && std::size_t(index) < first_visible + visible_items.size();
+  }
+  int row_y(std::size_t index) const
+  {
+    return std::ceil(border_width) + int(index - first_visible) * cell_height;
+  }
   /**
    * Draw the info as its own box.
    */
   void draw_info(QPainter& p, const HLAttr& attr, const QString& info);
   std::optional<int> attached_width;
   const HLState* hl_state;
-  const HLAttr* pmenu = nullptr;
-  const HLAttr* pmenu_sel = nullptr;
-  const HLAttr* pmenu_sbar = nullptr;
-  const HLAttr* pmenu_thumb = nullptr;
+  PmenuHighlights highlights;
   QColor border_color {0, 0, 0};
   std::size_t max_chars = 50;
   // Max items to display on screen at once.
@@ -390,7 +475,11 @@ private:
   int cur_selected = -1;
   QPixmap pixmap;
   float font_ascent = 0.f;
-  std::vector<PMenuItem> completion_items;
+  PumItems completion_items;
+  /// Index of the item in the first row.
+  std::size_t first_visible = 0;
+  /// The items from first_visible onwards that are on screen.
+  std::vector<PMenuItem> visible_items;
   float cell_width = 0.f;
   float cell_height = 0.f;
   int grid_num = 0;
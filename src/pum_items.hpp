@@ -0,0 +1,86 @@
+#ifndef NVUI_PUM_ITEMS_HPP
+#define NVUI_PUM_ITEMS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// The raw (UTF-8) text of every popup menu item, stored back to back
+/// in one buffer. Completion lists can have thousands of items while
+/// only a handful are shown, so items are only converted to QStrings
+/// once they become visible.
+class PumItems
+{
+public:
+  enum Field : std::size_t
+  {
+    Word,
+    Kind,
+    Menu,
+    Info
+  };
+  void clear()
+  {
+    data.clear();
+    offsets.clear();
+  }
+  void reserve(std::size_t items) { offsets.reserve(items); }
+  void add(
+    std::string_view word,
+    std::string_view kind,
+    std::string_view menu,
+    std::string_view info
+  )
+  {
+    Offsets o;
+    std::size_t i = 0;
+    for(const auto field : {word, kind, menu, info})
+    {
+      o[i++] = static_cast<std::uint32_t>(data.size());
+      data.append(field);
+    }
+    o[i] = static_cast<std::uint32_t>(data.size());
+    offsets.push_back(o);
+  }
+  std::size_t size() const { return offsets.size(); }
+  bool empty() const { return offsets.empty(); }
+  std::string_view get(std::size_t index, Field field) const
+  {
+    assert(index < offsets.size());
+    const auto& o = offsets[index];
+    return std::string_view(data).substr(o[field], o[field + 1] - o[field]);
+  }
+private:
+  /// Start of each field, followed by the end of the last one.
+  using Offsets = std::array<std::uint32_t, 5>;
+  std::string data;
+  std::vector<Offsets> offsets;
+};
+
+/**
+ * Returns the first item to show so that the selected item is visible,
+ * moving the window as little as possible from first.
+ * selected is -1 if nothing is selected.
+ */
+inline std::size_t pum_first_visible(
+  std::size_t first,
+  int selected,
+  std::size_t visible,
+  std::size_t count
+)
+{
+  if (visible == 0 || count <= visible) return 0;
+  first = std::min(first, count - visible);
+  if (selected < 0) return first;
+  const auto sel = static_cast<std::size_t>(selected);
+  if (sel < first) return sel;
+  if (sel >= first + visible) return sel - visible + 1;
+  return first;
+}
+
+#endif // NVUI_PUM_ITEMS_HPP
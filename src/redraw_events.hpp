@@ -0,0 +1,168 @@
+#ifndef NVUI_REDRAW_EVENTS_HPP
+#define NVUI_REDRAW_EVENTS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/// Neovim's "redraw" UI events.
+/// See :help ui-events.
+enum class RedrawEvent : std::uint8_t
+{
+  // Global
+  mode_info_set,
+  option_set,
+  chdir,
+  mode_change,
+  mouse_on,
+  mouse_off,
+  busy_start,
+  busy_stop,
+  suspend,
+  update_menu,
+  bell,
+  visual_bell,
+  flush,
+  set_title,
+  set_icon,
+  // Grid / highlights
+  grid_resize,
+  default_colors_set,
+  hl_attr_define,
+  hl_group_set,
+  grid_line,
+  grid_clear,
+  grid_destroy,
+  grid_cursor_goto,
+  grid_scroll,
+  // Multigrid
+  win_pos,
+  win_float_pos,
+  win_external_pos,
+  win_hide,
+  win_close,
+  msg_set_pos,
+  win_viewport,
+  win_extmark,
+  // Popupmenu
+  popupmenu_show,
+  popupmenu_select,
+  popupmenu_hide,
+  // Tabline
+  tabline_update,
+  // Cmdline
+  cmdline_show,
+  cmdline_pos,
+  cmdline_special_char,
+  cmdline_hide,
+  cmdline_block_show,
+  cmdline_block_append,
+  cmdline_block_hide,
+  // Messages
+  msg_show,
+  msg_clear,
+  msg_showmode,
+  msg_showcmd,
+  msg_ruler,
+  msg_history_show,
+  msg_history_clear,
+  Count,
+  Unknown = Count
+};
+
+namespace redraw_events
+{
+  inline constexpr std::size_t count = std::size_t(RedrawEvent::Count);
+
+  /// Names of the events, indexed by RedrawEvent.
+  inline constexpr std::array<std::string_view, count> names {
+    "mode_info_set", "option_set", "chdir", "mode_change", "mouse_on",
+    "mouse_off", "busy_start", "busy_stop", "suspend", "update_menu", "bell",
+    "visual_bell", "flush", "set_title", "set_icon",
+    "grid_resize", "default_colors_set", "hl_attr_define", "hl_group_set",
+    "grid_line", "grid_clear", "grid_destroy", "grid_cursor_goto",
+    "grid_scroll",
+    "win_pos", "win_float_pos", "win_external_pos", "win_hide", "win_close",
+    "msg_set_pos", "win_viewport", "win_extmark",
+    "popupmenu_show", "popupmenu_select", "popupmenu_hide",
+    "tabline_update",
+    "cmdline_show", "cmdline_pos", "cmdline_special_char", "cmdline_hide",
+    "cmdline_block_show", "cmdline_block_append", "cmdline_block_hide",
+    "msg_show", "msg_clear", "msg_showmode", "msg_showcmd", "msg_ruler",
+    "msg_history_show", "msg_history_clear"
+  };
+
+  namespace detail
+  {
+    inline constexpr std::size_t table_size = 256;
+
+    constexpr std::uint32_t hash(std::uint32_t seed, std::string_view s)
+    {
+      // FNV-1a
+      std::uint32_t h = 2166136261u ^ seed;
+      for(char c : s)
+      {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+      }
+      return h ^ (h >> 15);
+    }
+
+    constexpr bool is_perfect(std::uint32_t seed)
+    {
+      std::array<bool, table_size> used {};
+      for(const auto& name : names)
+      {
+        auto slot = hash(seed, name) % table_size;
+        if (used[slot]) return false;
+        used[slot] = true;
+      }
+      return true;
+    }
+
+    constexpr std::uint32_t find_seed()
+    {
+      std::uint32_t seed = 0;
+      while(!is_perfect(seed)) ++seed;
+      return seed;
+    }
+
+    /// First seed that maps every name to its own slot.
+    inline constexpr std::uint32_t seed = find_seed();
+
+    constexpr std::array<RedrawEvent, table_size> make_table()
+    {
+      std::array<RedrawEvent, table_size> table {};
+      for(auto& e : table) e = RedrawEvent::Unknown;
+      for(std::size_t i = 0; i < count; ++i)
+      {
+        table[hash(seed, names[i]) % table_size] = RedrawEvent(i);
+      }
+      return table;
+    }
+
+    inline constexpr std::array<RedrawEvent, table_size> table = make_table();
+  } // namespace detail
+
+  /// Decode an event name with a single hash, table lookup
+  /// and compare. Returns RedrawEvent::Unknown for names that aren't
+  /// in the list above.
+  constexpr RedrawEvent from_name(std::string_view name)
+  {
+    const auto e = detail::table[detail::hash(detail::seed, name) % detail::table_size];
+    if (e == RedrawEvent::Unknown || names[std::size_t(e)] != name)
+    {
+      return RedrawEvent::Unknown;
+    }
+    return e;
+  }
+
+  constexpr std::string_view name(RedrawEvent e)
+  {
+    if (e >= RedrawEvent::Count) return {};
+    return names[std::size_t(e)];
+  }
+} // namespace redraw_events
+
+#endif // NVUI_REDRAW_EVENTS_HPP
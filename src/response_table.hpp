@@ -0,0 +1,104 @@
+#ifndef NVUI_RESPONSE_TABLE_HPP
+#define NVUI_RESPONSE_TABLE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+/// Callbacks waiting for the response to a request, indexed by msgid.
+/// Slots are preallocated and picked with msgid % Capacity, so
+/// registering a callback and taking it when the response comes in
+/// don't take a lock, and a request that's being written out doesn't
+/// hold up the dispatch of other responses.
+/// Any thread may add callbacks, but only one thread (the one reading
+/// responses) may take them.
+/// If a request is still waiting on the slot a new msgid maps to
+/// (i.e. more than Capacity requests are in flight, or one is never
+/// answered), the callback goes to a map that takes a lock instead.
+template<typename Callback, std::size_t Capacity = 256>
+class ResponseTable
+{
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+    "Capacity must be a power of two");
+  static constexpr std::size_t mask = Capacity - 1;
+  enum State : std::uint8_t
+  {
+    Free,
+    /// Taken by a thread that's storing its callback
+    Writing,
+    /// Waiting for its response
+    Ready
+  };
+  struct Slot
+  {
+    std::atomic<State> state {Free};
+    std::uint64_t msgid = 0;
+    Callback cb {};
+  };
+public:
+  ResponseTable() = default;
+  ResponseTable(const ResponseTable&) = delete;
+  ResponseTable& operator=(const ResponseTable&) = delete;
+  /// Store the callback for msgid. Never waits for a slot.
+  void add(std::uint64_t msgid, Callback cb)
+  {
+    Slot& slot = slots[msgid & mask];
+    State expected = Free;
+    if (!slot.state.compare_exchange_strong(
+      expected, Writing, std::memory_order_acquire, std::memory_order_relaxed
+    ))
+    {
+      std::lock_guard lock {overflow_mutex};
+      overflow.insert_or_assign(msgid, std::move(cb));
+      overflow_size.store(overflow.size(), std::memory_order_release);
+      return;
+    }
+    slot.msgid = msgid;
+    slot.cb = std::move(cb);
+    slot.state.store(Ready, std::memory_order_release);
+  }
+  /// Removes and returns the callback for msgid, if there is one.
+  /// Reader only.
+  std::optional<Callback> take(std::uint64_t msgid)
+  {
+    Slot& slot = slots[msgid & mask];
+    if (slot.state.load(std::memory_order_acquire) != Ready
+      || slot.msgid != msgid)
+    {
+      return take_overflow(msgid);
+    }
+    std::optional<Callback> cb {std::move(slot.cb)};
+    slot.cb = Callback {};
+    slot.state.store(Free, std::memory_order_release);
+    return cb;
+  }
+  static constexpr std::size_t capacity() { return Capacity; }
+  /// Callbacks that didn't fit in their slot.
+  std::size_t num_overflowed() const
+  {
+    return overflow_size.load(std::memory_order_acquire);
+  }
+private:
+  std::optional<Callback> take_overflow(std::uint64_t msgid)
+  {
+    // Nearly always empty, no need to lock then
+    if (overflow_size.load(std::memory_order_acquire) == 0) return std::nullopt;
+    std::lock_guard lock {overflow_mutex};
+    const auto it = overflow.find(msgid);
+    if (it == overflow.end()) return std::nullopt;
+    std::optional<Callback> cb {std::move(it->second)};
+    overflow.erase(it);
+    overflow_size.store(overflow.size(), std::memory_order_release);
+    return cb;
+  }
+  Slot slots[Capacity];
+  std::mutex overflow_mutex;
+  std::unordered_map<std::uint64_t, Callback> overflow;
+  std::atomic<std::size_t> overflow_size = 0;
+};
+
+#endif // NVUI_RESPONSE_TABLE_HPP
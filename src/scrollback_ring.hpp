@@ -0,0 +1,81 @@
+#ifndef NVUI_SCROLLBACK_RING_HPP
+#define NVUI_SCROLLBACK_RING_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+/// Bookkeeping for the smooth scrolling snapshots of a grid.
+/// Instead of a full copy of the grid per scroll step, only the rows
+/// that were scrolled out of view are kept, as strips in one image
+/// (the ring) that's a fixed number of pixel rows tall. The ring is
+/// filled from top to bottom, and wraps around to the top when the next
+/// strip doesn't fit, overwriting (evicting) the oldest strips.
+/// This only tracks positions, the renderers own the image and do the
+/// copying.
+class ScrollbackRing
+{
+public:
+  struct Strip
+  {
+    /// Viewport the rows were scrolled out of.
+    std::uint32_t topline;
+    std::uint32_t botline;
+    /// Whether the strip holds the top rows of that viewport
+    /// (scrolled out going down), or the bottom rows (going up).
+    bool top;
+    /// Pixel row of the ring the strip starts at.
+    int ring_y;
+    /// Height in pixels.
+    int height;
+  };
+  /// Forget all strips and set the height of the ring, in pixels.
+  void reset(int capacity_px)
+  {
+    capacity = std::max(capacity_px, 0);
+    clear();
+  }
+  void clear()
+  {
+    strip_list.clear();
+    head = 0;
+  }
+  /// Reserve space for a strip of s.height rows (clamped to the ring's
+  /// height), keeping at most max_strips strips.
+  /// Returns the strip with its ring_y and height filled in; the caller
+  /// copies the rows there. Strips that were overwritten are removed.
+  Strip push(Strip s, std::size_t max_strips)
+  {
+    s.height = std::clamp(s.height, 0, capacity);
+    if (head + s.height > capacity) head = 0;
+    s.ring_y = head;
+    // Strips are laid out in the ring in the order they were added,
+    // so the ones in the way are always the oldest ones
+    while(!strip_list.empty() && overlaps(strip_list.front(), s))
+    {
+      strip_list.pop_front();
+    }
+    strip_list.push_back(s);
+    while(strip_list.size() > std::max<std::size_t>(max_strips, 1))
+    {
+      strip_list.pop_front();
+    }
+    head += s.height;
+    return s;
+  }
+  /// Oldest first.
+  const std::deque<Strip>& strips() const { return strip_list; }
+  bool empty() const { return strip_list.empty(); }
+  int height() const { return capacity; }
+private:
+  static bool overlaps(const Strip& a, const Strip& b)
+  {
+    return a.ring_y < b.ring_y + b.height && b.ring_y < a.ring_y + a.height;
+  }
+  std::deque<Strip> strip_list;
+  int capacity = 0;
+  int head = 0;
+};
+
+#endif // NVUI_SCROLLBACK_RING_HPP
@@ -0,0 +1,105 @@
+#include "session_tabs.hpp"
+#include <algorithm>
+#include <cassert>
+#include <QIcon>
+#include <QMetaObject>
+#include <QTabBar>
+#include "constants.hpp"
+#include "nvim.hpp"
+#include "window.hpp"
+
+SessionTabs::SessionTabs(Options opts)
+  : QTabWidget(nullptr),
+    options(std::move(opts))
+{
+  setDocumentMode(true);
+  setTabsClosable(true);
+  setMovable(true);
+  // Only worth the space with more than one session
+  tabBar()->setAutoHide(true);
+  setWindowIcon(QIcon(constants::appicon()));
+  QObject::connect(this, &QTabWidget::currentChanged, [this](int index) {
+    Session* session = session_of(index);
+    if (!session) return;
+    setWindowTitle(session->window->windowTitle());
+    session->window->editor().setFocus();
+  });
+  // Let Neovim decide, it may have unsaved changes
+  QObject::connect(this, &QTabWidget::tabCloseRequested, [this](int index) {
+    if (Session* session = session_of(index))
+    {
+      session->nvim->command("confirm qa");
+    }
+  });
+}
+
+SessionTabs::~SessionTabs() = default;
+
+Window* SessionTabs::open_session(const std::vector<std::string>& extra_args)
+{
+  auto args = options.nvim_args;
+  args.insert(args.end(), extra_args.begin(), extra_args.end());
+  return add_session(std::make_unique<Nvim>(options.nvim_path, std::move(args)));
+}
+
+Window* SessionTabs::add_session(std::unique_ptr<Nvim> nvim)
+{
+  assert(nvim);
+  // Same as a lone window, see main()
+  nvim->defer_notifications();
+  nvim->set_var("nvui", 1);
+  nvim->attach_ui(options.width, options.height, options.capabilities);
+  auto window = std::make_unique<Window>(
+    nullptr, nvim.get(), options.width, options.height, false
+  );
+  Window* w = window.get();
+  w->register_handlers();
+  if (sessions.empty()) resize(w->size());
+  const int index = addTab(w, QStringLiteral("nvui"));
+  QObject::connect(w, &QWidget::windowTitleChanged, this, [this, w](const QString& title) {
+    const int index = indexOf(w);
+    setTabText(index, title);
+    if (index == currentIndex()) setWindowTitle(title);
+  });
+  nvim->on_exit([this, w] {
+    QMetaObject::invokeMethod(this, [this, w] { close_session(w); }, Qt::QueuedConnection);
+  });
+  nvim->resume_notifications();
+  sessions.push_back({std::move(nvim), std::move(window)});
+  // The first tab was current before its session was added
+  if (index == currentIndex()) emit currentChanged(index);
+  else setCurrentIndex(index);
+  return w;
+}
+
+void SessionTabs::close_session(Window* w)
+{
+  const auto it = std::find_if(sessions.begin(), sessions.end(), [w](const auto& s) {
+    return s.window.get() == w;
+  });
+  if (it == sessions.end()) return;
+  removeTab(indexOf(w));
+  sessions.erase(it);
+  if (sessions.empty()) close();
+}
+
+SessionTabs::Session* SessionTabs::session_of(int index)
+{
+  const QWidget* w = widget(index);
+  if (!w) return nullptr;
+  for(auto& session : sessions)
+  {
+    if (session.window.get() == w) return &session;
+  }
+  return nullptr;
+}
+
+void SessionTabs::changeEvent(QEvent* event)
+{
+  // The tabs only see their own state, not the top-level window's
+  if (event->type() == QEvent::WindowStateChange)
+  {
+    for(auto& session : sessions) session.window->update_suspended();
+  }
+  QTabWidget::changeEvent(event);
+}
@@ -0,0 +1,62 @@
+#ifndef NVUI_SESSION_TABS_HPP
+#define NVUI_SESSION_TABS_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <QEvent>
+#include <QTabWidget>
+
+class Nvim;
+class Window;
+
+/// Several Neovim sessions in one window, one per tab (--tabs).
+/// Each session has its own Neovim and its own Window (with its own
+/// highlight state), but they share one process, so the fallback
+/// fonts and popup menu icons that are the same for every session
+/// are only found and rendered once.
+/// A tab goes away when its Neovim exits, and the window closes
+/// when the last one does.
+class SessionTabs : public QTabWidget
+{
+  Q_OBJECT
+public:
+  /// How every session's Neovim is started and attached.
+  struct Options
+  {
+    std::string nvim_path;
+    /// Arguments every session's Neovim gets, including --embed.
+    std::vector<std::string> nvim_args;
+    int width = 100;
+    int height = 50;
+    std::unordered_map<std::string, bool> capabilities;
+  };
+  SessionTabs(Options options);
+  ~SessionTabs() override;
+  /**
+   * Start a new Neovim with extra_args after the usual arguments
+   * and open a tab for it. Throws if Neovim couldn't be started.
+   */
+  Window* open_session(const std::vector<std::string>& extra_args = {});
+  /// Open a tab for nvim, which hasn't attached yet.
+  Window* add_session(std::unique_ptr<Nvim> nvim);
+  std::size_t num_sessions() const { return sessions.size(); }
+protected:
+  void changeEvent(QEvent* event) override;
+private:
+  struct Session
+  {
+    std::unique_ptr<Nvim> nvim;
+    /// Destroyed before its Neovim.
+    std::unique_ptr<Window> window;
+  };
+  /// Remove the tab of w, once its Neovim exited.
+  void close_session(Window* w);
+  Session* session_of(int index);
+  Options options;
+  std::vector<Session> sessions;
+};
+
+#endif // NVUI_SESSION_TABS_HPP
@@ -0,0 +1,68 @@
+#ifndef NVUI_SHARED_STORE_HPP
+#define NVUI_SHARED_STORE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/// Values that are expensive to build (fallback tables, icons),
+/// shared by every session in the process that asks for the same key
+/// (see --tabs). The store only holds weak references, so a value is
+/// freed once the last session that uses it lets go of it.
+/// Safe to use from any thread, V itself has to be made thread-safe
+/// by whoever uses it from more than one.
+template<typename K, typename V, typename Hash = std::hash<K>>
+class SharedStore
+{
+public:
+  /**
+   * The value for key. If no one holds one, make() (which returns a
+   * std::shared_ptr<V>) is called to build it, with the store locked,
+   * so it's only built once.
+   */
+  template<typename Make>
+  std::shared_ptr<V> get(const K& key, Make&& make)
+  {
+    std::lock_guard lock {mutex};
+    auto& entry = values[key];
+    if (auto value = entry.lock()) return value;
+    std::shared_ptr<V> value = make();
+    entry = value;
+    // Keep the map from filling up with expired entries
+    if (values.size() > 2 * live_at_prune + 16) prune_locked();
+    return value;
+  }
+  /// Whether there's a value for key that is still held.
+  bool contains(const K& key) const
+  {
+    std::lock_guard lock {mutex};
+    const auto it = values.find(key);
+    return it != values.end() && !it->second.expired();
+  }
+  /// Number of values that are still held.
+  std::size_t size() const
+  {
+    std::lock_guard lock {mutex};
+    std::size_t live = 0;
+    for(const auto& [key, value] : values) live += !value.expired();
+    return live;
+  }
+  void prune()
+  {
+    std::lock_guard lock {mutex};
+    prune_locked();
+  }
+private:
+  void prune_locked()
+  {
+    std::erase_if(values, [](const auto& kv) { return kv.second.expired(); });
+    live_at_prune = values.size();
+  }
+  mutable std::mutex mutex;
+  std::unordered_map<K, std::weak_ptr<V>, Hash> values;
+  std::size_t live_at_prune = 0;
+};
+
+#endif // NVUI_SHARED_STORE_HPP
@@ -0,0 +1,110 @@
+#include "single_instance.hpp"
+#include <exception>
+#include <memory>
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QStringBuilder>
+#include <fmt/core.h>
+#include "instance_message.hpp"
+#include "session_tabs.hpp"
+
+/// How long to wait for the running nvui before starting on our own.
+static constexpr int hand_off_timeout_ms = 1000;
+
+QString single_instance::server_name()
+{
+  // Socket names are global on Windows and may be on Linux
+  const auto user = QCryptographicHash::hash(
+    QDir::homePath().toUtf8(), QCryptographicHash::Sha1
+  ).toHex().left(16);
+  return QStringLiteral("nvui-") % QString::fromLatin1(user);
+}
+
+bool single_instance::hand_off(
+  const QString& name,
+  const std::vector<std::string>& nvim_args
+)
+{
+  QLocalSocket socket;
+  socket.connectToServer(name);
+  if (!socket.waitForConnected(hand_off_timeout_ms)) return false;
+  std::vector<std::string> args;
+  args.reserve(nvim_args.size());
+  for(const auto& arg : nvim_args)
+  {
+    const QFileInfo info {QString::fromStdString(arg)};
+    if (!arg.starts_with("-") && info.exists())
+    {
+      args.push_back(info.absoluteFilePath().toStdString());
+    }
+    else args.push_back(arg);
+  }
+  const auto msg = instance_message::encode(args);
+  socket.write(msg.data(), qint64(msg.size()));
+  if (!socket.waitForBytesWritten(hand_off_timeout_ms)) return false;
+  socket.disconnectFromServer();
+  if (socket.state() != QLocalSocket::UnconnectedState)
+  {
+    socket.waitForDisconnected(hand_off_timeout_ms);
+  }
+  return true;
+}
+
+InstanceServer::InstanceServer(const QString& name, SessionTabs& tabs_)
+  : tabs(tabs_)
+{
+  // Only the user can hand off to it
+  server.setSocketOptions(QLocalServer::UserAccessOption);
+  if (!server.listen(name)
+    && server.serverError() == QAbstractSocket::AddressInUseError)
+  {
+    // Another nvui may have started listening since hand_off.
+    // Only a socket that no one answers on was left behind by one
+    // that crashed, and can be taken over
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(hand_off_timeout_ms))
+    {
+      probe.disconnectFromServer();
+      return;
+    }
+    QLocalServer::removeServer(name);
+    server.listen(name);
+  }
+  QObject::connect(&server, &QLocalServer::newConnection, this, [this] {
+    while(QLocalSocket* socket = server.nextPendingConnection())
+    {
+      // The message is complete once the other side disconnects
+      auto data = std::make_shared<QByteArray>();
+      QObject::connect(socket, &QLocalSocket::readyRead, socket, [socket, data] {
+        data->append(socket->readAll());
+      });
+      QObject::connect(socket, &QLocalSocket::disconnected, this, [this, socket, data] {
+        data->append(socket->readAll());
+        socket->deleteLater();
+        const auto args = instance_message::decode({data->constData(), std::size_t(data->size())});
+        if (args) open(*args);
+      });
+    }
+  });
+}
+
+void InstanceServer::open(const std::vector<std::string>& nvim_args)
+{
+  try
+  {
+    tabs.open_session(nvim_args);
+  }
+  catch (const std::exception& e)
+  {
+    fmt::print("Could not open a new session: {}\n", e.what());
+    return;
+  }
+  QWidget* top = tabs.window();
+  if (top->isMinimized()) top->showNormal();
+  top->raise();
+  top->activateWindow();
+}
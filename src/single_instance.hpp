@@ -0,0 +1,41 @@
+#ifndef NVUI_SINGLE_INSTANCE_HPP
+#define NVUI_SINGLE_INSTANCE_HPP
+
+#include <string>
+#include <vector>
+#include <QLocalServer>
+#include <QObject>
+#include <QString>
+
+class SessionTabs;
+
+/// --single-instance: the first nvui a user starts listens on a
+/// local socket, and the ones started after it hand their files
+/// over to it to be opened in a new tab, then exit.
+namespace single_instance
+{
+  /// Name of the local socket, one per user.
+  QString server_name();
+  /**
+   * Ask the nvui listening on name to open a tab with nvim_args.
+   * File arguments are made absolute, the other nvui may run
+   * in another directory. Returns false if no one is listening.
+   */
+  bool hand_off(const QString& name, const std::vector<std::string>& nvim_args);
+}
+
+/// Opens a tab in tabs for every nvui that hands off to it.
+class InstanceServer : public QObject
+{
+  Q_OBJECT
+public:
+  /// Doesn't listen if another nvui is listening on name already.
+  InstanceServer(const QString& name, SessionTabs& tabs);
+  bool listening() const { return server.isListening(); }
+private:
+  void open(const std::vector<std::string>& nvim_args);
+  QLocalServer server;
+  SessionTabs& tabs;
+};
+
+#endif // NVUI_SINGLE_INSTANCE_HPP
@@ -0,0 +1,93 @@
+#ifndef NVUI_SPSC_QUEUE_HPP
+#define NVUI_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/// A bounded, lock-free single-producer single-consumer queue.
+/// Exactly one thread may push and exactly one (other) thread may pop.
+/// Capacity must be a power of two.
+template<typename T, std::size_t Capacity>
+class SPSCQueue
+{
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+    "Capacity must be a power of two");
+  static constexpr std::size_t mask = Capacity - 1;
+  // Keep the indices on separate cache lines so that the producer and
+  // consumer don't invalidate each other's line on every operation.
+  static constexpr std::size_t cache_line = 64;
+public:
+  SPSCQueue() = default;
+  SPSCQueue(const SPSCQueue&) = delete;
+  SPSCQueue& operator=(const SPSCQueue&) = delete;
+  ~SPSCQueue()
+  {
+    while(try_pop()) {}
+  }
+  /// Push val to the back of the queue.
+  /// Returns false (leaving val untouched) if the queue is full.
+  /// Producer only.
+  bool try_push(T&& val)
+  {
+    const auto tail = tail_idx.load(std::memory_order_relaxed);
+    if (tail - cached_head == Capacity)
+    {
+      cached_head = head_idx.load(std::memory_order_acquire);
+      if (tail - cached_head == Capacity) return false;
+    }
+    new (slot(tail)) T(std::move(val));
+    tail_idx.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+  /// Pop the front of the queue, if there is one.
+  /// Consumer only.
+  std::optional<T> try_pop()
+  {
+    const auto head = head_idx.load(std::memory_order_relaxed);
+    if (head == cached_tail)
+    {
+      cached_tail = tail_idx.load(std::memory_order_acquire);
+      if (head == cached_tail) return std::nullopt;
+    }
+    T* elem = slot(head);
+    std::optional<T> res {std::move(*elem)};
+    elem->~T();
+    head_idx.store(head + 1, std::memory_order_release);
+    return res;
+  }
+  /// Whether the queue looked empty at the time of the call.
+  bool empty() const
+  {
+    return head_idx.load(std::memory_order_acquire)
+      == tail_idx.load(std::memory_order_acquire);
+  }
+  /// Number of elements at the time of the call. Only a hint while
+  /// the other thread is pushing or popping.
+  std::size_t size() const
+  {
+    return tail_idx.load(std::memory_order_acquire)
+      - head_idx.load(std::memory_order_acquire);
+  }
+  static constexpr std::size_t capacity() { return Capacity; }
+private:
+  T* slot(std::size_t idx)
+  {
+    return std::launder(reinterpret_cast<T*>(&storage[idx & mask]));
+  }
+  std::aligned_storage_t<sizeof(T), alignof(T)> storage[Capacity];
+  /// Next slot to pop, written by the consumer.
+  alignas(cache_line) std::atomic<std::size_t> head_idx {0};
+  /// The consumer's last view of tail_idx.
+  std::size_t cached_tail = 0;
+  /// Next slot to push to, written by the producer.
+  alignas(cache_line) std::atomic<std::size_t> tail_idx {0};
+  /// The producer's last view of head_idx.
+  std::size_t cached_head = 0;
+};
+
+#endif // NVUI_SPSC_QUEUE_HPP
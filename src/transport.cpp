@@ -0,0 +1,307 @@
+#define BOOST_PROCESS_WINDOWS_USE_NAMED_PIPE
+#include "transport.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <boost/asio.hpp>
+#include <boost/process.hpp>
+#include <fmt/format.h>
+
+#ifdef _WIN32
+#include <boost/process/windows.hpp>
+#else
+#include <unistd.h>
+#endif
+
+namespace asio = boost::asio;
+namespace bp = boost::process;
+
+namespace
+{
+  /// Keeps reading from stream into buffer() until that fails
+  /// (it was closed, or the other end was), then calls done.
+  template<typename Stream, typename Done>
+  void read_until_closed(
+    Stream& stream,
+    const Transport::buffer_fn& buffer,
+    const Transport::read_fn& on_read,
+    Done done
+  )
+  {
+    const auto area = buffer();
+    stream.async_read_some(
+      asio::buffer(area.data(), area.size()),
+      [&stream, &buffer, &on_read, done = std::move(done)](
+        const boost::system::error_code& ec, std::size_t n
+      ) mutable {
+        if (n > 0) on_read(n);
+        if (ec) done();
+        else read_until_closed(stream, buffer, on_read, std::move(done));
+      }
+    );
+  }
+
+  /// Runs everything on one I/O thread, which sleeps in the OS until
+  /// there's something to do.
+  class AsioTransport : public Transport
+  {
+  public:
+    ~AsioTransport() override
+    {
+      // Derived classes close their streams in their destructor
+      join();
+    }
+  protected:
+    void run()
+    {
+      io_thread = std::thread([this] { io.run(); });
+    }
+    /// Run f on the I/O thread, after the handlers before it.
+    template<typename F>
+    void post(F&& f) { asio::post(io, std::forward<F>(f)); }
+    /// Wait for the handlers that are left (e.g. cancelled reads).
+    void join()
+    {
+      work.reset();
+      if (io_thread.joinable()) io_thread.join();
+    }
+    asio::io_context io;
+    /// Keeps io.run() going until join(), even when no reads are
+    /// pending, so that posted work always runs.
+    asio::executor_work_guard<asio::io_context::executor_type> work =
+      asio::make_work_guard(io);
+    buffer_fn buffer;
+    read_fn on_read;
+    closed_fn on_closed;
+  private:
+    std::thread io_thread;
+  };
+
+  /// Neovim as a child process, usually with "--embed".
+  class ChildTransport : public AsioTransport
+  {
+  public:
+    ChildTransport(
+      const boost::filesystem::path& path,
+      const std::vector<std::string>& args
+    )
+    {
+      child = bp::child(
+        path,
+        args,
+        bp::std_out > stdout_pipe,
+        bp::std_in < stdin_pipe,
+        bp::std_err > stderr_pipe,
+        group
+#ifdef _WIN32
+        , bp::windows::create_no_window
+#endif
+      );
+    }
+    ~ChildTransport() override { close(); }
+    void start(buffer_fn b, read_fn r, closed_fn c) override
+    {
+      buffer = std::move(b);
+      on_read = std::move(r);
+      on_closed = std::move(c);
+      read_until_closed(stdout_pipe, buffer, on_read, [this] { on_closed(); });
+      read_until_closed(stderr_pipe, error_buffer, print_error, [] {});
+      run();
+    }
+    void write(std::string_view data) override
+    {
+      // Only the writer thread uses stdin
+      asio::write(stdin_pipe, asio::buffer(data.data(), data.size()));
+    }
+    bool running() override { return child.running(); }
+    int exit_code() override
+    {
+      if (child.running()) return INT_MIN;
+      return child.exit_code();
+    }
+    void stop() override { child.terminate(); }
+    void close() override
+    {
+      if (closed.exchange(true)) return;
+      post([this] {
+        boost::system::error_code ec;
+        stdout_pipe.close(ec);
+        stderr_pipe.close(ec);
+        stdin_pipe.close(ec);
+      });
+      join();
+    }
+  private:
+    std::atomic<bool> closed = false;
+    bp::group group;
+    bp::child child;
+    bp::async_pipe stdout_pipe {io};
+    bp::async_pipe stdin_pipe {io};
+    bp::async_pipe stderr_pipe {io};
+    std::vector<char> error_data = std::vector<char>(4096);
+    buffer_fn error_buffer = [this] {
+      return std::span {error_data.data(), error_data.size()};
+    };
+    read_fn print_error = [this](std::size_t n) {
+      std::cout << "Error occurred: " << std::string_view(error_data.data(), n) << '\n';
+    };
+  };
+
+  /// Another handle to the socket handle, which can be used
+  /// from another thread than the original.
+  template<typename Socket>
+  typename Socket::native_handle_type duplicate_handle(Socket& socket)
+  {
+#ifdef _WIN32
+    WSAPROTOCOL_INFOW info;
+    if (WSADuplicateSocketW(socket.native_handle(), GetCurrentProcessId(), &info) == 0)
+    {
+      const SOCKET dup = WSASocketW(
+        FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO,
+        &info, 0, WSA_FLAG_OVERLAPPED
+      );
+      if (dup != INVALID_SOCKET) return dup;
+    }
+    const int err = WSAGetLastError();
+#else
+    const int dup = ::dup(socket.native_handle());
+    if (dup != -1) return dup;
+    const int err = errno;
+#endif
+    throw boost::system::system_error(err, boost::system::system_category());
+  }
+
+  /// A Neovim server listening on a socket. Disconnecting
+  /// leaves it running.
+  /// Reads happen on the I/O thread, writes block the writer thread
+  /// on their own handle to the socket, so they don't wait for the
+  /// I/O thread (which waits for the GUI while it's behind, see
+  /// Window::register_handlers).
+  template<typename Protocol>
+  class SocketTransport : public AsioTransport
+  {
+  public:
+    ~SocketTransport() override { close(); }
+    void start(buffer_fn b, read_fn r, closed_fn c) override
+    {
+      buffer = std::move(b);
+      on_read = std::move(r);
+      on_closed = std::move(c);
+      write_socket.assign(
+        socket.local_endpoint().protocol(), duplicate_handle(socket)
+      );
+      read_until_closed(socket, buffer, on_read, [this] {
+        connected = false;
+        on_closed();
+      });
+      run();
+    }
+    void write(std::string_view data) override
+    {
+      // Only the writer thread uses write_socket. It shares the
+      // non-blocking mode the reads set, which asio waits out.
+      asio::write(write_socket, asio::buffer(data.data(), data.size()));
+    }
+    bool running() override { return connected; }
+    void close() override
+    {
+      if (closed.exchange(true)) return;
+      post([this] {
+        boost::system::error_code ec;
+        socket.shutdown(asio::socket_base::shutdown_both, ec);
+        socket.close(ec);
+      });
+      join();
+      // The writer thread is done by now
+      boost::system::error_code ec;
+      write_socket.close(ec);
+    }
+    typename Protocol::socket socket {io};
+  private:
+    /// Never run, blocking writes don't need it.
+    asio::io_context write_io;
+    typename Protocol::socket write_socket {write_io};
+    std::atomic<bool> connected = true;
+    std::atomic<bool> closed = false;
+  };
+
+  /// Whether address looks like "host:port".
+  bool is_tcp_address(std::string_view address)
+  {
+    const auto colon = address.rfind(':');
+    if (colon == std::string_view::npos || colon + 1 == address.size())
+    {
+      return false;
+    }
+    const auto port = address.substr(colon + 1);
+    return std::all_of(port.begin(), port.end(), [](unsigned char c) {
+      return std::isdigit(c);
+    });
+  }
+}
+
+std::unique_ptr<Transport> spawn_nvim(
+  std::string path,
+  std::vector<std::string> args
+)
+{
+  auto nvim_path = boost::filesystem::path(path);
+  if (path.empty())
+  {
+    nvim_path = bp::search_path("nvim");
+    if (nvim_path.empty())
+    {
+      throw std::runtime_error("Neovim not found in PATH");
+    }
+  }
+  return std::make_unique<ChildTransport>(nvim_path, args);
+}
+
+std::unique_ptr<Transport> connect_to_server(const std::string& address)
+{
+  try
+  {
+    if (is_tcp_address(address))
+    {
+      using asio::ip::tcp;
+      const auto colon = address.rfind(':');
+      std::string host = address.substr(0, colon);
+      // [::1]:6666
+      if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+      {
+        host = host.substr(1, host.size() - 2);
+      }
+      if (host.empty()) host = "localhost";
+      asio::io_context resolver_io;
+      tcp::resolver resolver {resolver_io};
+      const auto endpoints = resolver.resolve(host, address.substr(colon + 1));
+      auto transport = std::make_unique<SocketTransport<tcp>>();
+      asio::connect(transport->socket, endpoints);
+      // The writer already sends everything that's queued in one
+      // write, so Nagle's algorithm would only delay keystrokes
+      transport->socket.set_option(tcp::no_delay(true));
+      return transport;
+    }
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    using local = asio::local::stream_protocol;
+    auto transport = std::make_unique<SocketTransport<local>>();
+    transport->socket.connect(local::endpoint(address));
+    return transport;
+#endif
+  }
+  catch (const boost::system::system_error& e)
+  {
+    throw std::runtime_error(
+      fmt::format("Could not connect to {}: {}", address, e.what())
+    );
+  }
+  throw std::runtime_error(
+    fmt::format("Could not connect to {}: expected host:port", address)
+  );
+}
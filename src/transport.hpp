@@ -0,0 +1,66 @@
+#ifndef NVUI_TRANSPORT_HPP
+#define NVUI_TRANSPORT_HPP
+
+#include <climits>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// The connection Nvim exchanges msgpack-rpc data with Neovim over.
+/// Reads are asynchronous and happen on the transport's own I/O
+/// thread, which waits on the OS (epoll, IOCP, ...) instead of polling.
+/// Writes come from Nvim's writer thread.
+class Transport
+{
+public:
+  /// Where the next read goes.
+  using buffer_fn = std::function<std::span<char> ()>;
+  /// n bytes were read into the last buffer.
+  using read_fn = std::function<void (std::size_t n)>;
+  /// The connection ended.
+  using closed_fn = std::function<void ()>;
+  virtual ~Transport() = default;
+  /**
+   * Start reading. The callbacks are called on the I/O thread, and
+   * on_closed is called once, when Neovim exits, the connection is
+   * lost or close() is called.
+   */
+  virtual void start(buffer_fn buffer, read_fn on_read, closed_fn on_closed) = 0;
+  /// Write all of data. Throws if that's not possible.
+  virtual void write(std::string_view data) = 0;
+  /// Whether Neovim can still be talked to.
+  virtual bool running() = 0;
+  /// Neovim's exit code, INT_MIN if it's still running or if
+  /// it isn't known.
+  virtual int exit_code() { return INT_MIN; }
+  /// Stop Neovim, if it belongs to us.
+  virtual void stop() {}
+  /// Close the connection, cancelling the reads, and wait for the
+  /// I/O thread to finish.
+  virtual void close() = 0;
+};
+
+/**
+ * Start Neovim as a child process and talk to it over its standard
+ * input and output. If path is empty, "nvim" is looked up in PATH.
+ * Throws std::runtime_error if Neovim can't be found.
+ */
+std::unique_ptr<Transport> spawn_nvim(
+  std::string path,
+  std::vector<std::string> args
+);
+
+/**
+ * Connect to a Neovim server that's already running, e.g. one started
+ * with "nvim --headless --listen <address>".
+ * An address of the form "host:port" is a TCP address, anything
+ * else is the path of a Unix domain socket.
+ * Throws std::runtime_error if the connection can't be made.
+ */
+std::unique_ptr<Transport> connect_to_server(const std::string& address);
+
+#endif // NVUI_TRANSPORT_HPP
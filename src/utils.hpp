@@ -2,6 +2,7 @@
 #define NVUI_UTILS_HPP
 #include <QCoreApplication>
 #include <QIcon>
+#include <QImage>
 #include <QString>
 #include <QFile>
 #include <QStringBuilder>
@@ -73,6 +74,36 @@ inline std::optional<QPixmap> pixmap_from_svg(
   return filled;
 }
 
+/// Same as pixmap_from_svg, but renders to a QImage so that
+/// it can be called from any thread.
+inline std::optional<QImage> image_from_svg(
+  const QString& filename,
+  const QColor& foreground,
+  const QColor& background = Qt::transparent,
+  int width = 0,
+  int height = 0
+)
+{
+  QFile file {filename};
+  if (!file.exists()) return std::nullopt;
+  file.open(QIODevice::ReadOnly);
+  QSvgRenderer renderer {file.readAll()};
+  QImage img {width, height, QImage::Format_ARGB32_Premultiplied};
+  if (img.isNull()) return std::nullopt;
+  img.fill(Qt::transparent);
+  QPainter p(&img);
+  renderer.render(&p);
+  p.setCompositionMode(QPainter::CompositionMode_SourceIn);
+  p.fillRect(img.rect(), foreground);
+  p.end();
+  if (background.alpha() == 0) return img;
+  QImage filled {width, height, QImage::Format_ARGB32_Premultiplied};
+  filled.fill(background);
+  QPainter painter(&filled);
+  painter.drawImage(filled.rect(), img, img.rect());
+  return filled;
+}
+
 // Macro to time how long something takes
 // using std::chrono (only in debug mode)
 #ifndef NDEBUG
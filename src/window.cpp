@@ -4,6 +4,7 @@
 #include <cassert>
 #include <chrono>
 #include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <QObject>
 #include <QLabel>
@@ -15,6 +16,7 @@
 #include <QPixmap>
 #include <QScreen>
 #include <QIcon>
+#include <QThread>
 #include <QWindow>
 #include <QSizeGrip>
 #include <sstream>
@@ -131,28 +133,89 @@ Window::Window(QWidget* parent, Nvim* nv, int width, int height, bool custom_tit
 
 void Window::handle_redraw(Object redraw_args)
 {
+  GridLines lines;
+  lines.decode(redraw_args);
+  handle_redraw(redraw_args, lines);
+}
+
+bool Window::handle_redraw(Object& redraw_args, GridLines& lines)
+{
+  current_lines = &lines;
   auto* arr = redraw_args.array();
   assert(arr && arr->size() >= 3);
   auto* args = arr->at(2).array();
   assert(args);
+  auto& perf = editor_area.perf_stats();
+  bool allocated = false;
+  perf.redraw_batches.fetch_add(1, std::memory_order_relaxed);
+  perf.redraw_events.fetch_add(args->size(), std::memory_order_relaxed);
   for(auto& o : *args)
   {
     auto* task = o.array();
     if (!task || task->size() == 0) continue;
-    auto* task_name = task->at(0).string();
-    if (!task_name) continue;
-    const auto func_it = handlers.find(*task_name);
-    if (func_it != handlers.end())
+    // The name is still borrowed from the read buffer,
+    // so decoding it doesn't build a string
+    const auto name = task->at(0).str();
+    if (!name) continue;
+    const auto event = redraw_events::from_name(*name);
+    obj_ref_cb handler = nullptr;
+    if (event != RedrawEvent::Unknown) handler = event_handlers[std::size_t(event)];
+    else if (auto it = handlers.find(std::string(*name)); it != handlers.end())
+    {
+      handler = it->second;
+    }
+    if (!handler) continue;
+    // grid_line was decoded already,
+    // everything else gets its own copy.
+    if (event != RedrawEvent::grid_line) allocated |= o.make_owned();
+    auto span = std::span {task->data() + 1, task->size() - 1};
+    handler(this, span);
+  }
+  current_lines = nullptr;
+  return allocated;
+}
+
+bool Window::write_latency_trace(const std::string& path)
+{
+  std::ofstream out {path, std::ios::binary | std::ios::trunc};
+  if (!out) return false;
+  out << editor_area.latency_trace().chrome_trace();
+  return bool(out);
+}
+
+void Window::schedule_redraw_drain()
+{
+  if (redraw_drain_scheduled.exchange(true, std::memory_order_acq_rel)) return;
+  QMetaObject::invokeMethod(this, [this] { drain_redraw_queue(); }, Qt::QueuedConnection);
+}
+
+void Window::drain_redraw_queue()
+{
+  // Reset first, anything pushed after this point schedules
+  // another drain
+  redraw_drain_scheduled.store(false, std::memory_order_release);
+  editor_area.perf_stats().queue_depth = redraw_queue.size();
+  while(auto batch = redraw_queue.try_pop())
+  {
+    if (redraw_writer_waiting.load())
+    {
+      std::lock_guard lock {redraw_space_mutex};
+      redraw_space.notify_one();
+    }
+    // Unless the batch got strings of its own, its arena
+    // frees it without a walk over every node
+    if (handle_redraw(batch->view.obj, batch->lines))
     {
-      auto span = std::span {task->data() + 1, task->size() - 1};
-      func_it->second(this, span);
+      batch->view.arena_only = false;
     }
   }
 }
 
 void Window::set_handler(std::string method, obj_ref_cb handler)
 {
-  handlers[method] = handler;
+  const auto event = redraw_events::from_name(method);
+  if (event != RedrawEvent::Unknown) event_handlers[std::size_t(event)] = handler;
+  else handlers[method] = handler;
 }
 
 void Window::register_handlers()
@@ -174,7 +237,8 @@ void Window::register_handlers()
     emit w->default_colors_changed(fg, bg);
   });
   set_handler("grid_line", [](Window* w, std::span<const Object> objs) {
-    w->editor_area.grid_line(objs);
+    assert(w->current_lines);
+    w->editor_area.grid_line(*w->current_lines, objs.size());
   });
   set_handler("option_set", [](Window* w, std::span<const Object> objs) {
     w->editor_area.option_set(objs);
@@ -271,12 +335,41 @@ void Window::register_handlers()
   // The lambda will get invoked on the Nvim::read_output thread, we use
   // invokeMethod to then handle the data on our Qt thread.
   assert(nvim);
-  nvim->set_notification_handler("redraw", [this](Object obj) {
-    QMetaObject::invokeMethod(
-      this, [this, o = std::move(obj)] {
-        handle_redraw(std::move(o));
+  // Redraw batches borrow their strings from Nvim's read buffer,
+  // the view keeps it alive until the batch has been handled.
+  nvim->set_latency_trace(&editor_area.latency_trace());
+  nvim->set_borrowed_notification_handler("redraw", [this](ObjectView view) {
+    editor_area.latency_trace().mark(LatencyTrace::Redraw);
+    // Redraw events from before the handlers were set are
+    // replayed on our thread (see Nvim::resume_notifications)
+    if (QThread::currentThread() == thread())
+    {
+      handle_redraw(std::move(view.obj));
+      return;
+    }
+    // Decoding the cells doesn't need the grids,
+    // so it doesn't have to wait for the GUI thread
+    RedrawBatch batch {std::move(view), {}};
+    batch.lines.decode(batch.view.obj);
+    // If the GUI thread is behind, wait for it to make room
+    // (the drain that's pending wakes us up)
+    if (!redraw_queue.try_push(std::move(batch)))
+    {
+      schedule_redraw_drain();
+      std::unique_lock lock {redraw_space_mutex};
+      redraw_writer_waiting.store(true);
+      while(!redraw_queue.try_push(std::move(batch)))
+      {
+        if (!nvim->running())
+        {
+          redraw_writer_waiting.store(false);
+          return;
+        }
+        redraw_space.wait_for(lock, std::chrono::milliseconds(50));
       }
-    );
+      redraw_writer_waiting.store(false);
+    }
+    schedule_redraw_drain();
   });
   using notification = const ObjectArray&;
   listen_for_notification("NVUI_WINOPACITY", paramify<float>([this](double opacity) {
@@ -534,6 +627,29 @@ void Window::register_handlers()
     paramify<bool>([this](bool b) {
       nvim->ui_set_option("ext_cmdline", b);
   }));
+  listen_for_notification("NVUI_PERF_HUD", paramify<bool>([this](bool b) {
+    editor_area.set_perf_hud_visible(b);
+  }));
+  listen_for_notification("NVUI_PERF_HUD_TOGGLE", [this](const auto&) {
+    editor_area.toggle_perf_hud();
+  });
+  listen_for_notification("NVUI_SUSPEND_WHEN_HIDDEN", paramify<bool>([this](bool b) {
+    suspend_when_hidden = b;
+    update_suspended();
+  }));
+  listen_for_notification("NVUI_MEMORY_BUDGET", paramify<double>([this](double mb) {
+    editor_area.set_memory_budget(std::size_t(std::max(mb, 0.) * 1024 * 1024));
+  }));
+  listen_for_notification("NVUI_LATENCY_TRACE", paramify<bool>([this](bool b) {
+    editor_area.latency_trace().set_enabled(b);
+  }));
+  listen_for_notification("NVUI_LATENCY_EXPORT",
+    paramify<QString>([this](QString path) {
+      if (!write_latency_trace(path.toStdString()))
+      {
+        fmt::print("Could not write the latency trace to {}\n", path.toStdString());
+      }
+  }));
   /// Add request handlers
   handle_request<std::vector<std::string>, std::string>(
     "NVUI_POPUPMENU_ICON_NAMES", [&](const ObjectArray& arr) {
@@ -550,6 +666,28 @@ void Window::register_handlers()
       return std::tuple {scaler_names, std::nullopt};
     }
   );
+  handle_request<std::unordered_map<std::string, double>, std::string>(
+    "NVUI_PERF_STATS", [&](const ObjectArray& arr) {
+      Q_UNUSED(arr);
+      auto report = editor_area.perf_report();
+      std::unordered_map<std::string, double> stats(report.begin(), report.end());
+      return std::tuple {stats, std::nullopt};
+    }
+  );
+  handle_request<std::unordered_map<std::string, double>, std::string>(
+    "NVUI_LATENCY_STATS", [&](const ObjectArray& arr) {
+      Q_UNUSED(arr);
+      auto report = editor_area.latency_trace().report();
+      std::unordered_map<std::string, double> stats(report.begin(), report.end());
+      return std::tuple {stats, std::nullopt};
+    }
+  );
+  handle_request<std::string, std::string>(
+    "NVUI_LATENCY_REPORT", [&](const ObjectArray& arr) {
+      Q_UNUSED(arr);
+      return std::tuple {editor_area.latency_trace().format_report(), std::nullopt};
+    }
+  );
   auto script_dir = constants::script_dir().toStdString();
   nvim->command(fmt::format("set rtp+={}", script_dir));
   nvim->command("runtime! plugin/nvui.vim");
@@ -701,6 +839,40 @@ void Window::resizeEvent(QResizeEvent* event)
   QMainWindow::resizeEvent(event);
 }
 
+void Window::showEvent(QShowEvent* event)
+{
+  // The window handle exists once the window is shown. Its expose
+  // events tell when the window is occluded or on another desktop,
+  // where the platform reports it
+  if (QWindow* handle = window()->windowHandle()) handle->installEventFilter(this);
+  QMainWindow::showEvent(event);
+  update_suspended();
+}
+
+void Window::hideEvent(QHideEvent* event)
+{
+  QMainWindow::hideEvent(event);
+  update_suspended();
+}
+
+bool Window::eventFilter(QObject* watched, QEvent* event)
+{
+  if (event->type() == QEvent::Expose && watched == window()->windowHandle())
+  {
+    update_suspended();
+  }
+  return QMainWindow::eventFilter(watched, event);
+}
+
+void Window::update_suspended()
+{
+  const QWindow* handle = window()->windowHandle();
+  const bool hidden = !isVisible()
+    || window()->isMinimized()
+    || (handle && !handle->isExposed());
+  editor_area.set_suspended(suspend_when_hidden && hidden);
+}
+
 void Window::moveEvent(QMoveEvent* event)
 {
 #ifdef Q_OS_WIN
@@ -827,6 +999,7 @@ void Window::changeEvent(QEvent* event)
     emit win_state_changed(windowState());
     auto ev = static_cast<QWindowStateChangeEvent*>(event);
     prev_state = ev->oldState();
+    update_suspended();
   }
 #ifdef Q_OS_WIN
     if ((windowState() & Qt::WindowMaximized) && is_frameless())
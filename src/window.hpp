@@ -12,8 +12,14 @@
 #include "editor.hpp"
 #include "titlebar.hpp"
 #include "hlstate.hpp"
+#include "redraw_events.hpp"
+#include "spsc_queue.hpp"
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <span>
 #include <msgpack.hpp>
 #include <QEvent>
@@ -60,6 +66,21 @@ public:
    * in Neovim's redraw notification.
    */
   void set_handler(std::string method, obj_ref_cb handler);
+  /**
+   * The editor area, for rendering it offscreen (see nvui_bench).
+   */
+  EditorArea& editor() { return editor_area; }
+  /// Write the key-to-photon latency trace to path as Chrome trace
+  /// JSON. Returns false if the file couldn't be written.
+  bool write_latency_trace(const std::string& path);
+  /**
+   * Suspend the editor area while the window can't be seen
+   * (see EditorArea::set_suspended), unless it's turned off
+   * with NVUI_SUSPEND_WHEN_HIDDEN. A window that's a tab (see
+   * SessionTabs) can't be seen when its tab isn't the current one,
+   * or when the top-level window can't be.
+   */
+  void update_suspended();
 public slots:
   /**
    * Handles a 'redraw' Neovim notification.
@@ -126,6 +147,7 @@ private:
   {
     title_bar->hide();
   }
+  bool suspend_when_hidden = true;
   
   /**
    * Shows the titlebar. Only activates if the window is a
@@ -159,6 +181,40 @@ private:
    * Otherwise, it uses the default colors.
    */
   void update_titlebar_colors();
+  /**
+   * Queue a drain of redraw_queue on the GUI thread, unless one is
+   * already pending. Called from Nvim's reader thread.
+   */
+  void schedule_redraw_drain();
+  /**
+   * Handle every redraw batch that has been queued so far.
+   */
+  void drain_redraw_queue();
+  /// Handles a redraw notification whose grid_line events
+  /// have already been decoded into lines. Returns whether
+  /// redraw_args was given memory of its own while doing so,
+  /// which its arena doesn't free.
+  bool handle_redraw(Object& redraw_args, GridLines& lines);
+  /// The lines of the batch being handled, for the grid_line handler.
+  GridLines* current_lines = nullptr;
+  /// A redraw notification, with its grid_line events decoded
+  /// by the reader thread.
+  struct RedrawBatch
+  {
+    ObjectView view;
+    GridLines lines;
+  };
+  /// Redraw batches on their way from the reader thread to the GUI
+  /// thread. The reader only wakes up the GUI thread when it isn't
+  /// awake already, so a burst of batches is handled in a single
+  /// event, and only presented once.
+  SPSCQueue<RedrawBatch, 256> redraw_queue;
+  std::atomic<bool> redraw_drain_scheduled = false;
+  /// The reader waits on redraw_space while redraw_queue is full,
+  /// each batch the GUI thread takes out wakes it up.
+  std::mutex redraw_space_mutex;
+  std::condition_variable redraw_space;
+  std::atomic<bool> redraw_writer_waiting = false;
   QSemaphore semaphore;
   bool resizing;
   bool maximized = false;
@@ -166,6 +222,9 @@ private:
   std::unique_ptr<TitleBar> title_bar;
   HLState hl_state;
   Nvim* nvim;
+  /// Handlers for the redraw events in RedrawEvent, indexed by event.
+  std::array<obj_ref_cb, redraw_events::count> event_handlers {};
+  /// Handlers for any other redraw event.
   std::unordered_map<std::string, obj_ref_cb> handlers;
   QFlags<Qt::WindowState> prev_state;
   template<typename T>
@@ -188,6 +247,10 @@ protected:
   void mouseMoveEvent(QMouseEvent* event) override;
   void resizeEvent(QResizeEvent* event) override;
   void moveEvent(QMoveEvent* event) override;
+  void showEvent(QShowEvent* event) override;
+  void hideEvent(QHideEvent* event) override;
+  /// Watches the expose events of windowHandle().
+  bool eventFilter(QObject* watched, QEvent* event) override;
 };
 
 #endif // NVUI_WINDOW_HPP
@@ -10,6 +10,7 @@
 #include <QPainter>
 #include <QImage>
 #include <QSize>
+#include <chrono>
 #include <limits>
 #include <unordered_set>
 #include <windows.h>
@@ -269,6 +270,7 @@ protected:
   void paintEvent(QPaintEvent* event) override
   {
     event->accept();
+    const auto frame_start = std::chrono::steady_clock::now();
     device_context->BeginDraw();
     auto bg = default_bg().rgb();
     ID2D1SolidColorBrush* bg_brush = nullptr;
@@ -295,13 +297,19 @@ protected:
     device_context->EndDraw();
     if (!popup_menu.hidden()) draw_popup_menu();
     else popup_menu.hide();
+    const auto frame_end = std::chrono::steady_clock::now();
+    perf.add_frame(std::chrono::duration<double, std::milli>(
+      frame_end - frame_start
+    ).count());
+    perf.frame_painted(frame_end);
+    latency.mark(LatencyTrace::Present, frame_end);
   }
 
   void resizeEvent(QResizeEvent* event) override
   {
     auto sz = D2D1::SizeU(event->size().width(), event->size().height());
     hwnd_target->Resize(sz);
-    update();
+    EditorArea::resizeEvent(event);
   }
 };
 
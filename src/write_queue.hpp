@@ -0,0 +1,130 @@
+#ifndef NVUI_WRITE_QUEUE_HPP
+#define NVUI_WRITE_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/// Messages waiting to be written to Neovim's stdin.
+/// Any thread can push, and a single writer thread takes everything
+/// that's queued at once and writes it out in one go, so callers never
+/// block on the pipe.
+/// Keyboard input and mouse drags are kept unpacked so that they can be
+/// merged with the message before them:
+/// - Consecutive nvim_input calls become one call with the keys
+///   appended.
+/// - Consecutive drags (same button, modifiers and grid) only keep the
+///   latest position.
+/// Everything else is packed by the caller into a buffer from
+/// acquire(), which the writer gives back with recycle() once written.
+class WriteQueue
+{
+public:
+  /// A fully packed msgpack-rpc message.
+  using Buffer = std::string;
+  struct Input
+  {
+    std::string keys;
+  };
+  struct Mouse
+  {
+    std::string button;
+    std::string action;
+    std::string modifiers;
+    int grid;
+    int row;
+    int col;
+  };
+  using Item = std::variant<Buffer, Input, Mouse>;
+
+  /// Returns an empty buffer, reusing the memory of a previously
+  /// written one if there is one.
+  Buffer acquire()
+  {
+    std::lock_guard lock {mutex};
+    if (pool.empty()) return {};
+    Buffer buf = std::move(pool.back());
+    pool.pop_back();
+    return buf;
+  }
+  /// Give a written buffer back to the pool.
+  void recycle(Buffer buf)
+  {
+    buf.clear();
+    std::lock_guard lock {mutex};
+    if (pool.size() < max_pooled) pool.push_back(std::move(buf));
+  }
+  void push(Buffer packed)
+  {
+    {
+      std::lock_guard lock {mutex};
+      items.emplace_back(std::move(packed));
+    }
+    cv.notify_one();
+  }
+  void push_input(std::string_view keys)
+  {
+    {
+      std::lock_guard lock {mutex};
+      Input* last = items.empty() ? nullptr : std::get_if<Input>(&items.back());
+      if (last) last->keys.append(keys);
+      else items.emplace_back(Input {std::string(keys)});
+    }
+    cv.notify_one();
+  }
+  void push_mouse(Mouse mouse)
+  {
+    {
+      std::lock_guard lock {mutex};
+      Mouse* last = items.empty() ? nullptr : std::get_if<Mouse>(&items.back());
+      if (last && is_drag(*last) && is_drag(mouse)
+        && last->button == mouse.button
+        && last->modifiers == mouse.modifiers
+        && last->grid == mouse.grid)
+      {
+        last->row = mouse.row;
+        last->col = mouse.col;
+      }
+      else items.emplace_back(std::move(mouse));
+    }
+    cv.notify_one();
+  }
+  /// Waits until there is something to write (or the queue is closed),
+  /// then swaps the queued items into out (which should be empty).
+  /// Returns false once the queue is closed and everything has been
+  /// taken.
+  /// Writer only.
+  bool wait_and_take(std::vector<Item>& out)
+  {
+    std::unique_lock lock {mutex};
+    cv.wait(lock, [this] { return closed || !items.empty(); });
+    if (items.empty()) return false;
+    items.swap(out);
+    return true;
+  }
+  /// Wake up the writer. wait_and_take returns false once the rest of
+  /// the queue has been taken.
+  void close()
+  {
+    {
+      std::lock_guard lock {mutex};
+      closed = true;
+    }
+    cv.notify_all();
+  }
+private:
+  static bool is_drag(const Mouse& m) { return m.action == "drag"; }
+  static constexpr std::size_t max_pooled = 16;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<Item> items;
+  std::vector<Buffer> pool;
+  bool closed = false;
+};
+
+#endif // NVUI_WRITE_QUEUE_HPP
@@ -0,0 +1,51 @@
+#include <catch2/catch.hpp>
+#include "cmdline_layout.hpp"
+
+static CmdLineLayout layout_of(std::size_t chars, int advance)
+{
+  CmdLineLayout layout;
+  for(std::size_t i = 0; i < chars; ++i) layout.push(advance);
+  return layout;
+}
+
+TEST_CASE("CmdLineLayout wraps characters that don't fit", "[cmdline_layout]")
+{
+  // 25 characters of width 10, rows can fit 10, except the first
+  // which starts after a 20 wide prompt
+  auto layout = layout_of(25, 10);
+  layout.wrap(20, 0, 100);
+  REQUIRE(layout.rows() == 3);
+  REQUIRE(layout.row_range(0) == std::pair<std::size_t, std::size_t>(0, 8));
+  REQUIRE(layout.row_range(1) == std::pair<std::size_t, std::size_t>(8, 18));
+  REQUIRE(layout.row_range(2) == std::pair<std::size_t, std::size_t>(18, 25));
+  REQUIRE(layout.position(0) == std::pair<std::size_t, int>(0, 20));
+  REQUIRE(layout.position(7) == std::pair<std::size_t, int>(0, 90));
+  REQUIRE(layout.position(8) == std::pair<std::size_t, int>(1, 0));
+  // The end of the line
+  REQUIRE(layout.position(25) == std::pair<std::size_t, int>(2, 70));
+  SECTION("Rewrapping only depends on the width")
+  {
+    layout.wrap(20, 0, 1000);
+    REQUIRE(layout.rows() == 1);
+    layout.wrap(20, 0, 100);
+    REQUIRE(layout.rows() == 3);
+  }
+  SECTION("Truncating keeps the earlier advances")
+  {
+    layout.truncate(5);
+    layout.push(30);
+    REQUIRE(layout.size() == 6);
+    layout.wrap(0, 0, 100);
+    REQUIRE(layout.rows() == 1);
+    REQUIRE(layout.position(6).second == 80);
+  }
+}
+
+TEST_CASE("An empty CmdLineLayout is one row", "[cmdline_layout]")
+{
+  CmdLineLayout layout;
+  layout.wrap(5, 0, 100);
+  REQUIRE(layout.size() == 0);
+  REQUIRE(layout.rows() == 1);
+  REQUIRE(layout.position(0) == std::pair<std::size_t, int>(0, 5));
+}
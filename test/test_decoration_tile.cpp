@@ -0,0 +1,73 @@
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include "decoration_tile.hpp"
+
+TEST_CASE("Undercurl tiles span one cell", "[decoration_tile]")
+{
+  const auto u = decoration::undercurl(8.4f, 18.f);
+  REQUIRE(u.period == 8);
+  REQUIRE(u.amplitude == 3.f);
+  REQUIRE(u.height == 4);
+  const auto small = decoration::undercurl(5.f, 10.f);
+  REQUIRE(small.amplitude == 2.f);
+  REQUIRE(small.height == 3);
+}
+
+TEST_CASE("Undercurl coverage follows the wave", "[decoration_tile]")
+{
+  const auto u = decoration::undercurl(8.f, 18.f);
+  const auto cov = decoration::coverage(u);
+  REQUIRE(cov.size() == std::size_t(u.period * u.height));
+  const auto at = [&](int x, int y) { return cov[std::size_t(y * u.period + x)]; };
+  // Top at the edges of the cell, bottom in the middle of it
+  REQUIRE(at(0, 1) > 0);
+  REQUIRE(at(0, 3) == 0);
+  REQUIRE(at(4, 3) > 0);
+  REQUIRE(at(4, 0) == 0);
+  SECTION("Every column is covered")
+  {
+    for(int x = 0; x < u.period; ++x)
+    {
+      int column = 0;
+      for(int y = 0; y < u.height; ++y) column += at(x, y);
+      REQUIRE(column > 0);
+    }
+  }
+  SECTION("Tiles join up seamlessly")
+  {
+    // The wave is symmetric about the middle of the cell
+    for(int y = 0; y < u.height; ++y)
+    {
+      REQUIRE(at(0, y) == at(u.period - 1, y));
+    }
+  }
+}
+
+TEST_CASE("Undercurl tile pixels are premultiplied", "[decoration_tile]")
+{
+  const auto u = decoration::undercurl(8.f, 18.f);
+  const auto cov = decoration::coverage(u);
+  const auto px = decoration::pixels(u, 0xff8000);
+  REQUIRE(px.size() == cov.size());
+  for(std::size_t i = 0; i < px.size(); ++i)
+  {
+    const auto a = px[i] >> 24;
+    REQUIRE(a == cov[i]);
+    REQUIRE(((px[i] >> 16) & 0xff) == a);
+    REQUIRE((px[i] & 0xff) == 0);
+    REQUIRE(((px[i] >> 8) & 0xff) <= a);
+  }
+}
+
+TEST_CASE("Undercurl tiles are keyed by their shape and color", "[decoration_tile]")
+{
+  using namespace decoration;
+  TileCache<int> cache(tile_cache_size);
+  const auto u = undercurl(8.f, 18.f);
+  cache.put(key_of(u, 0xff0000), 1);
+  cache.put(key_of(u, 0x00ff00), 2);
+  REQUIRE(*cache.get(key_of(undercurl(8.2f, 18.f), 0xff0000)) == 1);
+  REQUIRE(*cache.get(key_of(u, 0x00ff00)) == 2);
+  REQUIRE(!cache.get(key_of(undercurl(9.f, 18.f), 0xff0000)));
+  REQUIRE(!cache.get(key_of(undercurl(8.f, 10.f), 0xff0000)));
+}
@@ -0,0 +1,47 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include "fallback_cache.hpp"
+
+TEST_CASE("fallback_cache round trips a FallbackTable", "[fallback_cache]")
+{
+  FallbackTable table;
+  table.set(0x4E00, 2);
+  table.set(0x4E01, 1);
+  table.set(0xE0B0, 3);
+  const auto key = fallback_cache::key_of("Iosevka 12, Noto Sans CJK 12");
+  const auto data = fallback_cache::serialize(table, key, 4, true);
+  REQUIRE(data.size() == sizeof(fallback_cache::Header)
+    + 2 * fallback_cache::page_record_size);
+  FallbackTable loaded;
+  const auto res = fallback_cache::deserialize(data, key, 4, loaded);
+  REQUIRE(res);
+  REQUIRE(res->prewarmed);
+  REQUIRE(loaded.get(0x4E00) == 2);
+  REQUIRE(loaded.get(0x4E01) == 1);
+  REQUIRE(loaded.get(0x4E02) == FallbackTable::unknown);
+  REQUIRE(loaded.get(0xE0B0) == 3);
+  REQUIRE(loaded.get(0x3000) == FallbackTable::unknown);
+}
+
+TEST_CASE("fallback_cache ignores caches for other fonts", "[fallback_cache]")
+{
+  FallbackTable table;
+  table.set(0x2500, 1);
+  const auto key = fallback_cache::key_of("a");
+  auto data = fallback_cache::serialize(table, key, 2, false);
+  FallbackTable loaded;
+  REQUIRE_FALSE(fallback_cache::deserialize(data, fallback_cache::key_of("b"), 2, loaded));
+  REQUIRE_FALSE(fallback_cache::deserialize(data, key, 3, loaded));
+  REQUIRE_FALSE(fallback_cache::deserialize(
+    std::string_view(data).substr(0, data.size() - 1), key, 2, loaded
+  ));
+  REQUIRE(loaded.get(0x2500) == FallbackTable::unknown);
+  SECTION("Indices of fonts that don't exist are dropped")
+  {
+    table.set(0x2501, 5);
+    data = fallback_cache::serialize(table, key, 2, false);
+    REQUIRE(fallback_cache::deserialize(data, key, 2, loaded));
+    REQUIRE(loaded.get(0x2500) == 1);
+    REQUIRE(loaded.get(0x2501) == FallbackTable::unknown);
+  }
+}
@@ -0,0 +1,37 @@
+#include <catch2/catch.hpp>
+#include "fallback_table.hpp"
+
+TEST_CASE("FallbackTable stores font indices per code point", "[fallback_table]")
+{
+  FallbackTable table;
+  REQUIRE(table.get(0x4E00) == FallbackTable::unknown);
+  table.set(0x4E00, 2);
+  table.set(0xE0B0, 1);
+  REQUIRE(table.get(0x4E00) == 2);
+  REQUIRE(table.get(0x4E01) == FallbackTable::unknown);
+  REQUIRE(table.get(0xE0B0) == 1);
+  SECTION("Code points out of range are never resolved")
+  {
+    table.set(0x110000, 1);
+    REQUIRE(table.get(0x110000) == FallbackTable::unknown);
+    REQUIRE(table.get(0xFFFFFFFF) == FallbackTable::unknown);
+  }
+  SECTION("clear forgets everything")
+  {
+    table.clear();
+    REQUIRE(table.get(0x4E00) == FallbackTable::unknown);
+    REQUIRE(table.get(0xE0B0) == FallbackTable::unknown);
+  }
+  SECTION("merge keeps existing entries and fills in unknown ones")
+  {
+    FallbackTable other;
+    other.set(0x4E00, 0);
+    other.set(0x4E01, 3);
+    other.set(0x1F600, 4);
+    table.merge(std::move(other));
+    REQUIRE(table.get(0x4E00) == 2);
+    REQUIRE(table.get(0x4E01) == 3);
+    REQUIRE(table.get(0x1F600) == 4);
+    REQUIRE(table.get(0xE0B0) == 1);
+  }
+}
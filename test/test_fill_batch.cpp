@@ -0,0 +1,70 @@
+#include <catch2/catch.hpp>
+#include <utility>
+#include <vector>
+#include "fill_batch.hpp"
+
+using Rect = FillBatch::Rect;
+
+struct Drawn
+{
+  std::vector<std::uint32_t> colors;
+  std::vector<std::pair<std::uint32_t, Rect>> fills;
+};
+
+static Drawn flush(FillBatch& batch)
+{
+  Drawn d;
+  std::uint32_t cur = 0;
+  batch.flush(
+    [&](std::uint32_t color) { d.colors.push_back(color); cur = color; },
+    [&](Rect r) { d.fills.emplace_back(cur, r); }
+  );
+  return d;
+}
+
+TEST_CASE("FillBatch merges runs on a row", "[fill_batch]")
+{
+  FillBatch batch;
+  // Right to left, the way the grids are drawn
+  batch.add(0xff0000, {20.f, 0.f, 30.f, 10.f});
+  batch.add(0xff0000, {10.f, 0.f, 20.f, 10.f});
+  // Snapped to a whole pixel
+  batch.add(0xff0000, {0.f, 0.f, 10.3f, 10.f});
+  REQUIRE(batch.size() == 1);
+  // Different color breaks the run
+  batch.add(0x00ff00, {30.f, 0.f, 40.f, 10.f});
+  batch.add(0xff0000, {40.f, 0.f, 50.f, 10.f});
+  REQUIRE(batch.size() == 3);
+  const auto drawn = flush(batch);
+  REQUIRE(batch.empty());
+  // One color change per color
+  REQUIRE(drawn.colors == std::vector<std::uint32_t> {0x00ff00, 0xff0000});
+  REQUIRE(drawn.fills.size() == 3);
+  REQUIRE(drawn.fills[1].second.left == 0.f);
+  REQUIRE(drawn.fills[1].second.right == 30.f);
+}
+
+TEST_CASE("FillBatch merges identical runs on consecutive rows", "[fill_batch]")
+{
+  FillBatch batch;
+  for(int row = 0; row < 5; ++row)
+  {
+    const float top = row * 10.f;
+    batch.add(0x000000, {0.f, top, 100.f, top + 10.f});
+    batch.add(0x0000ff, {100.f, top, 120.f, top + 10.f});
+  }
+  // A row with a different extent stays separate
+  batch.add(0x000000, {0.f, 50.f, 50.f, 60.f});
+  const auto drawn = flush(batch);
+  REQUIRE(drawn.colors.size() == 2);
+  REQUIRE(drawn.fills.size() == 3);
+  const auto& [color, r] = drawn.fills[1];
+  REQUIRE(color == 0x000000);
+  REQUIRE(r.top == 0.f);
+  REQUIRE(r.bottom == 50.f);
+  SECTION("Empty rectangles are ignored")
+  {
+    batch.add(0x000000, {10.f, 0.f, 10.f, 10.f});
+    REQUIRE(batch.empty());
+  }
+}
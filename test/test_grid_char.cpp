@@ -0,0 +1,24 @@
+#include <catch2/catch.hpp>
+#include "grid.hpp"
+
+TEST_CASE("Cell text is converted to grid chars", "[grid_char]")
+{
+  REQUIRE(GridChar::grid_char_from_str("") == 0);
+  REQUIRE(GridChar::grid_char_from_str("a") == 'a');
+  REQUIRE(GridChar::grid_char_from_str(" ") == ' ');
+  // Single code points are stored as-is
+  REQUIRE(GridChar::grid_char_from_str("\xc3\xa9") == 0xe9);
+  REQUIRE(GridChar::grid_char_from_str("\xf0\x9f\x98\x80") == 0x1f600);
+  SECTION("Clusters and invalid text are interned")
+  {
+    const auto cluster = GridChar::grid_char_from_str("e\xcc\x81");
+    REQUIRE(cluster & GridChar::cluster_bit);
+    REQUIRE(GridChar::grid_char_from_str("e\xcc\x81") == cluster);
+    GridChar cell {cluster, 0};
+    REQUIRE(cell.ucs() == 'e');
+    REQUIRE(cell.text() == QString::fromUtf8("e\xcc\x81"));
+    const auto invalid = GridChar::grid_char_from_str("\xff");
+    REQUIRE(invalid & GridChar::cluster_bit);
+    REQUIRE(GridChar::grid_char_from_str("\x80") & GridChar::cluster_bit);
+  }
+}
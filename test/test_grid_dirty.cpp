@@ -0,0 +1,138 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include "grid.hpp"
+
+static std::vector<QRect> take_all(GridBase& grid)
+{
+  std::vector<QRect> rects;
+  grid.take_dirty([&](QRect r) { rects.push_back(r); });
+  return rects;
+}
+
+TEST_CASE("Overlapping draws are coalesced", "[grid_dirty]")
+{
+  GridBase grid {0, 0, 10, 5, 1};
+  SECTION("Repeated draws of a row are drawn once")
+  {
+    grid.send_draw(QRect(0, 1, 3, 1));
+    grid.send_draw(QRect(2, 1, 5, 1));
+    grid.send_draw(QRect(0, 1, 3, 1));
+    auto rects = take_all(grid);
+    REQUIRE(rects.size() == 1);
+    REQUIRE(rects[0] == QRect(0, 1, 7, 1));
+    REQUIRE(!grid.has_pending_paint());
+  }
+  SECTION("Consecutive rows are merged, gaps are not")
+  {
+    grid.send_draw(QRect(1, 0, 2, 1));
+    grid.send_draw(QRect(4, 1, 2, 1));
+    grid.send_draw(QRect(0, 3, 10, 1));
+    auto rects = take_all(grid);
+    REQUIRE(rects.size() == 2);
+    REQUIRE(rects[0] == QRect(1, 0, 5, 2));
+    REQUIRE(rects[1] == QRect(0, 3, 10, 1));
+  }
+  SECTION("Draws outside the grid are clamped")
+  {
+    grid.send_draw(QRect(8, 4, 20, 20));
+    auto rects = take_all(grid);
+    REQUIRE(rects.size() == 1);
+    REQUIRE(rects[0] == QRect(8, 4, 2, 1));
+  }
+  SECTION("Clearing the event queue drops pending draws")
+  {
+    grid.send_draw(QRect(0, 0, 10, 5));
+    grid.send_redraw();
+    REQUIRE(take_all(grid).empty());
+  }
+}
+
+TEST_CASE("Dirty spans move along with scrolled cells", "[grid_dirty]")
+{
+  GridBase grid {0, 0, 10, 5, 1};
+  SECTION("Full width scroll up")
+  {
+    grid.send_draw(QRect(2, 3, 3, 1));
+    grid.send_scroll(QRect(0, 0, 10, 5), 1);
+    // The draw moved up one row, and the last row was scrolled in
+    auto rects = take_all(grid);
+    REQUIRE(rects.size() == 2);
+    REQUIRE(rects[0] == QRect(2, 2, 3, 1));
+    REQUIRE(rects[1] == QRect(0, 4, 10, 1));
+  }
+  SECTION("Partial width scroll keeps columns outside the region")
+  {
+    grid.send_draw(QRect(0, 2, 10, 1));
+    grid.send_scroll(QRect(0, 0, 5, 5), -1);
+    auto rects = take_all(grid);
+    REQUIRE(rects.size() == 2);
+    REQUIRE(rects[0] == QRect(0, 0, 5, 1));
+    REQUIRE(rects[1] == QRect(0, 2, 10, 2));
+  }
+}
+
+TEST_CASE("Damage covers whole dirty rows and queued events", "[grid_dirty]")
+{
+  GridBase grid {0, 0, 10, 5, 1};
+  REQUIRE(grid.take_damage().isEmpty());
+  grid.send_draw(QRect(3, 1, 1, 1));
+  grid.send_draw(QRect(0, 2, 2, 1));
+  grid.send_draw(QRect(5, 4, 1, 1));
+  auto damage = grid.take_damage();
+  REQUIRE(damage == QRegion(0, 1, 10, 2) + QRegion(0, 4, 10, 1));
+  // The dirty spans are still there to be drawn
+  REQUIRE(grid.has_pending_paint());
+  SECTION("A redraw damages the whole grid")
+  {
+    grid.send_redraw();
+    REQUIRE(grid.take_damage() == QRegion(0, 0, 10, 5));
+    REQUIRE(grid.take_damage().isEmpty());
+  }
+  SECTION("Scrolls damage the scrolled region")
+  {
+    take_all(grid);
+    grid.send_scroll(QRect(0, 0, 10, 3), 1);
+    REQUIRE(grid.take_damage() == QRegion(0, 0, 10, 3));
+  }
+}
+
+TEST_CASE("Rows resent with the same contents are skipped", "[grid_dirty]")
+{
+  GridBase grid {0, 0, 10, 5, 1};
+  const QRect line {0, 2, 10, 1};
+  grid.set_text('a', 2, 0, 1, 10, false);
+  grid.send_draw_changed(line, 0);
+  REQUIRE(take_all(grid).size() == 1);
+  grid.send_draw_changed(line, 0);
+  REQUIRE(take_all(grid).empty());
+  SECTION("Changed contents are drawn")
+  {
+    grid.set_text('b', 2, 3, 1, 1, false);
+    grid.send_draw_changed(QRect(3, 2, 1, 1), 0);
+    REQUIRE(take_all(grid) == std::vector<QRect> {QRect(3, 2, 1, 1)});
+  }
+  SECTION("Changed highlights are drawn")
+  {
+    grid.send_draw_changed(line, 1);
+    REQUIRE(take_all(grid).size() == 1);
+  }
+  SECTION("Redraws and forced draws forget the hashes")
+  {
+    grid.send_redraw();
+    grid.send_draw_changed(line, 0);
+    REQUIRE(take_all(grid).size() == 1);
+    grid.send_draw(line);
+    take_all(grid);
+    grid.send_draw_changed(line, 0);
+    REQUIRE(take_all(grid).size() == 1);
+  }
+  SECTION("Hashes move along with full width scrolls")
+  {
+    grid.send_scroll(QRect(0, 0, 10, 5), 1);
+    take_all(grid);
+    // The cells are moved by grid_scroll
+    grid.set_text('a', 1, 0, 1, 10, false);
+    grid.send_draw_changed(QRect(0, 1, 10, 1), 0);
+    REQUIRE(take_all(grid).empty());
+  }
+}
@@ -0,0 +1,63 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include "grid_lines.hpp"
+
+static Object cell(std::string text)
+{
+  return ObjectArray {std::move(text)};
+}
+
+static Object cell(std::string text, std::uint64_t hl_id, std::uint64_t repeat = 1)
+{
+  return ObjectArray {std::move(text), hl_id, repeat};
+}
+
+TEST_CASE("GridLines decodes the cells of grid_line events", "[grid_lines]")
+{
+  Object redraw = ObjectArray {
+    std::uint64_t(2),
+    std::string("redraw"),
+    ObjectArray {
+      ObjectArray {std::string("flush")},
+      ObjectArray {
+        std::string("grid_line"),
+        ObjectArray {
+          std::uint64_t(1), std::uint64_t(3), std::uint64_t(4),
+          ObjectArray {cell("a", 5), cell(" ", 6, 3), cell("b")}
+        },
+        // Starts after a double-width char, hl_id carries over
+        ObjectArray {
+          std::uint64_t(1), std::uint64_t(4), std::uint64_t(1),
+          ObjectArray {cell(""), cell("\xe4\xb8\x80"), cell("")}
+        },
+        // Not a line
+        std::uint64_t(0)
+      }
+    }
+  };
+  GridLines lines;
+  lines.decode(redraw);
+  REQUIRE(lines.size() == 3);
+  const auto* line = lines.next();
+  REQUIRE(line);
+  REQUIRE(line->grid == 1);
+  REQUIRE(line->row == 3);
+  REQUIRE(line->col == 4);
+  auto cells = lines.cells_of(*line);
+  REQUIRE(cells.size() == 5);
+  REQUIRE(cells[0].ucs() == 'a');
+  REQUIRE(cells[0].hl_id == 5);
+  REQUIRE(cells[3].ucs() == ' ');
+  REQUIRE(cells[3].hl_id == 6);
+  REQUIRE(cells[4].hl_id == 6);
+  line = lines.next();
+  cells = lines.cells_of(*line);
+  REQUIRE(cells.size() == 3);
+  REQUIRE(cells[0].empty());
+  REQUIRE(cells[0].hl_id == 6);
+  REQUIRE(cells[1].ucs() == 0x4e00);
+  REQUIRE(cells[1].double_width());
+  line = lines.next();
+  REQUIRE(lines.cells_of(*line).empty());
+  REQUIRE(!lines.next());
+}
@@ -0,0 +1,56 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <memory>
+#include "grid_pool.hpp"
+
+/// Stands in for a grid with a w x h buffer.
+struct PooledGrid
+{
+  std::uint16_t w;
+  std::uint16_t h;
+  bool can_reuse(std::uint16_t new_w, std::uint16_t new_h) const
+  {
+    return new_w <= w && new_h <= h;
+  }
+  std::size_t buffer_memory() const { return std::size_t(w) * h; }
+};
+
+static std::unique_ptr<PooledGrid> grid(std::uint16_t w, std::uint16_t h)
+{
+  return std::make_unique<PooledGrid>(PooledGrid {w, h});
+}
+
+TEST_CASE("GridPool reuses the smallest grid that fits", "[grid_pool]")
+{
+  GridPool<PooledGrid> pool;
+  pool.release(grid(80, 40));
+  pool.release(grid(20, 5));
+  pool.release(grid(40, 10));
+  REQUIRE(pool.buffer_memory() == 80 * 40 + 20 * 5 + 40 * 10);
+  auto g = pool.acquire(30, 8);
+  REQUIRE(g);
+  REQUIRE(g->w == 40);
+  REQUIRE(pool.size() == 2);
+  // Nothing's big enough
+  REQUIRE_FALSE(pool.acquire(100, 10));
+  REQUIRE(pool.size() == 2);
+  REQUIRE(pool.acquire(10, 2)->w == 20);
+  REQUIRE(pool.acquire(10, 2)->w == 80);
+  REQUIRE(pool.empty());
+}
+
+TEST_CASE("GridPool frees the oldest grid when it's full", "[grid_pool]")
+{
+  GridPool<PooledGrid> pool {2};
+  pool.release(grid(100, 100));
+  pool.release(grid(10, 10));
+  pool.release(grid(20, 20));
+  REQUIRE(pool.size() == 2);
+  REQUIRE_FALSE(pool.acquire(50, 50));
+  SECTION("Pools of size 0 keep nothing")
+  {
+    GridPool<PooledGrid> none {0};
+    none.release(grid(10, 10));
+    REQUIRE(none.empty());
+  }
+}
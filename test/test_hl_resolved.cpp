@@ -0,0 +1,78 @@
+#include <catch2/catch.hpp>
+#include <sstream>
+#include "hlstate.hpp"
+#include "object.hpp"
+
+static Object default_colors(std::uint32_t fg, std::uint32_t bg, std::uint32_t sp)
+{
+  std::stringstream ss;
+  msgpack::packer<std::stringstream> packer {ss};
+  packer.pack_array(5);
+  packer.pack(fg);
+  packer.pack(bg);
+  packer.pack(sp);
+  packer.pack(0);
+  packer.pack(0);
+  const auto oh = msgpack::unpack(ss.str().data(), ss.str().size());
+  return Object::parse(oh.get());
+}
+
+TEST_CASE("Resolved highlights apply defaults and reverse", "[resolved_hl]")
+{
+  HLState hl_state;
+  hl_state.default_colors_set(default_colors(0xffffff, 0x000000, 0xff0000));
+  HLAttr attr;
+  attr.hl_id = 1;
+  attr.foreground = Color(0x00ff00u);
+  attr.font_opts |= FontOpts::Bold | FontOpts::Underline;
+  hl_state.set_id_attr(1, attr);
+  const auto& r = hl_state.resolved_for_id(1);
+  REQUIRE(r.fg.to_uint32() == 0x00ff00);
+  REQUIRE(r.bg.to_uint32() == 0x000000);
+  REQUIRE(r.sp.to_uint32() == 0xff0000);
+  REQUIRE(r.qfg == QColor(0, 255, 0));
+  REQUIRE(r.bold());
+  REQUIRE(!r.italic());
+  REQUIRE(r.decorated());
+  SECTION("Reverse swaps the resolved colors")
+  {
+    attr.reverse = true;
+    hl_state.set_id_attr(1, attr);
+    const auto& rev = hl_state.resolved_for_id(1);
+    REQUIRE(rev.fg.to_uint32() == 0x000000);
+    REQUIRE(rev.bg.to_uint32() == 0x00ff00);
+  }
+  SECTION("Changing the default colors re-resolves every attribute")
+  {
+    const auto gen = hl_state.generation();
+    hl_state.default_colors_set(default_colors(0xffffff, 0x123456, 0xff0000));
+    REQUIRE(hl_state.generation() != gen);
+    REQUIRE(hl_state.resolved_for_id(1).bg.to_uint32() == 0x123456);
+    REQUIRE(hl_state.resolved_for_id(0).bg.to_uint32() == 0x123456);
+  }
+  SECTION("Highlight group ids bump the generation when they change")
+  {
+    const auto gen = hl_state.generation();
+    hl_state.set_name_id("Pmenu", 1);
+    REQUIRE(hl_state.generation() != gen);
+    REQUIRE(hl_state.id_for_name("Pmenu") == 1);
+    const auto after = hl_state.generation();
+    hl_state.set_name_id("Pmenu", 1);
+    REQUIRE(hl_state.generation() == after);
+  }
+  SECTION("Only redefined ids bump the generation")
+  {
+    const auto gen = hl_state.generation();
+    hl_state.set_id_attr(2, attr);
+    hl_state.set_id_attr(5, attr);
+    REQUIRE(hl_state.generation() == gen);
+    hl_state.set_id_attr(1, attr);
+    REQUIRE(hl_state.generation() != gen);
+  }
+  SECTION("Unknown ids resolve to the default colors")
+  {
+    const auto& def = hl_state.resolved_for_id(1000);
+    REQUIRE(def.fg.to_uint32() == 0xffffff);
+    REQUIRE(def.bg.to_uint32() == 0x000000);
+  }
+}
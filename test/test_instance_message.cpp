@@ -0,0 +1,31 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include "instance_message.hpp"
+
+using namespace std::string_literals;
+
+TEST_CASE("Instance messages round trip", "[instance_message]")
+{
+  const std::vector<std::string> args {"/home/me/a.txt", "", "-c", "echo 'a b'"};
+  const auto decoded = instance_message::decode(instance_message::encode(args));
+  REQUIRE(decoded);
+  REQUIRE(*decoded == args);
+  SECTION("No arguments")
+  {
+    const auto empty = instance_message::decode(instance_message::encode({}));
+    REQUIRE(empty);
+    REQUIRE(empty->empty());
+  }
+}
+
+TEST_CASE("Instance messages reject other data", "[instance_message]")
+{
+  using instance_message::decode;
+  const auto msg = instance_message::encode({"a.txt", "b.txt"});
+  REQUIRE_FALSE(decode(""));
+  REQUIRE_FALSE(decode("GET / HTTP/1.1\r\n"));
+  // Cut off before the last argument's NUL
+  REQUIRE_FALSE(decode(std::string_view(msg).substr(0, msg.size() - 1)));
+  REQUIRE_FALSE(decode("nvui-open 2\na.txt\0"s));
+}
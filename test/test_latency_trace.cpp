@@ -0,0 +1,88 @@
+#include <catch2/catch.hpp>
+#include <chrono>
+#include "latency_trace.hpp"
+
+using namespace std::chrono_literals;
+using Clock = LatencyTrace::Clock;
+
+/// Marks one key going through every stage, each taking step.
+static void type_key(LatencyTrace& trace, Clock::time_point& t, Clock::duration step)
+{
+  trace.mark(LatencyTrace::Key, t);
+  for(auto s : {LatencyTrace::Write, LatencyTrace::Redraw, LatencyTrace::Flush,
+    LatencyTrace::Present})
+  {
+    t += step;
+    trace.mark(s, t);
+  }
+  t += 100ms;
+}
+
+TEST_CASE("LatencyTrace does nothing until it's enabled", "[latency_trace]")
+{
+  LatencyTrace trace;
+  auto t = Clock::now();
+  type_key(trace, t, 1ms);
+  REQUIRE(trace.samples().empty());
+  trace.set_enabled(true);
+  type_key(trace, t, 1ms);
+  REQUIRE(trace.samples().size() == 1);
+}
+
+TEST_CASE("LatencyTrace times each stage of a key", "[latency_trace]")
+{
+  LatencyTrace trace;
+  trace.set_enabled(true);
+  auto t = Clock::now();
+  for(int i = 1; i <= 10; ++i) type_key(trace, t, std::chrono::milliseconds(i));
+  const auto total = trace.summary(LatencyTrace::Key, LatencyTrace::Present);
+  REQUIRE(total.count == 10);
+  REQUIRE(total.max == Approx(40.));
+  REQUIRE(total.p50 == Approx(20.));
+  const auto write = trace.summary(LatencyTrace::Key, LatencyTrace::Write);
+  REQUIRE(write.max == Approx(10.));
+  const auto counts = trace.histogram(LatencyTrace::Key, LatencyTrace::Present);
+  // 4ms in <= 4, 8ms in <= 8, 12 and 16 in <= 16, 20 to 32 in <= 32
+  REQUIRE(counts[2] == 0);
+  REQUIRE(counts[3] == 1);
+  REQUIRE(counts[4] == 1);
+  REQUIRE(counts[5] == 2);
+  REQUIRE(counts[6] == 4);
+  REQUIRE(counts[7] == 2);
+  REQUIRE(trace.chrome_trace().find("\"name\":\"key_to_write\"") != std::string::npos);
+  REQUIRE(trace.format_report().find("total") != std::string::npos);
+}
+
+TEST_CASE("LatencyTrace stages only follow the stage before them", "[latency_trace]")
+{
+  LatencyTrace trace;
+  trace.set_enabled(true);
+  auto t = Clock::now();
+  // A redraw and a frame that happen before the key is written
+  // don't belong to it
+  trace.mark(LatencyTrace::Key, t);
+  trace.mark(LatencyTrace::Redraw, t + 1ms);
+  trace.mark(LatencyTrace::Present, t + 2ms);
+  REQUIRE(trace.samples().empty());
+  // Two keys written together share the rest of their stages
+  trace.mark(LatencyTrace::Key, t + 3ms);
+  trace.mark(LatencyTrace::Write, t + 4ms);
+  trace.mark(LatencyTrace::Redraw, t + 5ms);
+  trace.mark(LatencyTrace::Flush, t + 6ms);
+  trace.mark(LatencyTrace::Present, t + 7ms);
+  const auto samples = trace.samples();
+  REQUIRE(samples.size() == 2);
+  REQUIRE(samples[0].ms(LatencyTrace::Key, LatencyTrace::Present) == Approx(7.));
+  REQUIRE(samples[1].ms(LatencyTrace::Key, LatencyTrace::Present) == Approx(4.));
+  SECTION("Keys that go nowhere time out")
+  {
+    trace.clear();
+    trace.mark(LatencyTrace::Key, t);
+    trace.mark(LatencyTrace::Key, t + 3s);
+    trace.mark(LatencyTrace::Write, t + 3s);
+    trace.mark(LatencyTrace::Redraw, t + 3s);
+    trace.mark(LatencyTrace::Flush, t + 3s);
+    trace.mark(LatencyTrace::Present, t + 3s);
+    REQUIRE(trace.samples().size() == 1);
+  }
+}
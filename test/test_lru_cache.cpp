@@ -0,0 +1,133 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include <string_view>
+#include "lru_cache.hpp"
+
+namespace
+{
+  struct string_hash
+  {
+    std::size_t operator()(std::string_view s) const
+    {
+      return std::hash<std::string_view>()(s);
+    }
+  };
+  struct counting_deleter
+  {
+    static inline int deleted = 0;
+    void operator()(int*) const { ++deleted; }
+  };
+}
+
+using cache_type = LRUCache<std::string, int, do_nothing_deleter<int>, string_hash>;
+
+TEST_CASE("LRUCache evicts the least recently used entry", "[lru_cache]")
+{
+  cache_type cache(2);
+  cache.put("a", 1);
+  cache.put("b", 2);
+  SECTION("Lookups are done through views")
+  {
+    std::string_view a = "a";
+    REQUIRE(cache.get(a));
+    REQUIRE(*cache.get(a) == 1);
+    REQUIRE(!cache.get(std::string_view("c")));
+  }
+  SECTION("get marks the entry as recently used")
+  {
+    REQUIRE(cache.get(std::string_view("a")));
+    cache.put("c", 3);
+    REQUIRE(cache.get(std::string_view("a")));
+    REQUIRE(!cache.get(std::string_view("b")));
+    REQUIRE(*cache.get(std::string_view("c")) == 3);
+    REQUIRE(cache.size() == 2);
+  }
+  SECTION("put replaces existing values")
+  {
+    cache.put("a", 10);
+    REQUIRE(cache.size() == 2);
+    REQUIRE(*cache.get(std::string_view("a")) == 10);
+  }
+  SECTION("Precomputed hashes find the same entries")
+  {
+    const auto h = string_hash()("b");
+    REQUIRE(*cache.get(std::string_view("b"), h) == 2);
+  }
+  SECTION("clear empties the cache")
+  {
+    cache.clear();
+    REQUIRE(cache.size() == 0);
+    REQUIRE(!cache.get(std::string_view("a")));
+    cache.put("d", 4);
+    REQUIRE(*cache.get(std::string_view("d")) == 4);
+  }
+}
+
+TEST_CASE("LRUCache counts hits and misses", "[lru_cache]")
+{
+  cache_type cache(4);
+  cache.put("a", 1);
+  cache.get(std::string_view("a"));
+  cache.get(std::string_view("a"));
+  cache.get(std::string_view("b"));
+  REQUIRE(cache.hits() == 2);
+  REQUIRE(cache.misses() == 1);
+  cache.reset_stats();
+  REQUIRE(cache.hits() == 0);
+  REQUIRE(cache.misses() == 0);
+}
+
+TEST_CASE("LRUCache runs the deleter on evicted values", "[lru_cache]")
+{
+  counting_deleter::deleted = 0;
+  {
+    LRUCache<std::string, int, counting_deleter, string_hash> cache(2);
+    cache.put("a", 1);
+    cache.put("b", 2);
+    cache.put("c", 3);
+    REQUIRE(counting_deleter::deleted == 1);
+    cache.put("c", 4);
+    REQUIRE(counting_deleter::deleted == 2);
+  }
+  REQUIRE(counting_deleter::deleted == 4);
+}
+
+TEST_CASE("LRUCache handles many entries in the same buckets", "[lru_cache]")
+{
+  cache_type cache(64);
+  for(int i = 0; i < 1000; ++i) cache.put(std::to_string(i), i);
+  REQUIRE(cache.size() == 64);
+  for(int i = 1000 - 64; i < 1000; ++i)
+  {
+    auto* v = cache.get(std::string_view(std::to_string(i)));
+    REQUIRE(v);
+    REQUIRE(*v == i);
+  }
+  REQUIRE(!cache.get(std::string_view("0")));
+}
+
+TEST_CASE("LRUCache evicts the coldest entries on demand", "[lru_cache]")
+{
+  counting_deleter::deleted = 0;
+  LRUCache<std::string, int, counting_deleter, string_hash> cache(4);
+  for(const char* k : {"a", "b", "c", "d"}) cache.put(k, 0);
+  cache.get(std::string_view("a"));
+  REQUIRE(cache.evict(2) == 2);
+  REQUIRE(counting_deleter::deleted == 2);
+  REQUIRE(cache.size() == 2);
+  REQUIRE(!cache.get(std::string_view("b")));
+  REQUIRE(!cache.get(std::string_view("c")));
+  REQUIRE(cache.get(std::string_view("a")));
+  // The freed entries are reused before anything else is evicted
+  cache.put("e", 5);
+  cache.put("f", 6);
+  REQUIRE(cache.size() == 4);
+  REQUIRE(cache.get(std::string_view("d")));
+  cache.put("g", 7);
+  REQUIRE(cache.size() == 4);
+  REQUIRE(!cache.get(std::string_view("a")));
+  REQUIRE(cache.evict(10) == 4);
+  REQUIRE(cache.size() == 0);
+  cache.put("h", 8);
+  REQUIRE(*cache.get(std::string_view("h")) == 8);
+}
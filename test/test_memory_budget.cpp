@@ -0,0 +1,58 @@
+#include <catch2/catch.hpp>
+#include "memory_budget.hpp"
+
+TEST_CASE("MemoryBudget without a budget never evicts", "[memory_budget]")
+{
+  MemoryBudget memory;
+  memory.set_usage(MemoryBudget::Snapshots, 1 << 30);
+  memory.set_usage(MemoryBudget::Buffers, 1 << 30);
+  REQUIRE(memory.total() == std::size_t(2) << 30);
+  REQUIRE(!memory.over_budget());
+  REQUIRE(memory.plan() == MemoryBudget::Plan {});
+}
+
+TEST_CASE("MemoryBudget evicts in priority order", "[memory_budget]")
+{
+  MemoryBudget memory;
+  memory.set_budget(800);
+  memory.set_usage(MemoryBudget::Snapshots, 100);
+  memory.set_usage(MemoryBudget::TextLayouts, 200);
+  memory.set_usage(MemoryBudget::HiddenBuffers, 300);
+  memory.set_usage(MemoryBudget::Buffers, 400);
+  REQUIRE(memory.over_budget());
+  SECTION("Frees down to under the budget")
+  {
+    // 1000 in use, frees down to 700
+    const auto plan = memory.plan();
+    REQUIRE(plan[MemoryBudget::Snapshots] == 100);
+    REQUIRE(plan[MemoryBudget::TextLayouts] == 200);
+    REQUIRE(plan[MemoryBudget::HiddenBuffers] == 0);
+  }
+  SECTION("Reaches later pools once the earlier ones are empty")
+  {
+    memory.set_usage(MemoryBudget::Widgets, 300);
+    const auto plan = memory.plan();
+    REQUIRE(plan[MemoryBudget::Snapshots] == 100);
+    REQUIRE(plan[MemoryBudget::TextLayouts] == 200);
+    REQUIRE(plan[MemoryBudget::HiddenBuffers] == 300);
+  }
+  SECTION("Pools that can't be evicted only count towards the total")
+  {
+    memory.set_usage(MemoryBudget::Buffers, 10000);
+    const auto plan = memory.plan();
+    REQUIRE(plan[MemoryBudget::Snapshots] == 100);
+    REQUIRE(plan[MemoryBudget::TextLayouts] == 200);
+    REQUIRE(plan[MemoryBudget::HiddenBuffers] == 300);
+  }
+  SECTION("Records what was evicted")
+  {
+    memory.evicted(MemoryBudget::Snapshots, 100);
+    memory.evicted(MemoryBudget::TextLayouts, 150);
+    REQUIRE(memory.usage(MemoryBudget::Snapshots) == 0);
+    REQUIRE(memory.usage(MemoryBudget::TextLayouts) == 50);
+    REQUIRE(memory.evicted_bytes(MemoryBudget::TextLayouts) == 150);
+    REQUIRE(memory.total() == 750);
+    REQUIRE(!memory.over_budget());
+    REQUIRE(memory.plan() == MemoryBudget::Plan {});
+  }
+}
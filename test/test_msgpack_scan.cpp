@@ -0,0 +1,54 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include "msgpack_scan.hpp"
+
+using namespace std::string_literals;
+
+/// [2, "redraw", [["grid_line", {"a": -1}, 1.5, nil]]]
+static const std::string message =
+  "\x93\x02\xa6redraw\x91\x94\xa9grid_line\x81\xa1\x61\xff"
+  "\xcb\x3f\xf8\x00\x00\x00\x00\x00\x00\xc0"s;
+
+TEST_CASE("MsgpackScanner finds the end of an object", "[msgpack_scan]")
+{
+  MsgpackScanner scanner;
+  const std::string data = message + "\x93\x01"s;
+  REQUIRE(scanner.scan(data.data(), data.size()));
+  REQUIRE(scanner.size() == message.size());
+  SECTION("Scalars and empty containers are objects on their own")
+  {
+    for(const auto& obj : {"\x05"s, "\xc0"s, "\x90"s, "\x80"s, "\xdc\x00\x00"s, "\xa0"s})
+    {
+      scanner.reset();
+      REQUIRE(scanner.scan(obj.data(), obj.size()));
+      REQUIRE(scanner.size() == obj.size());
+    }
+  }
+}
+
+TEST_CASE("MsgpackScanner resumes where it stopped", "[msgpack_scan]")
+{
+  MsgpackScanner scanner;
+  for(std::size_t n = 0; n < message.size(); ++n)
+  {
+    REQUIRE_FALSE(scanner.scan(message.data(), n));
+  }
+  REQUIRE(scanner.scan(message.data(), message.size()));
+  REQUIRE(scanner.size() == message.size());
+  SECTION("Long strings are waited for as a whole")
+  {
+    const std::string str = "\xda\x01\x00"s + std::string(256, 'x');
+    scanner.reset();
+    REQUIRE_FALSE(scanner.scan(str.data(), 100));
+    REQUIRE(scanner.size() == 0);
+    REQUIRE(scanner.scan(str.data(), str.size()));
+    REQUIRE(scanner.size() == str.size());
+  }
+  SECTION("Invalid bytes end the object")
+  {
+    const auto bad = "\x92\x01\xc1\x02"s;
+    scanner.reset();
+    REQUIRE(scanner.scan(bad.data(), bad.size()));
+    REQUIRE(scanner.size() == 3);
+  }
+}
@@ -6,6 +6,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 #include "object.hpp"
 
 using namespace std::chrono_literals;
@@ -46,3 +47,31 @@ TEST_CASE("nvim_eval callbacks work", "[eval_cb]")
     wait_for_value(done, true);
   }
 }
+
+TEST_CASE("nvim_eval futures work", "[eval_async]")
+{
+  Nvim nvim;
+  REQUIRE(nvim.running());
+  SECTION("Many requests can be in flight at once")
+  {
+    std::vector<std::future<Nvim::Response>> results;
+    for(int i = 0; i < 10; ++i)
+    {
+      results.push_back(nvim.eval_async(fmt::format("{} * 2", i)));
+    }
+    for(int i = 0; i < 10; ++i)
+    {
+      REQUIRE(results[i].wait_for(5s) == std::future_status::ready);
+      auto response = results[i].get();
+      REQUIRE(response.error.is_null());
+      REQUIRE(response.result.try_convert<int>());
+      REQUIRE(*response.result.try_convert<int>() == i * 2);
+    }
+  }
+  SECTION("Errors are in the error field")
+  {
+    auto result = nvim.exec_viml_async("call NonExistentFunction()");
+    REQUIRE(result.wait_for(5s) == std::future_status::ready);
+    REQUIRE(!result.get().error.is_null());
+  }
+}
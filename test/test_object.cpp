@@ -93,7 +93,7 @@ TEST_CASE("Object parsing works", "[Object]")
     REQUIRE(omap.size() == static_cast<uint32_t>(mp.size()));
     for(const auto& [key, val] : omap)
     {
-      REQUIRE(mp.contains(key));
+      REQUIRE(mp.contains(std::string(key)));
       REQUIRE(val.has<std::string>());
     }
   }
@@ -2,6 +2,8 @@
 #include "object.hpp"
 #include <msgpack.hpp>
 #include <cstdint>
+#include <map>
+#include <utility>
 
 TEST_CASE("Object correctly deserialies from msgpack")
 {
@@ -39,3 +41,143 @@ TEST_CASE("Object correctly deserialies from msgpack")
     REQUIRE(o.get<Error>().msg == "Insufficient Bytes");
   }
 }
+
+TEST_CASE("MsgpackStream reassembles messages split across reads")
+{
+  msgpack::sbuffer sbuf;
+  std::vector<std::uint64_t> x {1, 2, 3, 4, 5, 6};
+  std::vector<std::string> y {"hello", "world"};
+  msgpack::pack(sbuf, x);
+  msgpack::pack(sbuf, y);
+  const std::string_view data {sbuf.data(), sbuf.size()};
+  // Small read size so that messages get split
+  MsgpackStream stream {4};
+  auto feed = [&](std::string_view chunk) {
+    auto area = stream.write_area();
+    REQUIRE(area.size() >= chunk.size());
+    std::copy(chunk.begin(), chunk.end(), area.begin());
+    stream.commit(chunk.size());
+  };
+  std::vector<Object> objects;
+  for(std::size_t i = 0; i < data.size(); i += 3)
+  {
+    feed(data.substr(i, 3));
+    while(auto obj = stream.next()) objects.push_back(std::move(*obj));
+  }
+  REQUIRE(stream.pending() == 0);
+  REQUIRE(objects.size() == 2);
+  REQUIRE(objects[0].has<ObjectArray>());
+  REQUIRE(objects[0].array()->size() == x.size());
+  REQUIRE(objects[0].array()->back().try_convert<std::uint64_t>() == 6u);
+  REQUIRE(objects[1].has<ObjectArray>());
+  REQUIRE(objects[1].array()->at(1).get<std::string>() == "world");
+  SECTION("Incomplete data is kept until the rest arrives")
+  {
+    MsgpackStream s2 {1024};
+    auto area = s2.write_area();
+    std::copy(data.begin(), data.end() - 1, area.begin());
+    s2.commit(data.size() - 1);
+    REQUIRE(s2.next());
+    REQUIRE_FALSE(s2.next());
+    REQUIRE(s2.pending() > 0);
+    area = s2.write_area();
+    area[0] = data.back();
+    s2.commit(1);
+    auto obj = s2.next();
+    REQUIRE(obj);
+    REQUIRE(obj->has<ObjectArray>());
+    REQUIRE(s2.pending() == 0);
+  }
+}
+
+TEST_CASE("MsgpackStream can borrow strings from its buffer")
+{
+  msgpack::sbuffer sbuf;
+  const auto msg = std::make_tuple(
+    std::uint64_t(2), std::string("redraw"),
+    std::vector<std::string> {"grid_line", "a somewhat long string"}
+  );
+  msgpack::pack(sbuf, msg);
+  MsgpackStream stream {1024};
+  auto area = stream.write_area();
+  std::copy(sbuf.data(), sbuf.data() + sbuf.size(), area.begin());
+  stream.commit(sbuf.size());
+  REQUIRE(stream.peek_notification_method() == "redraw");
+  auto parsed = stream.next(true);
+  REQUIRE(parsed);
+  ObjectView view {stream.storage(), std::move(*parsed)};
+  auto* params = view.obj.array()->at(2).array();
+  REQUIRE(params);
+  REQUIRE(params->at(1).borrowed());
+  REQUIRE(params->at(1).str() == "a somewhat long string");
+  REQUIRE(params->at(1).try_convert<std::string>() == "a somewhat long string");
+  SECTION("The buffer isn't reused while it's borrowed from")
+  {
+    auto next_area = stream.write_area();
+    std::fill(next_area.begin(), next_area.end(), 'x');
+    REQUIRE(params->at(1).str() == "a somewhat long string");
+  }
+  SECTION("make_owned copies borrowed strings")
+  {
+    view.obj.make_owned();
+    REQUIRE_FALSE(params->at(1).borrowed());
+    REQUIRE(params->at(1).get<std::string>() == "a somewhat long string");
+  }
+}
+
+TEST_CASE("MsgpackStream::next_view allocates arrays from an arena")
+{
+  msgpack::sbuffer sbuf;
+  const std::vector<std::vector<std::uint64_t>> x {{1, 2}, {3, 4}};
+  msgpack::pack(sbuf, x);
+  MsgpackStream stream {1024};
+  auto area = stream.write_area();
+  std::copy(sbuf.data(), sbuf.data() + sbuf.size(), area.begin());
+  stream.commit(sbuf.size());
+  auto view = stream.next_view();
+  REQUIRE(view);
+  REQUIRE(view->obj.has<ObjectArray>());
+  const auto& arr = view->obj.get<ObjectArray>();
+  REQUIRE(arr.size() == 2);
+  const auto* default_resource = std::pmr::get_default_resource();
+  REQUIRE(arr.get_allocator().resource() != default_resource);
+  REQUIRE(arr[1].get<ObjectArray>().get_allocator().resource() != default_resource);
+  REQUIRE(arr[1].get<ObjectArray>()[0].try_convert<std::uint64_t>() == 3u);
+  // Copies don't depend on the arena
+  Object copy = std::as_const(view->obj);
+  REQUIRE(copy.get<ObjectArray>().get_allocator().resource() == default_resource);
+}
+
+TEST_CASE("MsgpackStream::next_view keeps map keys in the arena")
+{
+  msgpack::sbuffer sbuf;
+  const std::map<std::string, std::string> mp {
+    {"a key that's too long to be stored inline", "a value that's too long as well"},
+    {"short", "x"}
+  };
+  msgpack::pack(sbuf, std::make_tuple(mp));
+  MsgpackStream stream {1024};
+  auto area = stream.write_area();
+  std::copy(sbuf.data(), sbuf.data() + sbuf.size(), area.begin());
+  stream.commit(sbuf.size());
+  auto view = stream.next_view();
+  REQUIRE(view);
+  // Nothing needs to be walked to be freed
+  REQUIRE(view->arena_only);
+  const auto& omap = view->obj.get<ObjectArray>().at(0).get<ObjectMap>();
+  const auto* resource = omap.get_allocator().resource();
+  for(const auto& [key, val] : omap)
+  {
+    REQUIRE(key.get_allocator().resource() == resource);
+    REQUIRE(val.borrowed());
+  }
+  SECTION("make_owned reports strings that allocate")
+  {
+    auto& arr = view->obj.get<ObjectArray>();
+    auto& owned = arr.at(0).get<ObjectMap>();
+    REQUIRE_FALSE(owned.at("short").make_owned());
+    REQUIRE(owned.at("a key that's too long to be stored inline").make_owned());
+    // The arena doesn't free that copy
+    view->arena_only = false;
+  }
+}
@@ -0,0 +1,57 @@
+#include <catch2/catch.hpp>
+#include "perf_stats.hpp"
+
+TEST_CASE("PerfStats frame times", "[perf_stats]")
+{
+  PerfStats stats;
+  REQUIRE(stats.frame_time_avg() == 0.);
+  REQUIRE(stats.frame_time_percentile(0.99) == 0.);
+  for(int i = 1; i <= 100; ++i) stats.add_frame(double(i));
+  REQUIRE(stats.frames() == 100);
+  REQUIRE(stats.frame_time_avg() == Approx(50.5));
+  REQUIRE(stats.frame_time_max() == 100.);
+  REQUIRE(stats.frame_time_percentile(0.5) == 50.);
+  REQUIRE(stats.frame_time_percentile(0.99) == 99.);
+  SECTION("Only the most recent frames are kept")
+  {
+    for(std::size_t i = 0; i < PerfStats::frame_window; ++i) stats.add_frame(2.);
+    REQUIRE(stats.frame_time_avg() == 2.);
+    REQUIRE(stats.frame_time_max() == 2.);
+  }
+}
+
+TEST_CASE("PerfStats rates", "[perf_stats]")
+{
+  PerfStats stats;
+  // The first sample only sets the baseline
+  auto rates = stats.update_rates(1., 0);
+  REQUIRE(rates.batches == 0.);
+  stats.redraw_batches += 30;
+  stats.redraw_events += 300;
+  rates = stats.update_rates(3., 2048);
+  REQUIRE(rates.batches == Approx(15.));
+  REQUIRE(rates.events == Approx(150.));
+  REQUIRE(rates.bytes == Approx(1024.));
+  SECTION("Rates are since the last sample")
+  {
+    stats.redraw_batches += 10;
+    rates = stats.update_rates(4., 2048);
+    REQUIRE(rates.batches == Approx(10.));
+    REQUIRE(rates.bytes == 0.);
+  }
+}
+
+TEST_CASE("PerfStats time to first frame", "[perf_stats]")
+{
+  using namespace std::chrono_literals;
+  PerfStats stats;
+  stats.start_time = PerfStats::Clock::time_point {};
+  // Frames before Neovim's first flush don't count
+  stats.frame_painted(stats.start_time + 10ms);
+  REQUIRE(stats.first_frame_time() == 0.);
+  stats.content_flushed();
+  stats.frame_painted(stats.start_time + 25ms);
+  REQUIRE(stats.first_frame_time() == Approx(25.));
+  stats.frame_painted(stats.start_time + 40ms);
+  REQUIRE(stats.first_frame_time() == Approx(25.));
+}
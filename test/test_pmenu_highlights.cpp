@@ -0,0 +1,27 @@
+#include <catch2/catch.hpp>
+#include "hlstate.hpp"
+#include "popupmenu.hpp"
+
+TEST_CASE("Popup menu highlights survive new ids", "[pmenu_highlights]")
+{
+  HLState hl_state;
+  HLAttr sel;
+  sel.foreground = Color(0x00ff00u);
+  hl_state.set_id_attr(1, sel);
+  hl_state.set_name_id("PmenuSel", 1);
+  PmenuHighlights highlights;
+  highlights.update(hl_state);
+  REQUIRE(highlights.sel == 1);
+  const auto gen = hl_state.generation();
+  // Appended ids don't bump the generation, but move the attributes
+  for(int id = 2; id < 1000; ++id) hl_state.set_id_attr(id, HLAttr());
+  REQUIRE(hl_state.generation() == gen);
+  highlights.update(hl_state);
+  REQUIRE(hl_state.attr_for_id(highlights.sel).foreground->to_uint32() == 0x00ff00);
+  SECTION("Changed group ids are looked up again")
+  {
+    hl_state.set_name_id("PmenuSel", 500);
+    highlights.update(hl_state);
+    REQUIRE(highlights.sel == 500);
+  }
+}
@@ -0,0 +1,44 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include "pum_items.hpp"
+
+TEST_CASE("PumItems keeps the fields of each item", "[pum_items]")
+{
+  PumItems items;
+  REQUIRE(items.empty());
+  items.add("first", "Function", "", "info");
+  items.add("", "", "[LSP]", "");
+  for(int i = 0; i < 10000; ++i)
+  {
+    items.add("word" + std::to_string(i), "Variable", "", "");
+  }
+  REQUIRE(items.size() == 10002);
+  REQUIRE(items.get(0, PumItems::Word) == "first");
+  REQUIRE(items.get(0, PumItems::Kind) == "Function");
+  REQUIRE(items.get(0, PumItems::Menu).empty());
+  REQUIRE(items.get(0, PumItems::Info) == "info");
+  REQUIRE(items.get(1, PumItems::Word).empty());
+  REQUIRE(items.get(1, PumItems::Menu) == "[LSP]");
+  REQUIRE(items.get(10001, PumItems::Word) == "word9999");
+  items.clear();
+  REQUIRE(items.empty());
+}
+
+TEST_CASE("pum_first_visible keeps the selection in view", "[pum_items]")
+{
+  // Everything fits
+  REQUIRE(pum_first_visible(3, 5, 15, 10) == 0);
+  // Nothing selected keeps the window where it is
+  REQUIRE(pum_first_visible(20, -1, 15, 100) == 20);
+  // Selection inside the window
+  REQUIRE(pum_first_visible(20, 25, 15, 100) == 20);
+  // Moving down past the end scrolls by one
+  REQUIRE(pum_first_visible(20, 35, 15, 100) == 21);
+  // Moving up past the start
+  REQUIRE(pum_first_visible(20, 19, 15, 100) == 19);
+  // Wrapping around from the last item to the first and back
+  REQUIRE(pum_first_visible(85, 0, 15, 100) == 0);
+  REQUIRE(pum_first_visible(0, 99, 15, 100) == 85);
+  // The window is clamped when the list shrinks
+  REQUIRE(pum_first_visible(90, -1, 15, 50) == 35);
+}
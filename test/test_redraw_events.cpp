@@ -0,0 +1,25 @@
+#include <catch2/catch.hpp>
+#include "redraw_events.hpp"
+
+static_assert(redraw_events::from_name("grid_line") == RedrawEvent::grid_line);
+static_assert(redraw_events::from_name("flush") == RedrawEvent::flush);
+
+TEST_CASE("Redraw event names are decoded", "[redraw_events]")
+{
+  SECTION("Every known name maps back to its own event")
+  {
+    for(std::size_t i = 0; i < redraw_events::count; ++i)
+    {
+      const auto e = RedrawEvent(i);
+      REQUIRE(redraw_events::from_name(redraw_events::name(e)) == e);
+    }
+  }
+  SECTION("Unknown names are rejected")
+  {
+    REQUIRE(redraw_events::from_name("") == RedrawEvent::Unknown);
+    REQUIRE(redraw_events::from_name("grid_lin") == RedrawEvent::Unknown);
+    REQUIRE(redraw_events::from_name("grid_line_") == RedrawEvent::Unknown);
+    REQUIRE(redraw_events::from_name("not_an_event") == RedrawEvent::Unknown);
+    REQUIRE(redraw_events::name(RedrawEvent::Unknown).empty());
+  }
+}
@@ -0,0 +1,76 @@
+#include <catch2/catch.hpp>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "response_table.hpp"
+
+TEST_CASE("ResponseTable stores callbacks by msgid", "[response_table]")
+{
+  ResponseTable<std::function<int ()>, 4> table;
+  table.add(1, [] { return 1; });
+  table.add(2, [] { return 2; });
+  SECTION("Callbacks are taken once")
+  {
+    auto cb = table.take(2);
+    REQUIRE(cb);
+    REQUIRE((*cb)() == 2);
+    REQUIRE(!table.take(2));
+    REQUIRE((*table.take(1))() == 1);
+  }
+  SECTION("Unknown msgids don't match a slot they share")
+  {
+    // 5 % 4 == 1
+    REQUIRE(!table.take(5));
+    REQUIRE(table.take(1));
+  }
+  SECTION("Slots are reused once taken")
+  {
+    REQUIRE(table.take(1));
+    table.add(5, [] { return 5; });
+    REQUIRE((*table.take(5))() == 5);
+  }
+}
+
+TEST_CASE("ResponseTable keeps callbacks it has no slot for", "[response_table]")
+{
+  ResponseTable<int, 2> table;
+  // 0 is never answered, 2 and 4 share its slot
+  for(int i = 0; i < 6; ++i) table.add(i, i);
+  REQUIRE(table.num_overflowed() == 4);
+  for(int i = 5; i > 0; --i)
+  {
+    const auto val = table.take(i);
+    REQUIRE(val);
+    REQUIRE(*val == i);
+  }
+  REQUIRE(table.num_overflowed() == 0);
+  REQUIRE(!table.take(4));
+  REQUIRE(table.take(0));
+}
+
+TEST_CASE("ResponseTable works with a sender and a reader", "[response_table]")
+{
+  ResponseTable<int, 2> table;
+  constexpr int count = 1000;
+  std::atomic<int> sent = 0;
+  std::thread sender([&] {
+    for(int i = 0; i < count; ++i)
+    {
+      table.add(i, i);
+      ++sent;
+    }
+  });
+  int received = 0;
+  while(received < count)
+  {
+    if (auto val = table.take(received))
+    {
+      REQUIRE(*val == received);
+      ++received;
+    }
+    else std::this_thread::yield();
+  }
+  sender.join();
+  REQUIRE(sent == count);
+}
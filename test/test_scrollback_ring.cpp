@@ -0,0 +1,48 @@
+#include <catch2/catch.hpp>
+#include "scrollback_ring.hpp"
+
+using Strip = ScrollbackRing::Strip;
+
+static Strip strip(std::uint32_t topline, int height)
+{
+  return {topline, topline + 10, true, 0, height};
+}
+
+TEST_CASE("ScrollbackRing places strips one after the other", "[scrollback_ring]")
+{
+  ScrollbackRing ring;
+  ring.reset(100);
+  auto a = ring.push(strip(0, 30), 8);
+  auto b = ring.push(strip(3, 30), 8);
+  REQUIRE(a.ring_y == 0);
+  REQUIRE(b.ring_y == 30);
+  REQUIRE(ring.strips().size() == 2);
+  SECTION("Wrapping around evicts the strips that get overwritten")
+  {
+    ring.push(strip(6, 30), 8);
+    auto d = ring.push(strip(9, 40), 8);
+    REQUIRE(d.ring_y == 0);
+    REQUIRE(ring.strips().size() == 2);
+    REQUIRE(ring.strips().front().topline == 6);
+    REQUIRE(ring.strips().back().topline == 9);
+  }
+  SECTION("The number of strips is limited")
+  {
+    ring.push(strip(6, 10), 2);
+    REQUIRE(ring.strips().size() == 2);
+    REQUIRE(ring.strips().front().topline == 3);
+  }
+  SECTION("Strips taller than the ring are clamped")
+  {
+    auto big = ring.push(strip(20, 500), 8);
+    REQUIRE(big.ring_y == 0);
+    REQUIRE(big.height == 100);
+    REQUIRE(ring.strips().size() == 1);
+  }
+  SECTION("clear removes everything")
+  {
+    ring.clear();
+    REQUIRE(ring.empty());
+    REQUIRE(ring.push(strip(0, 10), 8).ring_y == 0);
+  }
+}
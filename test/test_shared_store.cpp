@@ -0,0 +1,64 @@
+#include <catch2/catch.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shared_store.hpp"
+
+TEST_CASE("SharedStore shares values by key", "[shared_store]")
+{
+  SharedStore<std::string, int> store;
+  int made = 0;
+  const auto make = [&](int v) {
+    return [&made, v] { ++made; return std::make_shared<int>(v); };
+  };
+  auto a = store.get("a", make(1));
+  auto a2 = store.get("a", make(2));
+  auto b = store.get("b", make(3));
+  REQUIRE(a == a2);
+  REQUIRE(*a2 == 1);
+  REQUIRE(*b == 3);
+  REQUIRE(made == 2);
+  REQUIRE(store.size() == 2);
+  REQUIRE(store.contains("a"));
+  SECTION("Values are freed with their last user")
+  {
+    std::weak_ptr<int> weak = a;
+    a.reset();
+    a2.reset();
+    REQUIRE(weak.expired());
+    REQUIRE(!store.contains("a"));
+    REQUIRE(store.size() == 1);
+    auto again = store.get("a", make(4));
+    REQUIRE(*again == 4);
+    REQUIRE(made == 3);
+  }
+  SECTION("Expired entries are pruned")
+  {
+    a.reset();
+    a2.reset();
+    for(int i = 0; i < 100; ++i) store.get(std::to_string(i), make(i));
+    REQUIRE(store.size() == 1);
+    store.prune();
+    REQUIRE(store.size() == 1);
+    REQUIRE(store.contains("b"));
+  }
+}
+
+TEST_CASE("SharedStore builds each value once across threads", "[shared_store]")
+{
+  SharedStore<int, int> store;
+  std::atomic<int> made = 0;
+  std::vector<std::shared_ptr<int>> got(8);
+  std::vector<std::thread> threads;
+  for(std::size_t i = 0; i < got.size(); ++i)
+  {
+    threads.emplace_back([&, i] {
+      got[i] = store.get(42, [&] { ++made; return std::make_shared<int>(42); });
+    });
+  }
+  for(auto& t : threads) t.join();
+  REQUIRE(made == 1);
+  for(const auto& v : got) REQUIRE(v == got.front());
+}
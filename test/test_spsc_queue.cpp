@@ -0,0 +1,68 @@
+#include <catch2/catch.hpp>
+#include <memory>
+#include <thread>
+#include "spsc_queue.hpp"
+
+TEST_CASE("SPSCQueue pushes and pops in order", "[spsc_queue]")
+{
+  SPSCQueue<int, 4> queue;
+  REQUIRE(queue.empty());
+  REQUIRE(!queue.try_pop());
+  for(int i = 0; i < 4; ++i) REQUIRE(queue.try_push(int(i)));
+  SECTION("A full queue rejects pushes")
+  {
+    REQUIRE(!queue.try_push(4));
+  }
+  SECTION("Elements come out in order, and slots are reused")
+  {
+    for(int round = 0; round < 3; ++round)
+    {
+      for(int i = 0; i < 4; ++i)
+      {
+        auto val = queue.try_pop();
+        REQUIRE(val);
+        REQUIRE(*val == round * 4 + i);
+      }
+      REQUIRE(queue.empty());
+      for(int i = 0; i < 4; ++i) REQUIRE(queue.try_push((round + 1) * 4 + i));
+    }
+  }
+}
+
+TEST_CASE("SPSCQueue doesn't move from rejected elements", "[spsc_queue]")
+{
+  SPSCQueue<std::unique_ptr<int>, 1> queue;
+  REQUIRE(queue.try_push(std::make_unique<int>(1)));
+  auto second = std::make_unique<int>(2);
+  REQUIRE(!queue.try_push(std::move(second)));
+  REQUIRE(second);
+  auto first = queue.try_pop();
+  REQUIRE(first);
+  REQUIRE(**first == 1);
+  REQUIRE(queue.try_push(std::move(second)));
+  REQUIRE(!second);
+}
+
+TEST_CASE("SPSCQueue hands elements across threads", "[spsc_queue]")
+{
+  constexpr int count = 100000;
+  SPSCQueue<int, 64> queue;
+  std::thread producer([&] {
+    for(int i = 0; i < count; ++i)
+    {
+      while(!queue.try_push(int(i))) std::this_thread::yield();
+    }
+  });
+  int expected = 0;
+  bool in_order = true;
+  while(expected < count)
+  {
+    auto val = queue.try_pop();
+    if (!val) { std::this_thread::yield(); continue; }
+    in_order = in_order && *val == expected;
+    ++expected;
+  }
+  producer.join();
+  REQUIRE(in_order);
+  REQUIRE(queue.empty());
+}
@@ -0,0 +1,87 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+#include "write_queue.hpp"
+
+static std::vector<WriteQueue::Item> take(WriteQueue& queue)
+{
+  std::vector<WriteQueue::Item> items;
+  queue.wait_and_take(items);
+  return items;
+}
+
+TEST_CASE("WriteQueue merges consecutive input", "[write_queue]")
+{
+  WriteQueue queue;
+  queue.push_input("a");
+  queue.push_input("<C-w>");
+  queue.push_input("j");
+  auto items = take(queue);
+  REQUIRE(items.size() == 1);
+  REQUIRE(std::get<WriteQueue::Input>(items[0]).keys == "a<C-w>j");
+  SECTION("Input isn't merged across other messages")
+  {
+    queue.push_input("a");
+    queue.push("packed");
+    queue.push_input("b");
+    items = take(queue);
+    REQUIRE(items.size() == 3);
+    REQUIRE(std::get<WriteQueue::Input>(items[0]).keys == "a");
+    REQUIRE(std::get<WriteQueue::Buffer>(items[1]) == "packed");
+    REQUIRE(std::get<WriteQueue::Input>(items[2]).keys == "b");
+  }
+}
+
+TEST_CASE("WriteQueue collapses mouse drags", "[write_queue]")
+{
+  WriteQueue queue;
+  queue.push_mouse({"left", "press", "", 1, 0, 0});
+  queue.push_mouse({"left", "drag", "", 1, 1, 2});
+  queue.push_mouse({"left", "drag", "", 1, 3, 4});
+  queue.push_mouse({"left", "drag", "", 1, 5, 6});
+  SECTION("Only the latest drag position is kept")
+  {
+    auto items = take(queue);
+    REQUIRE(items.size() == 2);
+    REQUIRE(std::get<WriteQueue::Mouse>(items[0]).action == "press");
+    const auto& drag = std::get<WriteQueue::Mouse>(items[1]);
+    REQUIRE(drag.row == 5);
+    REQUIRE(drag.col == 6);
+  }
+  SECTION("Drags with different modifiers or grids are kept")
+  {
+    queue.push_mouse({"left", "drag", "C", 1, 7, 7});
+    queue.push_mouse({"left", "drag", "C", 2, 8, 8});
+    queue.push_mouse({"left", "release", "C", 2, 8, 8});
+    auto items = take(queue);
+    REQUIRE(items.size() == 5);
+  }
+}
+
+TEST_CASE("WriteQueue reuses buffers and wakes the writer", "[write_queue]")
+{
+  WriteQueue queue;
+  auto buf = queue.acquire();
+  buf.reserve(1024);
+  const auto cap = buf.capacity();
+  queue.recycle(std::move(buf));
+  auto reused = queue.acquire();
+  REQUIRE(reused.empty());
+  REQUIRE(reused.capacity() == cap);
+  std::vector<std::string> written;
+  std::thread writer([&] {
+    std::vector<WriteQueue::Item> items;
+    while(queue.wait_and_take(items))
+    {
+      for(auto& item : items) written.push_back(std::get<WriteQueue::Buffer>(item));
+      items.clear();
+    }
+  });
+  queue.push("one");
+  queue.push("two");
+  // Whatever was queued before closing is still taken
+  queue.close();
+  writer.join();
+  REQUIRE(written == std::vector<std::string> {"one", "two"});
+}
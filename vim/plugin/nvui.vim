@@ -76,6 +76,21 @@ command! -nargs=1 NvuiCmdline call rpcnotify(1, 'NVUI_EXT_CMDLINE', <args>)
 command! NvuiIMEEnable call rpcnotify(1, 'NVUI_IME_SET', v:true)
 command! NvuiIMEDisable call rpcnotify(1, 'NVUI_IME_SET', v:false)
 command! NvuiIMEToggle call rpcnotify(1, 'NVUI_IME_TOGGLE')
+command! -nargs=1 NvuiPerfHud call rpcnotify(1, 'NVUI_PERF_HUD', <args>)
+command! NvuiPerfHudToggle call rpcnotify(1, 'NVUI_PERF_HUD_TOGGLE')
+function! NvuiPerfStats()
+	return rpcrequest(1, 'NVUI_PERF_STATS')
+endfunction
+command! NvuiPerfStats echo NvuiPerfStats()
+command! -nargs=1 NvuiSuspendWhenHidden call rpcnotify(1, 'NVUI_SUSPEND_WHEN_HIDDEN', <args>)
+command! -nargs=1 NvuiMemoryBudget call rpcnotify(1, 'NVUI_MEMORY_BUDGET', <args>)
+command! -nargs=1 NvuiLatencyTrace call rpcnotify(1, 'NVUI_LATENCY_TRACE', <args>)
+function! NvuiLatencyStats()
+	return rpcrequest(1, 'NVUI_LATENCY_STATS')
+endfunction
+command! NvuiLatencyStats echo NvuiLatencyStats()
+command! NvuiLatencyReport echo rpcrequest(1, 'NVUI_LATENCY_REPORT')
+command! -nargs=1 -complete=file NvuiLatencyExport call rpcnotify(1, 'NVUI_LATENCY_EXPORT', expand(<q-args>))
 function! NvuiGetTitle()
 	return s:get_title()
 endfunction